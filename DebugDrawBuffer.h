@@ -0,0 +1,273 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "JoystickCore.h"
+
+#pragma once
+
+/*
+ Debug drawing is compiled out of shipping builds: the buffer then allocates nothing and every Add call is an empty inline function.
+ Define VIRTUAL_JOYSTICK_DEBUG_DRAW to 0 or 1 to override.
+ */
+#ifndef VIRTUAL_JOYSTICK_DEBUG_DRAW
+#if defined(UE_BUILD_SHIPPING) && UE_BUILD_SHIPPING
+#define VIRTUAL_JOYSTICK_DEBUG_DRAW 0
+#else
+#define VIRTUAL_JOYSTICK_DEBUG_DRAW 1
+#endif
+#endif
+
+enum DebugDrawPrimitiveType
+{
+    DEBUG_DRAW_SPHERE,
+    DEBUG_DRAW_LINE,
+    DEBUG_DRAW_CYLINDER,
+    DEBUG_DRAW_PRIMITIVE_TYPE_COUNT
+};
+
+struct DebugDrawColor
+{
+    uint8_t R;
+    uint8_t G;
+    uint8_t B;
+    uint8_t A;
+
+    static DebugDrawColor Make(uint8_t R, uint8_t G, uint8_t B)
+    {
+        DebugDrawColor Color;
+        Color.R = R;
+        Color.G = G;
+        Color.B = B;
+        Color.A = 255;
+        return Color;
+    }
+};
+
+/*
+ One primitive in world space.  Spheres use Start as the center, lines and cylinders go from Start to End.
+ */
+struct DebugDrawPrimitive
+{
+    DebugDrawPrimitiveType Type;
+    JoystickVector Start;
+    JoystickVector End;
+    float Radius;
+    int Segments;
+    DebugDrawColor Color;
+};
+
+/**
+ * Receives the primitives of one frame when a DebugDrawBuffer is flushed, e.g. UnrealDebugDrawBackend or the headless CountingDebugDrawBackend
+ */
+class IDebugDrawBackend
+{
+public:
+    virtual ~IDebugDrawBackend() {}
+
+    virtual void DrawPrimitives(const DebugDrawPrimitive* Primitives, size_t Count) = 0;
+};
+
+/**
+ * Preallocated list of debug primitives for one frame.  Drawing code records into it instead of issuing DrawDebug* calls one by one,
+ * and Flush() hands everything to a backend in one call and empties the buffer for the next frame.
+ * The capacity is fixed at construction, so recording never allocates; primitives past the capacity are counted in GetDroppedCount() and not drawn.
+ */
+class DebugDrawBuffer
+{
+public:
+    explicit DebugDrawBuffer(size_t Capacity = 64)
+    {
+        Count = 0;
+        Dropped = 0;
+#if VIRTUAL_JOYSTICK_DEBUG_DRAW
+        Primitives.resize(Capacity);
+#else
+        (void)Capacity;
+#endif
+    }
+
+    void AddSphere(const JoystickVector& Center, float Radius, int Segments, DebugDrawColor Color)
+    {
+#if VIRTUAL_JOYSTICK_DEBUG_DRAW
+        Add(DEBUG_DRAW_SPHERE, Center, Center, Radius, Segments, Color);
+#else
+        (void)Center; (void)Radius; (void)Segments; (void)Color;
+#endif
+    }
+
+    void AddLine(const JoystickVector& Start, const JoystickVector& End, DebugDrawColor Color)
+    {
+#if VIRTUAL_JOYSTICK_DEBUG_DRAW
+        Add(DEBUG_DRAW_LINE, Start, End, 0.f, 0, Color);
+#else
+        (void)Start; (void)End; (void)Color;
+#endif
+    }
+
+    void AddCylinder(const JoystickVector& Start, const JoystickVector& End, float Radius, int Segments, DebugDrawColor Color)
+    {
+#if VIRTUAL_JOYSTICK_DEBUG_DRAW
+        Add(DEBUG_DRAW_CYLINDER, Start, End, Radius, Segments, Color);
+#else
+        (void)Start; (void)End; (void)Radius; (void)Segments; (void)Color;
+#endif
+    }
+
+    /*
+     Draws everything recorded since the last flush with the backend, then clears the buffer
+     */
+    void Flush(IDebugDrawBackend& Backend)
+    {
+        if (Count > 0) {
+            Backend.DrawPrimitives(&Primitives[0], Count);
+        }
+        Clear();
+    }
+
+    /*
+     Drops the recorded primitives without drawing them
+     */
+    void Clear()
+    {
+        Count = 0;
+    }
+
+    size_t GetCount() const
+    {
+        return Count;
+    }
+
+    size_t GetCapacity() const
+    {
+        return Primitives.size();
+    }
+
+    const DebugDrawPrimitive* GetPrimitives() const
+    {
+        return Primitives.empty() ? nullptr : &Primitives[0];
+    }
+
+    /*
+     Total number of primitives that did not fit, since construction
+     */
+    uint64_t GetDroppedCount() const
+    {
+        return Dropped;
+    }
+
+protected:
+
+    void Add(DebugDrawPrimitiveType Type, const JoystickVector& Start, const JoystickVector& End, float Radius, int Segments, DebugDrawColor Color)
+    {
+        if (Count == Primitives.size()) {
+            Dropped++;
+            return;
+        }
+        DebugDrawPrimitive& Primitive = Primitives[Count++];
+        Primitive.Type = Type;
+        Primitive.Start = Start;
+        Primitive.End = End;
+        Primitive.Radius = Radius;
+        Primitive.Segments = Segments;
+        Primitive.Color = Color;
+    }
+
+    std::vector<DebugDrawPrimitive> Primitives;
+    size_t Count;
+    uint64_t Dropped;
+};
+
+/**
+ * Headless backend: counts primitives per type and per flush, and optionally writes one text line per primitive to a file,
+ * so the cost of the visualization can be measured and its output compared without a renderer
+ */
+class CountingDebugDrawBackend : public IDebugDrawBackend
+{
+public:
+    /*
+     Output is not owned, nullptr means count only
+     */
+    explicit CountingDebugDrawBackend(FILE* Output = nullptr)
+    {
+        this->Output = Output;
+        Reset();
+    }
+
+    void Reset()
+    {
+        Flushes = 0;
+        for (int i = 0; i < DEBUG_DRAW_PRIMITIVE_TYPE_COUNT; i++) {
+            Counts[i] = 0;
+        }
+    }
+
+    virtual void DrawPrimitives(const DebugDrawPrimitive* Primitives, size_t Count) override
+    {
+        for (size_t i = 0; i < Count; i++) {
+            const DebugDrawPrimitive& Primitive = Primitives[i];
+            Counts[Primitive.Type]++;
+            if (Output != nullptr) {
+                static const char* TypeNames[DEBUG_DRAW_PRIMITIVE_TYPE_COUNT] = { "sphere", "line", "cylinder" };
+                fprintf(Output, "%llu %s %g %g %g %g %g %g %g %d %02x%02x%02x%02x\n", (unsigned long long)Flushes, TypeNames[Primitive.Type],
+                        Primitive.Start.X, Primitive.Start.Y, Primitive.Start.Z, Primitive.End.X, Primitive.End.Y, Primitive.End.Z,
+                        Primitive.Radius, Primitive.Segments, Primitive.Color.R, Primitive.Color.G, Primitive.Color.B, Primitive.Color.A);
+            }
+        }
+        Flushes++;
+    }
+
+    uint64_t GetCount(DebugDrawPrimitiveType Type) const
+    {
+        return Counts[Type];
+    }
+
+    uint64_t GetTotalCount() const
+    {
+        uint64_t Total = 0;
+        for (int i = 0; i < DEBUG_DRAW_PRIMITIVE_TYPE_COUNT; i++) {
+            Total += Counts[i];
+        }
+        return Total;
+    }
+
+    /*
+     Number of non-empty flushes
+     */
+    uint64_t GetFlushCount() const
+    {
+        return Flushes;
+    }
+
+protected:
+    FILE* Output;
+    uint64_t Flushes;
+    uint64_t Counts[DEBUG_DRAW_PRIMITIVE_TYPE_COUNT];
+};
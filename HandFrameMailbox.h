@@ -0,0 +1,167 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#pragma once
+
+/*
+ Snapshot of the mailbox counters
+ */
+struct HandFrameMailboxStats
+{
+    uint64_t FramesPublished;
+    uint64_t FramesConsumed;   // distinct frames the consumer actually got
+    uint64_t FramesDropped;    // published but overwritten by a newer frame before the consumer looked
+    uint64_t FramesReused;     // consumer asked but nothing new had been published, so it got the previous frame again
+    int64_t LastLatencyNanoseconds; // publish to consume of the last consumed frame
+    int64_t MaxLatencyNanoseconds;
+    int64_t TotalLatencyNanoseconds; // divide by FramesConsumed for the mean
+};
+
+/**
+ * Lock-free single producer / single consumer "latest value" mailbox implemented as a triple buffer.
+ * The producer always has a slot to write into and the consumer always has a slot to read from, and they swap slots through one atomic exchange,
+ * so both Publish() and Consume() are wait-free and never copy more than the producer's own write.
+ * Meant for handing hand frames from a tracking thread to the game thread, where only the newest frame matters.
+ */
+template <typename T>
+class HandFrameMailbox
+{
+public:
+    HandFrameMailbox()
+    {
+        ProducerIndex = 0;
+        SharedState.store(1, std::memory_order_relaxed);
+        ConsumerIndex = 2;
+        for (int i = 0; i < 3; i++) {
+            PublishTimes[i] = 0;
+        }
+        HasConsumed = false;
+        FramesPublished.store(0, std::memory_order_relaxed);
+        FramesConsumed.store(0, std::memory_order_relaxed);
+        FramesDropped.store(0, std::memory_order_relaxed);
+        FramesReused.store(0, std::memory_order_relaxed);
+        LastLatencyNanoseconds.store(0, std::memory_order_relaxed);
+        MaxLatencyNanoseconds.store(0, std::memory_order_relaxed);
+        TotalLatencyNanoseconds.store(0, std::memory_order_relaxed);
+    }
+
+    /*
+     Producer side: the slot to fill in before calling Publish().  Only the producer thread may touch it.
+     */
+    T& GetWriteSlot()
+    {
+        return Slots[ProducerIndex];
+    }
+
+    /*
+     Producer side: makes the write slot the newest frame
+     */
+    void Publish()
+    {
+        PublishTimes[ProducerIndex] = Now();
+        uint32_t Previous = SharedState.exchange(ProducerIndex | FRESH_BIT, std::memory_order_acq_rel);
+        if (Previous & FRESH_BIT) {
+            FramesDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        ProducerIndex = Previous & INDEX_MASK;
+        FramesPublished.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /*
+     Consumer side: returns the newest published frame, or nullptr if nothing was ever published.
+     If nothing new was published since the last call the previous frame is returned again (and counted as reused).  The pointer stays valid until the next Consume().
+     */
+    const T* Consume()
+    {
+        if (SharedState.load(std::memory_order_relaxed) & FRESH_BIT) {
+            uint32_t Previous = SharedState.exchange(ConsumerIndex, std::memory_order_acq_rel);
+            ConsumerIndex = Previous & INDEX_MASK;
+            HasConsumed = true;
+            int64_t Latency = Now() - PublishTimes[ConsumerIndex];
+            FramesConsumed.fetch_add(1, std::memory_order_relaxed);
+            LastLatencyNanoseconds.store(Latency, std::memory_order_relaxed);
+            TotalLatencyNanoseconds.fetch_add(Latency, std::memory_order_relaxed);
+            if (Latency > MaxLatencyNanoseconds.load(std::memory_order_relaxed)) {
+                MaxLatencyNanoseconds.store(Latency, std::memory_order_relaxed);
+            }
+        }
+        else {
+            if (!HasConsumed) {
+                return nullptr;
+            }
+            FramesReused.fetch_add(1, std::memory_order_relaxed);
+        }
+        return &Slots[ConsumerIndex];
+    }
+
+    /*
+     Safe to call from any thread, the counters are read individually so they may be a frame apart from each other
+     */
+    HandFrameMailboxStats GetStats() const
+    {
+        HandFrameMailboxStats Stats;
+        Stats.FramesPublished = FramesPublished.load(std::memory_order_relaxed);
+        Stats.FramesConsumed = FramesConsumed.load(std::memory_order_relaxed);
+        Stats.FramesDropped = FramesDropped.load(std::memory_order_relaxed);
+        Stats.FramesReused = FramesReused.load(std::memory_order_relaxed);
+        Stats.LastLatencyNanoseconds = LastLatencyNanoseconds.load(std::memory_order_relaxed);
+        Stats.MaxLatencyNanoseconds = MaxLatencyNanoseconds.load(std::memory_order_relaxed);
+        Stats.TotalLatencyNanoseconds = TotalLatencyNanoseconds.load(std::memory_order_relaxed);
+        return Stats;
+    }
+
+protected:
+
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static const uint32_t INDEX_MASK = 3;
+    static const uint32_t FRESH_BIT = 4; // set when the shared slot holds a frame the consumer has not taken yet
+
+    T Slots[3];
+    int64_t PublishTimes[3]; // written by the producer before the release exchange, read by the consumer after the acquire
+
+    // producer and consumer state on separate cache lines so the two threads do not false share
+    alignas(64) std::atomic<uint32_t> SharedState; // index of the shared slot plus FRESH_BIT
+    alignas(64) uint32_t ProducerIndex;
+    std::atomic<uint64_t> FramesPublished;
+    std::atomic<uint64_t> FramesDropped;
+    alignas(64) uint32_t ConsumerIndex;
+    bool HasConsumed;
+    std::atomic<uint64_t> FramesConsumed;
+    std::atomic<uint64_t> FramesReused;
+    std::atomic<int64_t> LastLatencyNanoseconds;
+    std::atomic<int64_t> MaxLatencyNanoseconds;
+    std::atomic<int64_t> TotalLatencyNanoseconds;
+};
@@ -0,0 +1,496 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#if defined(PLATFORM_WINDOWS) && PLATFORM_WINDOWS
+// inside Unreal, windows.h has to be wrapped so its macros and types do not clash with the engine's
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#elif defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#pragma once
+
+/**
+ * Fixed-record binary capture format for the hand data that LeapInputReader extracts from each Leap frame.
+ *
+ * File layout: a 32 byte HandFrameFileHeader followed by tightly packed HandFrameRecord structs.  Every record has the same size and alignment so a
+ * replay can mmap the file and hand out pointers straight into the mapping, with no copying or parsing.  Values are stored in the native (little endian) layout.
+ */
+
+enum HandSide
+{
+    HAND_LEFT = 0,
+    HAND_RIGHT = 1,
+    HAND_COUNT = 2
+};
+
+/*
+ Same order as Leap::Finger::Type so the Leap finger type can be used as an index directly
+ */
+enum HandFinger
+{
+    FINGER_THUMB = 0,
+    FINGER_INDEX = 1,
+    FINGER_MIDDLE = 2,
+    FINGER_RING = 3,
+    FINGER_PINKY = 4,
+    FINGER_COUNT = 5
+};
+
+/*
+ Joints along one finger, base of the metacarpal to the tip.  Joint N is the start of Leap::Bone::Type N, the last one is the fingertip.
+ */
+enum FingerJoint
+{
+    FINGER_JOINT_METACARPAL = 0, // base of the metacarpal (carpometacarpal)
+    FINGER_JOINT_KNUCKLE = 1,    // metacarpophalangeal
+    FINGER_JOINT_MIDDLE = 2,     // proximal interphalangeal
+    FINGER_JOINT_END = 3,        // distal interphalangeal
+    FINGER_JOINT_TIP = 4,
+    FINGER_JOINT_COUNT = 5
+};
+
+/*
+ Joints of one hand: palm, wrist, then FINGER_JOINT_COUNT joints for each finger in HandFinger order (see HandJointIndex)
+ */
+enum HandJoint
+{
+    HAND_JOINT_PALM = 0,
+    HAND_JOINT_WRIST = 1,
+    HAND_JOINT_FIRST_FINGER = 2,
+    HAND_JOINT_COUNT = HAND_JOINT_FIRST_FINGER + FINGER_COUNT * FINGER_JOINT_COUNT
+};
+
+inline int HandJointIndex(int Finger, int Joint)
+{
+    return HAND_JOINT_FIRST_FINGER + Finger * FINGER_JOINT_COUNT + Joint;
+}
+
+/*
+ Bones along one finger, same order as Leap::Bone::Type.  Bone N goes from finger joint N to joint N + 1.
+ */
+enum FingerBone
+{
+    FINGER_BONE_METACARPAL = 0,
+    FINGER_BONE_PROXIMAL = 1,
+    FINGER_BONE_INTERMEDIATE = 2,
+    FINGER_BONE_DISTAL = 3,
+    FINGER_BONE_COUNT = 4
+};
+
+static const int HAND_BONE_COUNT = FINGER_COUNT * FINGER_BONE_COUNT;
+
+inline int HandBoneIndex(int Finger, int Bone)
+{
+    return Finger * FINGER_BONE_COUNT + Bone;
+}
+
+/*
+ Unit quaternion (x, y, z, w) of the right-handed basis with the given Y and Z axes (X = Y cross Z).
+ Y and Z are orthonormalized first, Z keeps its direction.  Building X from the other two means Leap's left-handed left hand bases come out as proper rotations too.
+ */
+inline void HandQuaternionFromAxes(const float* YAxis, const float* ZAxis, float* OutQuaternion)
+{
+    float Z[3] = { ZAxis[0], ZAxis[1], ZAxis[2] };
+    float Length = sqrtf(Z[0] * Z[0] + Z[1] * Z[1] + Z[2] * Z[2]);
+    if (Length == 0.f) {
+        Z[2] = 1.f;
+        Length = 1.f;
+    }
+    for (int Axis = 0; Axis < 3; Axis++) {
+        Z[Axis] /= Length;
+    }
+    float Dot = YAxis[0] * Z[0] + YAxis[1] * Z[1] + YAxis[2] * Z[2];
+    float Y[3] = { YAxis[0] - Dot * Z[0], YAxis[1] - Dot * Z[1], YAxis[2] - Dot * Z[2] };
+    Length = sqrtf(Y[0] * Y[0] + Y[1] * Y[1] + Y[2] * Y[2]);
+    if (Length == 0.f) {
+        // Y parallel to Z, any perpendicular axis will do
+        Y[0] = -Z[1];
+        Y[1] = Z[0];
+        Y[2] = 0.f;
+        if (Z[0] == 0.f && Z[1] == 0.f) {
+            Y[0] = 0.f;
+            Y[1] = 1.f;
+        }
+        Length = sqrtf(Y[0] * Y[0] + Y[1] * Y[1] + Y[2] * Y[2]);
+    }
+    for (int Axis = 0; Axis < 3; Axis++) {
+        Y[Axis] /= Length;
+    }
+    float X[3] = { Y[1] * Z[2] - Y[2] * Z[1], Y[2] * Z[0] - Y[0] * Z[2], Y[0] * Z[1] - Y[1] * Z[0] };
+    // rotation matrix with columns X, Y, Z to quaternion, branching on the largest diagonal term for precision
+    float Trace = X[0] + Y[1] + Z[2];
+    if (Trace > 0.f) {
+        float S = 0.5f / sqrtf(Trace + 1.f);
+        OutQuaternion[0] = (Y[2] - Z[1]) * S;
+        OutQuaternion[1] = (Z[0] - X[2]) * S;
+        OutQuaternion[2] = (X[1] - Y[0]) * S;
+        OutQuaternion[3] = 0.25f / S;
+    }
+    else if (X[0] > Y[1] && X[0] > Z[2]) {
+        float S = 2.f * sqrtf(1.f + X[0] - Y[1] - Z[2]);
+        OutQuaternion[0] = 0.25f * S;
+        OutQuaternion[1] = (Y[0] + X[1]) / S;
+        OutQuaternion[2] = (Z[0] + X[2]) / S;
+        OutQuaternion[3] = (Y[2] - Z[1]) / S;
+    }
+    else if (Y[1] > Z[2]) {
+        float S = 2.f * sqrtf(1.f + Y[1] - X[0] - Z[2]);
+        OutQuaternion[0] = (Y[0] + X[1]) / S;
+        OutQuaternion[1] = 0.25f * S;
+        OutQuaternion[2] = (Z[1] + Y[2]) / S;
+        OutQuaternion[3] = (Z[0] - X[2]) / S;
+    }
+    else {
+        float S = 2.f * sqrtf(1.f + Z[2] - X[0] - Y[1]);
+        OutQuaternion[0] = (Z[0] + X[2]) / S;
+        OutQuaternion[1] = (Z[1] + Y[2]) / S;
+        OutQuaternion[2] = 0.25f * S;
+        OutQuaternion[3] = (X[1] - Y[0]) / S;
+    }
+}
+
+/*
+ Column Axis (0 = X, 1 = Y, 2 = Z) of the rotation matrix of a unit quaternion, i.e. that unit axis rotated by the quaternion
+ */
+inline void HandQuaternionAxis(const float* Quaternion, int Axis, float* OutAxis)
+{
+    float X = Quaternion[0], Y = Quaternion[1], Z = Quaternion[2], W = Quaternion[3];
+    if (Axis == 0) {
+        OutAxis[0] = 1.f - 2.f * (Y * Y + Z * Z);
+        OutAxis[1] = 2.f * (X * Y + Z * W);
+        OutAxis[2] = 2.f * (X * Z - Y * W);
+    }
+    else if (Axis == 1) {
+        OutAxis[0] = 2.f * (X * Y - Z * W);
+        OutAxis[1] = 1.f - 2.f * (X * X + Z * Z);
+        OutAxis[2] = 2.f * (Y * Z + X * W);
+    }
+    else {
+        OutAxis[0] = 2.f * (X * Z + Y * W);
+        OutAxis[1] = 2.f * (Y * Z - X * W);
+        OutAxis[2] = 1.f - 2.f * (X * X + Y * Y);
+    }
+}
+
+enum HandRecordFlags
+{
+    HAND_RECORD_VALID = 1 // hand was tracked in this frame
+};
+
+/*
+ Full skeleton pose of one hand, everything in raw Leap coordinates (millimeters, Leap axes).  Joints are indexed by HandJoint / HandJointIndex(),
+ bones by HandBoneIndex().  Bone orientations are unit quaternions (x, y, z, w) built with HandQuaternionFromAxes() from the Leap bone basis,
+ so the Y axis points out of the back of the bone and -Z along it, as in Leap.
+ The joystick itself only uses the palm and the middle fingertip.  See HandPoseQuantization.h for the compact 16 bit form.
+ */
+struct HandRecord
+{
+    uint32_t Flags;
+    float Confidence;    // Leap::Hand::confidence(), 0 to 1
+    float GrabStrength;  // 0 open hand to 1 fist
+    float PinchStrength; // 0 to 1 thumb touching another finger
+    float Joints[HAND_JOINT_COUNT][3];
+    float PalmNormal[3];    // unit vector out of the palm
+    float PalmDirection[3]; // unit vector from the palm towards the fingers
+    float BoneOrientations[HAND_BONE_COUNT][4];
+
+    const float* GetPalmPosition() const
+    {
+        return Joints[HAND_JOINT_PALM];
+    }
+
+    const float* GetFingertipPosition(int Finger) const
+    {
+        return Joints[HandJointIndex(Finger, FINGER_JOINT_TIP)];
+    }
+};
+
+struct HandFrameRecord
+{
+    int64_t Timestamp; // Leap frame timestamp, microseconds
+    int64_t FrameId;
+    HandRecord Hands[HAND_COUNT]; // indexed by HandSide
+
+    bool IsValid() const
+    {
+        return ((Hands[HAND_LEFT].Flags | Hands[HAND_RIGHT].Flags) & HAND_RECORD_VALID) != 0;
+    }
+};
+
+struct HandFrameFileHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint32_t RecordSize;
+    uint32_t Reserved;
+    uint64_t FrameCount; // may be 0 if the recording was not closed cleanly, the replay trusts the file size instead
+    uint64_t Reserved2;
+};
+
+static const char HAND_FRAME_FILE_MAGIC[4] = { 'L', 'J', 'H', 'F' };
+static const uint32_t HAND_FRAME_FILE_VERSION = 3; // 2: all joints instead of palm and fingertips only, 3: full pose (bone orientations, palm normal/direction, grab/pinch, confidence)
+
+static_assert(sizeof(HandFrameFileHeader) == 32, "HandFrameFileHeader must stay 32 bytes so records stay 8 byte aligned in the mapping");
+static_assert(sizeof(HandFrameRecord) % 8 == 0, "HandFrameRecord size must keep following records 8 byte aligned");
+
+/**
+ * Appends HandFrameRecords to a capture file.  Records go through the stdio buffer, so the per-frame cost is a memcpy.
+ */
+class HandFrameRecorder
+{
+public:
+    HandFrameRecorder()
+    {
+        File = nullptr;
+        FrameCount = 0;
+    }
+
+    ~HandFrameRecorder()
+    {
+        Close();
+    }
+
+    bool Open(const char* Path)
+    {
+        Close();
+        File = fopen(Path, "wb");
+        if (File == nullptr) {
+            return false;
+        }
+        FrameCount = 0;
+        return WriteHeader();
+    }
+
+    bool IsOpen() const
+    {
+        return File != nullptr;
+    }
+
+    bool Write(const HandFrameRecord& Record)
+    {
+        if (File == nullptr || fwrite(&Record, sizeof(HandFrameRecord), 1, File) != 1) {
+            return false;
+        }
+        FrameCount++;
+        return true;
+    }
+
+    /*
+     Rewrites the header with the final frame count and closes the file
+     */
+    void Close()
+    {
+        if (File != nullptr) {
+            fseek(File, 0, SEEK_SET);
+            WriteHeader();
+            fclose(File);
+            File = nullptr;
+        }
+    }
+
+    uint64_t GetFrameCount() const
+    {
+        return FrameCount;
+    }
+
+protected:
+
+    bool WriteHeader()
+    {
+        HandFrameFileHeader Header;
+        memset(&Header, 0, sizeof(Header));
+        memcpy(Header.Magic, HAND_FRAME_FILE_MAGIC, sizeof(Header.Magic));
+        Header.Version = HAND_FRAME_FILE_VERSION;
+        Header.RecordSize = sizeof(HandFrameRecord);
+        Header.FrameCount = FrameCount;
+        return fwrite(&Header, sizeof(Header), 1, File) == 1;
+    }
+
+    FILE* File;
+    uint64_t FrameCount;
+};
+
+/**
+ * Read-only memory mapping of a capture file.  GetFrame() returns pointers into the mapping, so opening a multi-hour session costs the same as opening a short one
+ * and the OS pages frames in as they are touched.
+ */
+class HandFrameReplay
+{
+public:
+    HandFrameReplay()
+    {
+        MappedData = nullptr;
+        MappedSize = 0;
+        Frames = nullptr;
+        FrameCount = 0;
+#if defined(_WIN32)
+        FileHandle = INVALID_HANDLE_VALUE;
+        MappingHandle = nullptr;
+#endif
+    }
+
+    ~HandFrameReplay()
+    {
+        Close();
+    }
+
+    bool Open(const char* Path)
+    {
+        Close();
+#if defined(_WIN32)
+        FileHandle = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (FileHandle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER FileSize;
+        if (!GetFileSizeEx(FileHandle, &FileSize) || FileSize.QuadPart < (LONGLONG)sizeof(HandFrameFileHeader)) {
+            Close();
+            return false;
+        }
+        MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (MappingHandle == nullptr) {
+            Close();
+            return false;
+        }
+        MappedData = MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+        MappedSize = (size_t)FileSize.QuadPart;
+#else
+        int FileDescriptor = open(Path, O_RDONLY);
+        if (FileDescriptor < 0) {
+            return false;
+        }
+        struct stat FileStat;
+        if (fstat(FileDescriptor, &FileStat) != 0 || FileStat.st_size < (off_t)sizeof(HandFrameFileHeader)) {
+            close(FileDescriptor);
+            return false;
+        }
+        MappedSize = (size_t)FileStat.st_size;
+        MappedData = mmap(nullptr, MappedSize, PROT_READ, MAP_SHARED, FileDescriptor, 0);
+        close(FileDescriptor); // the mapping keeps its own reference to the file
+        if (MappedData == MAP_FAILED) {
+            MappedData = nullptr;
+        }
+        else {
+            madvise(MappedData, MappedSize, MADV_SEQUENTIAL);
+        }
+#endif
+        if (MappedData == nullptr) {
+            Close();
+            return false;
+        }
+        const HandFrameFileHeader* Header = (const HandFrameFileHeader*)MappedData;
+        if (memcmp(Header->Magic, HAND_FRAME_FILE_MAGIC, sizeof(Header->Magic)) != 0 || Header->Version != HAND_FRAME_FILE_VERSION || Header->RecordSize != sizeof(HandFrameRecord)) {
+            Close();
+            return false;
+        }
+        Frames = (const HandFrameRecord*)((const char*)MappedData + sizeof(HandFrameFileHeader));
+        FrameCount = (MappedSize - sizeof(HandFrameFileHeader)) / sizeof(HandFrameRecord);
+        return true;
+    }
+
+    void Close()
+    {
+#if defined(_WIN32)
+        if (MappedData != nullptr) {
+            UnmapViewOfFile(MappedData);
+        }
+        if (MappingHandle != nullptr) {
+            CloseHandle(MappingHandle);
+        }
+        if (FileHandle != INVALID_HANDLE_VALUE) {
+            CloseHandle(FileHandle);
+        }
+        FileHandle = INVALID_HANDLE_VALUE;
+        MappingHandle = nullptr;
+#else
+        if (MappedData != nullptr) {
+            munmap(MappedData, MappedSize);
+        }
+#endif
+        MappedData = nullptr;
+        MappedSize = 0;
+        Frames = nullptr;
+        FrameCount = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return Frames != nullptr;
+    }
+
+    uint64_t GetFrameCount() const
+    {
+        return FrameCount;
+    }
+
+    /*
+     Pointer into the mapping, valid until Close().  No bounds check, the caller iterates up to GetFrameCount().
+     */
+    const HandFrameRecord* GetFrame(uint64_t Index) const
+    {
+        return Frames + Index;
+    }
+
+    const HandFrameRecord* GetFrames() const
+    {
+        return Frames;
+    }
+
+protected:
+    void* MappedData;
+    size_t MappedSize;
+    const HandFrameRecord* Frames;
+    uint64_t FrameCount;
+#if defined(_WIN32)
+    HANDLE FileHandle;
+    HANDLE MappingHandle;
+#endif
+
+private:
+    // copying would unmap the file twice
+    HandFrameReplay(const HandFrameReplay&);
+    HandFrameReplay& operator=(const HandFrameReplay&);
+};
@@ -0,0 +1,551 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cmath>
+#include <cstdint>
+#include "HandFrameRecord.h"
+#include "JoystickCore.h"
+
+#pragma once
+
+enum GestureEventType
+{
+    GESTURE_ACTIVATE,          // joystick activated, Value unused
+    GESTURE_DEACTIVATE,        // joystick deactivated, Value unused
+    GESTURE_PINCH_BRAKE_BEGIN, // Value is the pinch strength
+    GESTURE_PINCH_BRAKE_END,
+    GESTURE_FIST_STOP_BEGIN,   // Value is the grab strength
+    GESTURE_FIST_STOP_END,
+    GESTURE_SNAP_TURN,         // Value is the turn in degrees, positive to the right
+    GESTURE_EVENT_TYPE_COUNT
+};
+
+struct GestureEvent
+{
+    GestureEventType Type;
+    int Hand; // HandSide
+    float Value;
+    int64_t Timestamp; // of the frame that caused the event, microseconds
+    int64_t FrameId;
+};
+
+/*
+ What the gesture detectors see of one hand in one frame.  Locations are in Character space like the joystick input, a hand that is not tracked
+ keeps its last location (as LeapInputReader does).  Velocity is filled in by HandGestureEngine.
+ */
+struct GestureHandSample
+{
+    bool Tracked;
+    JoystickVector PalmLocation;
+    JoystickVector FingerLocation; // middle finger tip
+    float GrabStrength;
+    float PinchStrength;
+    JoystickVector PalmVelocity; // Character space units per second, smoothed
+    bool PalmVelocityValid;       // false until the hand was tracked in two frames in a row
+};
+
+struct GestureFrame
+{
+    int64_t Timestamp; // microseconds
+    int64_t FrameId;
+    GestureHandSample Hands[HAND_COUNT];
+};
+
+/*
+ Fixed capacity list of the events of one frame, it never allocates after construction
+ */
+class GestureEventQueue
+{
+public:
+    static const int CAPACITY = 32;
+
+    GestureEventQueue()
+    {
+        Count = 0;
+        DroppedCount = 0;
+    }
+
+    void Push(const GestureFrame& Frame, GestureEventType Type, int Hand, float Value)
+    {
+        if (Count >= CAPACITY) {
+            DroppedCount++;
+            return;
+        }
+        GestureEvent& Event = Events[Count++];
+        Event.Type = Type;
+        Event.Hand = Hand;
+        Event.Value = Value;
+        Event.Timestamp = Frame.Timestamp;
+        Event.FrameId = Frame.FrameId;
+    }
+
+    void Clear()
+    {
+        Count = 0;
+    }
+
+    int GetCount() const
+    {
+        return Count;
+    }
+
+    const GestureEvent& Get(int Index) const
+    {
+        return Events[Index];
+    }
+
+    uint64_t GetDroppedCount() const
+    {
+        return DroppedCount;
+    }
+
+protected:
+    GestureEvent Events[CAPACITY];
+    int Count;
+    uint64_t DroppedCount;
+};
+
+/**
+ * One gesture as a small state machine advanced by one frame at a time.  A detector keeps whatever it needs from earlier frames in its own members
+ * and must do a bounded amount of work per frame, never rescanning history.  It only pushes events when its state changes.
+ */
+class IGestureDetector
+{
+public:
+    virtual ~IGestureDetector() {}
+
+    virtual void Update(const GestureFrame& Frame, GestureEventQueue& Events) = 0;
+
+    /*
+     Back to the state before the first frame, e.g. when the hand tracking source is switched
+     */
+    virtual void Reset() = 0;
+
+    /*
+     Joystick tuning from HandGestureEngine::SetTuning(), only detectors that mirror the joystick state machine use it
+     */
+    virtual void SetTuning(const JoystickTuning& /*Tuning*/)
+    {
+    }
+};
+
+/*
+ Building block for the on/off gestures: goes on once the value has been at or above OnThreshold for MinFrames frames in a row and off once it
+ drops below OffThreshold, so a value hovering around one threshold does not flicker.  Update() returns true when the state changed.
+ */
+struct GestureHysteresis
+{
+    float OnThreshold;
+    float OffThreshold;
+    int MinFrames;
+
+    bool On;
+    int FramesAbove;
+
+    GestureHysteresis(float OnThreshold, float OffThreshold, int MinFrames)
+    {
+        this->OnThreshold = OnThreshold;
+        this->OffThreshold = OffThreshold;
+        this->MinFrames = MinFrames;
+        Reset();
+    }
+
+    void Reset()
+    {
+        On = false;
+        FramesAbove = 0;
+    }
+
+    bool Update(float Value)
+    {
+        if (!On) {
+            FramesAbove = Value >= OnThreshold ? FramesAbove + 1 : 0;
+            if (FramesAbove >= MinFrames) {
+                On = true;
+                return true;
+            }
+        }
+        else if (Value < OffThreshold) {
+            On = false;
+            FramesAbove = 0;
+            return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * Joystick activation and deactivation of one hand.  Runs the same state machine as VirtualJoystickCore::UpdateActivation() with the same tuning,
+ * so its events match what VirtualJoystick3D does with that hand.
+ */
+class ActivationGestureDetector : public IGestureDetector
+{
+public:
+    int Hand;
+    JoystickTuning Tuning; // must match the joystick's, HandGestureEngine::SetTuning() keeps it in sync
+
+    ActivationGestureDetector(int Hand = HAND_LEFT)
+    {
+        this->Hand = Hand;
+    }
+
+    virtual void SetTuning(const JoystickTuning& Tuning) override
+    {
+        this->Tuning = Tuning;
+    }
+
+    virtual void Update(const GestureFrame& Frame, GestureEventQueue& Events) override
+    {
+        const GestureHandSample& Sample = Frame.Hands[Hand];
+        bool WasActivated = State.IsActivated;
+        VirtualJoystickCore::UpdateActivation(Tuning, State, Sample.PalmLocation, Sample.FingerLocation);
+        if (State.IsActivated != WasActivated) {
+            Events.Push(Frame, State.IsActivated ? GESTURE_ACTIVATE : GESTURE_DEACTIVATE, Hand, 0.f);
+        }
+    }
+
+    virtual void Reset() override
+    {
+        State = JoystickState();
+    }
+
+    bool IsActivated() const
+    {
+        return State.IsActivated;
+    }
+
+protected:
+    JoystickState State;
+};
+
+/**
+ * Shared by the pinch and fist detectors: one tracked hand strength through a GestureHysteresis.  Losing the hand ends the gesture.
+ */
+class StrengthGestureDetector : public IGestureDetector
+{
+public:
+    int Hand;
+    GestureHysteresis Trigger;
+
+    StrengthGestureDetector(int Hand, float OnThreshold, float OffThreshold, int MinFrames, GestureEventType BeginType, float GestureHandSample::* Strength)
+        : Trigger(OnThreshold, OffThreshold, MinFrames)
+    {
+        this->Hand = Hand;
+        this->BeginType = BeginType;
+        this->Strength = Strength;
+    }
+
+    virtual void Update(const GestureFrame& Frame, GestureEventQueue& Events) override
+    {
+        const GestureHandSample& Sample = Frame.Hands[Hand];
+        float Value = Sample.Tracked ? Sample.*Strength : 0.f;
+        if (Trigger.Update(Value)) {
+            Events.Push(Frame, Trigger.On ? BeginType : (GestureEventType)(BeginType + 1), Hand, Value);
+        }
+    }
+
+    virtual void Reset() override
+    {
+        Trigger.Reset();
+    }
+
+    bool IsActive() const
+    {
+        return Trigger.On;
+    }
+
+protected:
+    GestureEventType BeginType; // the END type follows it in GestureEventType
+    float GestureHandSample::* Strength;
+};
+
+/**
+ * Pinch to brake: thumb and a finger together on the movement hand.  The game holds the character still between BEGIN and END.
+ */
+class PinchBrakeGestureDetector : public StrengthGestureDetector
+{
+public:
+    PinchBrakeGestureDetector(int Hand = HAND_LEFT)
+        : StrengthGestureDetector(Hand, 0.85f, 0.6f, 3, GESTURE_PINCH_BRAKE_BEGIN, &GestureHandSample::PinchStrength)
+    {
+    }
+};
+
+/**
+ * Fist to stop: closing the movement hand.  The game stops the character and ignores the joystick between BEGIN and END.
+ */
+class FistStopGestureDetector : public StrengthGestureDetector
+{
+public:
+    FistStopGestureDetector(int Hand = HAND_LEFT)
+        : StrengthGestureDetector(Hand, 0.9f, 0.7f, 3, GESTURE_FIST_STOP_BEGIN, &GestureHandSample::GrabStrength)
+    {
+    }
+};
+
+/**
+ * Swipe to snap turn: a fast sideways (Character Y) palm movement of the other hand turns the character by SnapAngle degrees in the swipe direction.
+ * The sideways speed has to stay above MinSpeed for MinFrames frames and be clearly larger than the forward/up speed, then the detector waits
+ * CooldownSeconds before it can fire again, so one swipe is one turn.
+ */
+class SwipeSnapTurnGestureDetector : public IGestureDetector
+{
+public:
+    int Hand;
+    float MinSpeed;        // Character space units (cm) per second
+    float DominanceRatio;  // sideways speed over the larger of the forward and up speeds
+    int MinFrames;
+    float CooldownSeconds;
+    float SnapAngle;       // degrees
+
+    SwipeSnapTurnGestureDetector(int Hand = HAND_RIGHT)
+    {
+        this->Hand = Hand;
+        MinSpeed = 80.f;
+        DominanceRatio = 2.f;
+        MinFrames = 2;
+        CooldownSeconds = 0.5f;
+        SnapAngle = 45.f;
+        Reset();
+    }
+
+    virtual void Update(const GestureFrame& Frame, GestureEventQueue& Events) override
+    {
+        const GestureHandSample& Sample = Frame.Hands[Hand];
+        if (CooldownEnd != 0 && Frame.Timestamp < CooldownEnd) {
+            return;
+        }
+        CooldownEnd = 0;
+        float Sideways = Sample.PalmVelocity.Y;
+        float Other = fmaxf(fabsf(Sample.PalmVelocity.X), fabsf(Sample.PalmVelocity.Z));
+        int Direction = 0;
+        if (Sample.Tracked && Sample.PalmVelocityValid && fabsf(Sideways) >= MinSpeed && fabsf(Sideways) >= DominanceRatio * Other) {
+            Direction = Sideways > 0.f ? 1 : -1;
+        }
+        if (Direction == 0 || Direction != SwipeDirection) {
+            SwipeDirection = Direction;
+            SwipeFrames = 0;
+        }
+        if (Direction != 0 && ++SwipeFrames >= MinFrames) {
+            Events.Push(Frame, GESTURE_SNAP_TURN, Hand, SnapAngle * (float)Direction);
+            CooldownEnd = Frame.Timestamp + (int64_t)(CooldownSeconds * 1e6f);
+            SwipeDirection = 0;
+            SwipeFrames = 0;
+        }
+    }
+
+    virtual void Reset() override
+    {
+        SwipeDirection = 0;
+        SwipeFrames = 0;
+        CooldownEnd = 0;
+    }
+
+protected:
+    int SwipeDirection;
+    int SwipeFrames;
+    int64_t CooldownEnd; // microseconds, 0 when not cooling down
+};
+
+/**
+ * Gesture events that are pushed to a listener as they happen instead of being polled
+ */
+class IGestureListener
+{
+public:
+    virtual ~IGestureListener() {}
+    virtual void OnGestureEvent(const GestureEvent& Event) = 0;
+};
+
+/**
+ * Runs a set of gesture detectors on every frame.  The per-hand features every detector needs (palm velocity) are computed once per frame here,
+ * then each detector advances its own state machine by that one frame; nothing looks back over earlier frames.  Detectors only produce events on
+ * transitions, so on a typical frame there are none and nothing is dispatched.  Detectors and the listener are not owned, nothing is allocated.
+ *
+ * Typical use with the detectors the joystick needs:
+ *     ActivationGestureDetector Activation(HAND_LEFT);
+ *     PinchBrakeGestureDetector PinchBrake(HAND_LEFT);
+ *     FistStopGestureDetector FistStop(HAND_LEFT);
+ *     SwipeSnapTurnGestureDetector SnapTurn(HAND_RIGHT);
+ *     Engine.AddDetector(&Activation); ...
+ *     Reader->SetGestureEngine(&Engine);
+ *     Engine.SetTuning(VirtualJoystick->GetTuning()); // not needed when the reader follows a JoystickConfigStore
+ * and after every UpdateHandLocations() read Engine.GetEvents().
+ */
+class HandGestureEngine
+{
+public:
+    static const int MAX_DETECTORS = 16;
+
+    float VelocitySmoothing; // 0 is the raw frame to frame velocity, towards 1 smoother and slower
+
+    HandGestureEngine()
+    {
+        VelocitySmoothing = 0.5f;
+        DetectorCount = 0;
+        Listener = nullptr;
+        Reset();
+    }
+
+    bool AddDetector(IGestureDetector* Detector)
+    {
+        if (DetectorCount >= MAX_DETECTORS) {
+            return false;
+        }
+        Detectors[DetectorCount++] = Detector;
+        Detector->SetTuning(Tuning);
+        return true;
+    }
+
+    /*
+     Hands the joystick tuning to every detector, now and to detectors added later, so activation events follow the joystick's activation disk.
+     Call it again whenever the joystick tuning changes; LeapInputReader does so for every new config snapshot.
+     */
+    void SetTuning(const JoystickTuning& Tuning)
+    {
+        this->Tuning = Tuning;
+        for (int i = 0; i < DetectorCount; i++) {
+            Detectors[i]->SetTuning(Tuning);
+        }
+    }
+
+    void SetListener(IGestureListener* Listener)
+    {
+        this->Listener = Listener;
+    }
+
+    /*
+     Resets the engine and every detector
+     */
+    void Reset()
+    {
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            PreviousTracked[HandIndex] = false;
+            PreviousPalm[HandIndex] = JoystickVector();
+            Velocity[HandIndex] = JoystickVector();
+        }
+        PreviousTimestamp = 0;
+        HasPreviousFrame = false;
+        Frame = GestureFrame();
+        for (int i = 0; i < DetectorCount; i++) {
+            Detectors[i]->Reset();
+        }
+        Events.Clear();
+    }
+
+    /*
+     Advances every detector by one frame.  Hands only needs Tracked, the locations and the strengths filled in.
+     The events of this frame replace those of the previous one.  The same tracker frame seen again (the game ticks faster than the tracker, or
+     an AsyncHandTrackingSource returns its last frame) only clears the events: velocities and detector frame counts follow tracker frames, not ticks.
+     */
+    void Update(int64_t Timestamp, int64_t FrameId, const GestureHandSample Hands[HAND_COUNT])
+    {
+        if (HasPreviousFrame && FrameId == Frame.FrameId && Timestamp == PreviousTimestamp) {
+            Events.Clear();
+            return;
+        }
+        HasPreviousFrame = true;
+        Frame.Timestamp = Timestamp;
+        Frame.FrameId = FrameId;
+        float Seconds = (float)(Timestamp - PreviousTimestamp) * 1e-6f;
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            GestureHandSample& Sample = Frame.Hands[HandIndex];
+            Sample = Hands[HandIndex];
+            Sample.PalmVelocityValid = Sample.Tracked && PreviousTracked[HandIndex] && Seconds > 0.f;
+            if (Sample.PalmVelocityValid) {
+                const JoystickVector& Palm = Sample.PalmLocation;
+                JoystickVector& Smoothed = Velocity[HandIndex];
+                Smoothed.X = VelocitySmoothing * Smoothed.X + (1.f - VelocitySmoothing) * (Palm.X - PreviousPalm[HandIndex].X) / Seconds;
+                Smoothed.Y = VelocitySmoothing * Smoothed.Y + (1.f - VelocitySmoothing) * (Palm.Y - PreviousPalm[HandIndex].Y) / Seconds;
+                Smoothed.Z = VelocitySmoothing * Smoothed.Z + (1.f - VelocitySmoothing) * (Palm.Z - PreviousPalm[HandIndex].Z) / Seconds;
+            }
+            else {
+                Velocity[HandIndex] = JoystickVector();
+            }
+            Sample.PalmVelocity = Velocity[HandIndex];
+            PreviousTracked[HandIndex] = Sample.Tracked;
+            PreviousPalm[HandIndex] = Sample.PalmLocation;
+        }
+        PreviousTimestamp = Timestamp;
+
+        Events.Clear();
+        for (int i = 0; i < DetectorCount; i++) {
+            Detectors[i]->Update(Frame, Events);
+        }
+        if (Listener != nullptr) {
+            for (int i = 0; i < Events.GetCount(); i++) {
+                Listener->OnGestureEvent(Events.Get(i));
+            }
+        }
+    }
+
+    /*
+     Same as above taking the tracked flags and strengths from a captured frame and the Character space palm and middle fingertip of both hands
+     (indexed by HandSide) from elsewhere, e.g. the held locations of a HandLocationTracker as LeapInputReader passes them.
+     */
+    void Update(const HandFrameRecord& Record, const JoystickVector PalmLocations[HAND_COUNT], const JoystickVector FingerLocations[HAND_COUNT])
+    {
+        GestureHandSample Hands[HAND_COUNT];
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            const HandRecord& Hand = Record.Hands[HandIndex];
+            GestureHandSample& Sample = Hands[HandIndex];
+            Sample.Tracked = (Hand.Flags & HAND_RECORD_VALID) != 0;
+            Sample.PalmLocation = PalmLocations[HandIndex];
+            Sample.FingerLocation = FingerLocations[HandIndex];
+            Sample.GrabStrength = Hand.GrabStrength;
+            Sample.PinchStrength = Hand.PinchStrength;
+        }
+        Update(Record.Timestamp, Record.FrameId, Hands);
+    }
+
+    const GestureEventQueue& GetEvents() const
+    {
+        return Events;
+    }
+
+    /*
+     This frame's input to the detectors, including the palm velocities
+     */
+    const GestureFrame& GetFrame() const
+    {
+        return Frame;
+    }
+
+protected:
+    IGestureDetector* Detectors[MAX_DETECTORS];
+    int DetectorCount;
+    IGestureListener* Listener;
+    JoystickTuning Tuning;
+    GestureFrame Frame;
+    GestureEventQueue Events;
+    bool PreviousTracked[HAND_COUNT];
+    JoystickVector PreviousPalm[HAND_COUNT];
+    JoystickVector Velocity[HAND_COUNT];
+    int64_t PreviousTimestamp;
+    bool HasPreviousFrame;
+};
@@ -0,0 +1,250 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include "HandFrameRecord.h"
+#include "HandSpaceTransform.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#define HAND_JOINTS_USE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAND_JOINTS_USE_SSE 1
+#endif
+
+#pragma once
+
+// GCC contracts a * b + c into an FMA when the target has one (even for the _mm_mul_ps/_mm_add_ps intrinsics), which rounds differently, so every kernel opts out
+#if defined(__GNUC__) && !defined(__clang__)
+#define HAND_JOINTS_NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define HAND_JOINTS_NO_FP_CONTRACT
+#endif
+
+/*
+ Both hands worth of joints, padded up to a multiple of 8 so the SIMD kernels never need a remainder loop
+ */
+static const int HAND_JOINT_BUFFER_CAPACITY = ((HAND_COUNT * HAND_JOINT_COUNT + 7) / 8) * 8;
+
+/**
+ * Structure-of-arrays buffer with every joint of both hands in Leap, world and Character space.
+ * Joint I of hand H lives at index H * HAND_JOINT_COUNT + I in every array (see GetIndex()).
+ * The arrays are aligned when the buffer is, but the kernels use unaligned loads so a buffer inside a heap allocated object (where new may only give 16 byte alignment) is fine too.
+ */
+struct HandJointBuffer
+{
+    alignas(32) float LeapX[HAND_JOINT_BUFFER_CAPACITY];
+    alignas(32) float LeapY[HAND_JOINT_BUFFER_CAPACITY];
+    alignas(32) float LeapZ[HAND_JOINT_BUFFER_CAPACITY];
+    alignas(32) float WorldX[HAND_JOINT_BUFFER_CAPACITY];
+    alignas(32) float WorldY[HAND_JOINT_BUFFER_CAPACITY];
+    alignas(32) float WorldZ[HAND_JOINT_BUFFER_CAPACITY];
+    alignas(32) float CharacterX[HAND_JOINT_BUFFER_CAPACITY];
+    alignas(32) float CharacterY[HAND_JOINT_BUFFER_CAPACITY];
+    alignas(32) float CharacterZ[HAND_JOINT_BUFFER_CAPACITY];
+    uint32_t HandFlags[HAND_COUNT]; // HandRecordFlags of the last loaded frame
+
+    HandJointBuffer()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+
+    static int GetIndex(int Hand, int Joint)
+    {
+        return Hand * HAND_JOINT_COUNT + Joint;
+    }
+
+    /*
+     Transposes the joints of a frame into the Leap arrays.  Hands that are not valid in the frame keep their previous positions.
+     */
+    void Load(const HandFrameRecord& Frame)
+    {
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            const HandRecord& Hand = Frame.Hands[HandIndex];
+            HandFlags[HandIndex] = Hand.Flags;
+            if (!(Hand.Flags & HAND_RECORD_VALID)) {
+                continue;
+            }
+            const int FirstIndex = GetIndex(HandIndex, 0);
+            for (int JointIndex = 0; JointIndex < HAND_JOINT_COUNT; JointIndex++) {
+                LeapX[FirstIndex + JointIndex] = Hand.Joints[JointIndex][0];
+                LeapY[FirstIndex + JointIndex] = Hand.Joints[JointIndex][1];
+                LeapZ[FirstIndex + JointIndex] = Hand.Joints[JointIndex][2];
+            }
+        }
+    }
+
+    JoystickVector GetWorldLocation(int Hand, int Joint) const
+    {
+        const int Index = GetIndex(Hand, Joint);
+        return HandSpacePose::MakeVector(WorldX[Index], WorldY[Index], WorldZ[Index]);
+    }
+
+    JoystickVector GetCharacterLocation(int Hand, int Joint) const
+    {
+        const int Index = GetIndex(Hand, Joint);
+        return HandSpacePose::MakeVector(CharacterX[Index], CharacterY[Index], CharacterZ[Index]);
+    }
+};
+
+/**
+ * Transforms every joint of a HandJointBuffer from Leap to world and Character space in one pass.
+ * The SIMD kernels do exactly the same multiplies and adds in the same order as the scalar one, so results are bit for bit identical as long as the compiler does not
+ * contract the multiplies and adds into fused multiply-adds (all kernels switch contraction off where the compiler allows it).
+ */
+class HandJointTransform
+{
+public:
+
+    /*
+     Uses the widest kernel available for the target (AVX, SSE2, else scalar)
+     */
+    static void Transform(const HandSpaceFrameTransform& FrameTransform, HandJointBuffer& Joints)
+    {
+#if defined(HAND_JOINTS_USE_AVX)
+        TransformAVX(FrameTransform, Joints);
+#elif defined(HAND_JOINTS_USE_SSE)
+        TransformSSE(FrameTransform, Joints);
+#else
+        TransformScalar(FrameTransform, Joints);
+#endif
+    }
+
+    HAND_JOINTS_NO_FP_CONTRACT static void TransformScalar(const HandSpaceFrameTransform& FrameTransform, HandJointBuffer& Joints)
+    {
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+        const float (*M)[4] = FrameTransform.LeapToWorld;
+        const float (*C)[4] = FrameTransform.WorldToCharacter;
+        for (int i = 0; i < HAND_JOINT_BUFFER_CAPACITY; i++) {
+            const float X = Joints.LeapX[i];
+            const float Y = Joints.LeapY[i];
+            const float Z = Joints.LeapZ[i];
+            const float WorldX = Accumulate(M[0], X, Y, Z);
+            const float WorldY = Accumulate(M[1], X, Y, Z);
+            const float WorldZ = Accumulate(M[2], X, Y, Z);
+            Joints.WorldX[i] = WorldX;
+            Joints.WorldY[i] = WorldY;
+            Joints.WorldZ[i] = WorldZ;
+            Joints.CharacterX[i] = Accumulate(C[0], WorldX, WorldY, WorldZ);
+            Joints.CharacterY[i] = Accumulate(C[1], WorldX, WorldY, WorldZ);
+            Joints.CharacterZ[i] = Accumulate(C[2], WorldX, WorldY, WorldZ);
+        }
+    }
+
+#if defined(HAND_JOINTS_USE_SSE) || defined(HAND_JOINTS_USE_AVX)
+    HAND_JOINTS_NO_FP_CONTRACT static void TransformSSE(const HandSpaceFrameTransform& FrameTransform, HandJointBuffer& Joints)
+    {
+        __m128 M[3][4];
+        __m128 C[3][4];
+        for (int Row = 0; Row < 3; Row++) {
+            for (int Column = 0; Column < 4; Column++) {
+                M[Row][Column] = _mm_set1_ps(FrameTransform.LeapToWorld[Row][Column]);
+                C[Row][Column] = _mm_set1_ps(FrameTransform.WorldToCharacter[Row][Column]);
+            }
+        }
+        for (int i = 0; i < HAND_JOINT_BUFFER_CAPACITY; i += 4) {
+            const __m128 X = _mm_loadu_ps(Joints.LeapX + i);
+            const __m128 Y = _mm_loadu_ps(Joints.LeapY + i);
+            const __m128 Z = _mm_loadu_ps(Joints.LeapZ + i);
+            const __m128 WorldX = AccumulateSSE(M[0], X, Y, Z);
+            const __m128 WorldY = AccumulateSSE(M[1], X, Y, Z);
+            const __m128 WorldZ = AccumulateSSE(M[2], X, Y, Z);
+            _mm_storeu_ps(Joints.WorldX + i, WorldX);
+            _mm_storeu_ps(Joints.WorldY + i, WorldY);
+            _mm_storeu_ps(Joints.WorldZ + i, WorldZ);
+            _mm_storeu_ps(Joints.CharacterX + i, AccumulateSSE(C[0], WorldX, WorldY, WorldZ));
+            _mm_storeu_ps(Joints.CharacterY + i, AccumulateSSE(C[1], WorldX, WorldY, WorldZ));
+            _mm_storeu_ps(Joints.CharacterZ + i, AccumulateSSE(C[2], WorldX, WorldY, WorldZ));
+        }
+    }
+#endif
+
+#if defined(HAND_JOINTS_USE_AVX)
+    HAND_JOINTS_NO_FP_CONTRACT static void TransformAVX(const HandSpaceFrameTransform& FrameTransform, HandJointBuffer& Joints)
+    {
+        __m256 M[3][4];
+        __m256 C[3][4];
+        for (int Row = 0; Row < 3; Row++) {
+            for (int Column = 0; Column < 4; Column++) {
+                M[Row][Column] = _mm256_set1_ps(FrameTransform.LeapToWorld[Row][Column]);
+                C[Row][Column] = _mm256_set1_ps(FrameTransform.WorldToCharacter[Row][Column]);
+            }
+        }
+        for (int i = 0; i < HAND_JOINT_BUFFER_CAPACITY; i += 8) {
+            const __m256 X = _mm256_loadu_ps(Joints.LeapX + i);
+            const __m256 Y = _mm256_loadu_ps(Joints.LeapY + i);
+            const __m256 Z = _mm256_loadu_ps(Joints.LeapZ + i);
+            const __m256 WorldX = AccumulateAVX(M[0], X, Y, Z);
+            const __m256 WorldY = AccumulateAVX(M[1], X, Y, Z);
+            const __m256 WorldZ = AccumulateAVX(M[2], X, Y, Z);
+            _mm256_storeu_ps(Joints.WorldX + i, WorldX);
+            _mm256_storeu_ps(Joints.WorldY + i, WorldY);
+            _mm256_storeu_ps(Joints.WorldZ + i, WorldZ);
+            _mm256_storeu_ps(Joints.CharacterX + i, AccumulateAVX(C[0], WorldX, WorldY, WorldZ));
+            _mm256_storeu_ps(Joints.CharacterY + i, AccumulateAVX(C[1], WorldX, WorldY, WorldZ));
+            _mm256_storeu_ps(Joints.CharacterZ + i, AccumulateAVX(C[2], WorldX, WorldY, WorldZ));
+        }
+    }
+#endif
+
+protected:
+
+    // One matrix row: ((Row[0] * X + Row[1] * Y) + Row[2] * Z) + Row[3], the same order in every kernel
+
+    HAND_JOINTS_NO_FP_CONTRACT static float Accumulate(const float* Row, float X, float Y, float Z)
+    {
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+        float Sum = Row[0] * X;
+        Sum = Sum + Row[1] * Y;
+        Sum = Sum + Row[2] * Z;
+        return Sum + Row[3];
+    }
+
+#if defined(HAND_JOINTS_USE_SSE) || defined(HAND_JOINTS_USE_AVX)
+    HAND_JOINTS_NO_FP_CONTRACT static __m128 AccumulateSSE(const __m128* Row, __m128 X, __m128 Y, __m128 Z)
+    {
+        __m128 Sum = _mm_mul_ps(Row[0], X);
+        Sum = _mm_add_ps(Sum, _mm_mul_ps(Row[1], Y));
+        Sum = _mm_add_ps(Sum, _mm_mul_ps(Row[2], Z));
+        return _mm_add_ps(Sum, Row[3]);
+    }
+#endif
+
+#if defined(HAND_JOINTS_USE_AVX)
+    HAND_JOINTS_NO_FP_CONTRACT static __m256 AccumulateAVX(const __m256* Row, __m256 X, __m256 Y, __m256 Z)
+    {
+        __m256 Sum = _mm256_mul_ps(Row[0], X);
+        Sum = _mm256_add_ps(Sum, _mm256_mul_ps(Row[1], Y));
+        Sum = _mm256_add_ps(Sum, _mm256_mul_ps(Row[2], Z));
+        return _mm256_add_ps(Sum, Row[3]);
+    }
+#endif
+};
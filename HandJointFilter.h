@@ -0,0 +1,158 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include "HandJointBuffer.h"
+
+#pragma once
+
+/*
+ Latency/smoothness trade-off of the filter.  MinCutoff and Beta are the usual One Euro filter parameters: lower MinCutoff removes more jitter when the hand is
+ still, higher Beta removes more lag when the hand moves fast.  PredictionSeconds extrapolates the filtered position forward with the filtered velocity,
+ to make up for the frame or two between the Leap frame timestamp and the time the result is displayed.
+ */
+struct HandFilterSettings
+{
+    bool Enabled;
+    float MinCutoff;        // Hz
+    float Beta;             // Hz per (millimeter / second)
+    float DerivativeCutoff; // Hz, smoothing of the velocity estimate
+    float PredictionSeconds;
+
+    HandFilterSettings()
+    {
+        Enabled = false;
+        MinCutoff = 1.5;
+        Beta = 0.05;
+        DerivativeCutoff = 1.0;
+        PredictionSeconds = 0.0;
+    }
+};
+
+/**
+ * One Euro filter with constant velocity prediction, run on every joint of a HandJointBuffer in Leap space (where the tracker jitter is), before the transform
+ * to world and Character space.  State is kept in the same structure-of-arrays layout as the buffer, so one filter step is a few multiplies per coordinate and the
+ * loops vectorize.
+ */
+class HandJointFilter
+{
+public:
+    HandJointFilter()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+
+    /*
+     Filters the Leap positions of the tracked hands in place.  TimestampMicros is the frame timestamp, a frame with the same timestamp as the previous one
+     (the source had nothing new) gets the same output again instead of advancing the filter.
+     */
+    void Apply(HandJointBuffer& Joints, int64_t TimestampMicros, const HandFilterSettings& Settings)
+    {
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            if (!(Joints.HandFlags[HandIndex] & HAND_RECORD_VALID)) {
+                HandInitialized[HandIndex] = false; // start over once the hand comes back, instead of filtering across the gap
+                continue;
+            }
+            const int First = HandJointBuffer::GetIndex(HandIndex, 0);
+            if (HandInitialized[HandIndex] && TimestampMicros < LastTimestamp[HandIndex]) {
+                HandInitialized[HandIndex] = false; // time went backwards (replay looped or seeked, Leap service restarted), start over like for a new hand
+            }
+            if (!HandInitialized[HandIndex]) {
+                for (int i = First; i < First + HAND_JOINT_COUNT; i++) {
+                    FilteredX[i] = Joints.LeapX[i];
+                    FilteredY[i] = Joints.LeapY[i];
+                    FilteredZ[i] = Joints.LeapZ[i];
+                    VelocityX[i] = 0.f;
+                    VelocityY[i] = 0.f;
+                    VelocityZ[i] = 0.f;
+                }
+                HandInitialized[HandIndex] = true;
+                LastTimestamp[HandIndex] = TimestampMicros;
+            }
+            else if (TimestampMicros > LastTimestamp[HandIndex]) {
+                const float DeltaSeconds = (TimestampMicros - LastTimestamp[HandIndex]) * 1e-6f;
+                LastTimestamp[HandIndex] = TimestampMicros;
+                Step(Joints, First, DeltaSeconds, Settings);
+            }
+            for (int i = First; i < First + HAND_JOINT_COUNT; i++) {
+                Joints.LeapX[i] = FilteredX[i] + VelocityX[i] * Settings.PredictionSeconds;
+                Joints.LeapY[i] = FilteredY[i] + VelocityY[i] * Settings.PredictionSeconds;
+                Joints.LeapZ[i] = FilteredZ[i] + VelocityZ[i] * Settings.PredictionSeconds;
+            }
+        }
+    }
+
+protected:
+
+    void Step(const HandJointBuffer& Joints, int First, float DeltaSeconds, const HandFilterSettings& Settings)
+    {
+        const float DerivativeAlpha = SmoothingFactor(Settings.DerivativeCutoff, DeltaSeconds);
+        const float InverseDelta = 1.f / DeltaSeconds;
+        // alpha = 1 / (1 + tau / dt) with tau = 1 / (2 pi cutoff), rearranged to one division: w / (w + 1) with w = 2 pi cutoff dt
+        const float MinCutoffW = 2.f * HAND_FILTER_PI * Settings.MinCutoff * DeltaSeconds;
+        const float BetaW = 2.f * HAND_FILTER_PI * Settings.Beta * DeltaSeconds;
+        for (int i = First; i < First + HAND_JOINT_COUNT; i++) {
+            const float X = Joints.LeapX[i];
+            const float Y = Joints.LeapY[i];
+            const float Z = Joints.LeapZ[i];
+            // smoothed velocity first, its magnitude sets how much this joint is smoothed
+            const float VX = VelocityX[i] + DerivativeAlpha * ((X - FilteredX[i]) * InverseDelta - VelocityX[i]);
+            const float VY = VelocityY[i] + DerivativeAlpha * ((Y - FilteredY[i]) * InverseDelta - VelocityY[i]);
+            const float VZ = VelocityZ[i] + DerivativeAlpha * ((Z - FilteredZ[i]) * InverseDelta - VelocityZ[i]);
+            const float W = MinCutoffW + BetaW * sqrtf(VX * VX + VY * VY + VZ * VZ);
+            const float Alpha = W / (W + 1.f);
+            VelocityX[i] = VX;
+            VelocityY[i] = VY;
+            VelocityZ[i] = VZ;
+            FilteredX[i] += Alpha * (X - FilteredX[i]);
+            FilteredY[i] += Alpha * (Y - FilteredY[i]);
+            FilteredZ[i] += Alpha * (Z - FilteredZ[i]);
+        }
+    }
+
+    static float SmoothingFactor(float CutoffHz, float DeltaSeconds)
+    {
+        const float W = 2.f * HAND_FILTER_PI * CutoffHz * DeltaSeconds;
+        return W / (W + 1.f);
+    }
+
+    static constexpr float HAND_FILTER_PI = 3.14159265f;
+
+    float FilteredX[HAND_JOINT_BUFFER_CAPACITY];
+    float FilteredY[HAND_JOINT_BUFFER_CAPACITY];
+    float FilteredZ[HAND_JOINT_BUFFER_CAPACITY];
+    float VelocityX[HAND_JOINT_BUFFER_CAPACITY]; // millimeters per second
+    float VelocityY[HAND_JOINT_BUFFER_CAPACITY];
+    float VelocityZ[HAND_JOINT_BUFFER_CAPACITY];
+    bool HandInitialized[HAND_COUNT];
+    int64_t LastTimestamp[HAND_COUNT];
+};
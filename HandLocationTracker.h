@@ -0,0 +1,186 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cstring>
+#include "HandFrameRecord.h"
+#include "HandJointBuffer.h"
+#include "HandJointFilter.h"
+#include "HandSpaceTransform.h"
+
+#pragma once
+
+/**
+ * The engine-independent part of LeapInputReader::UpdateHandLocationsFromFrame(): builds the frame transform from one settings and pose snapshot, loads every
+ * joint of both hands, optionally filters them and transforms them to world and Character space in one pass, then picks out the palm and middle fingertip.
+ * A hand that is not tracked keeps its last world location, re-transformed every frame so its Character space location still follows the Character.
+ * LeapInputReader owns one and the tools replay captures through the same class, so goldens and benchmarks run the code the game runs.
+ */
+class HandLocationTracker
+{
+public:
+    HandLocationTracker()
+    {
+        Reset();
+    }
+
+    /*
+     Back to the state before the first frame: no hand tracked yet, all locations at the origin, filter restarted
+     */
+    void Reset()
+    {
+        Filter.Reset();
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            PalmLocation_WorldSpace[HandIndex] = JoystickVector();
+            FingerLocation_WorldSpace[HandIndex] = JoystickVector();
+            PalmLocation_CharacterSpace[HandIndex] = JoystickVector();
+            FingerLocation_CharacterSpace[HandIndex] = JoystickVector();
+        }
+        memset(HandPoses, 0, sizeof(HandPoses));
+        ValidInput = false;
+        FilterWasEnabled = false;
+    }
+
+    /*
+     Advances by one frame.  Returns true if at least one hand was tracked in it.
+     */
+    bool Update(const HandSpaceSettings& Settings, const HandSpacePose& Pose, const HandFilterSettings& FilterSettings, const HandFrameRecord& Frame)
+    {
+        FrameTransform = HandSpaceFrameTransform::Build(Settings, Pose);
+        Joints.Load(Frame);
+        if (FilterSettings.Enabled) {
+            if (!FilterWasEnabled) {
+                Filter.Reset(); // turned back on, start from this frame instead of the hands it saw before it was turned off
+            }
+            Filter.Apply(Joints, Frame.Timestamp, FilterSettings);
+        }
+        FilterWasEnabled = FilterSettings.Enabled;
+        HandJointTransform::Transform(FrameTransform, Joints);
+
+        const int FingerJoint = HandJointIndex(FINGER_MIDDLE, FINGER_JOINT_TIP);
+        ValidInput = false;
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            if (Frame.Hands[HandIndex].Flags & HAND_RECORD_VALID) {
+                HandPoses[HandIndex] = Frame.Hands[HandIndex];
+                ValidInput = true; // for now valid if hands detected.  in future, will check if movement is "natural"
+                PalmLocation_WorldSpace[HandIndex] = Joints.GetWorldLocation(HandIndex, HAND_JOINT_PALM);
+                FingerLocation_WorldSpace[HandIndex] = Joints.GetWorldLocation(HandIndex, FingerJoint); // only middle finger used for leap input
+                PalmLocation_CharacterSpace[HandIndex] = Joints.GetCharacterLocation(HandIndex, HAND_JOINT_PALM);
+                FingerLocation_CharacterSpace[HandIndex] = Joints.GetCharacterLocation(HandIndex, FingerJoint);
+            }
+            else {
+                HandPoses[HandIndex].Flags &= ~HAND_RECORD_VALID;
+                PalmLocation_CharacterSpace[HandIndex] = FrameTransform.TransformWorldToCharacter(PalmLocation_WorldSpace[HandIndex]);
+                FingerLocation_CharacterSpace[HandIndex] = FrameTransform.TransformWorldToCharacter(FingerLocation_WorldSpace[HandIndex]);
+            }
+        }
+        return ValidInput;
+    }
+
+    bool IsValidInput() const
+    {
+        return ValidInput;
+    }
+
+    JoystickVector GetPalmLocation_WorldSpace(int Hand) const
+    {
+        return PalmLocation_WorldSpace[Hand];
+    }
+
+    JoystickVector GetFingerLocation_WorldSpace(int Hand) const
+    {
+        return FingerLocation_WorldSpace[Hand];
+    }
+
+    JoystickVector GetPalmLocation_CharacterSpace(int Hand) const
+    {
+        return PalmLocation_CharacterSpace[Hand];
+    }
+
+    JoystickVector GetFingerLocation_CharacterSpace(int Hand) const
+    {
+        return FingerLocation_CharacterSpace[Hand];
+    }
+
+    /*
+     Palm and middle fingertip of Hand in Character space, as VirtualJoystick3D::CalculateMovementFromHandLocation() gets them
+     */
+    JoystickSample GetSample(int Hand) const
+    {
+        JoystickSample Sample;
+        Sample.PalmLocation = PalmLocation_CharacterSpace[Hand];
+        Sample.FingerLocation = FingerLocation_CharacterSpace[Hand];
+        return Sample;
+    }
+
+    /*
+     Character space palm and middle fingertip of both hands, indexed by HandSide
+     */
+    const JoystickVector* GetPalmLocations_CharacterSpace() const
+    {
+        return PalmLocation_CharacterSpace;
+    }
+
+    const JoystickVector* GetFingerLocations_CharacterSpace() const
+    {
+        return FingerLocation_CharacterSpace;
+    }
+
+    /*
+     All joints of both hands from the last frame.  Joints of a hand that is not tracked keep the Leap position of the last frame it was tracked in
+     (filtered, when the filter is on), transformed with the last frame's pose.
+     */
+    const HandJointBuffer& GetJoints() const
+    {
+        return Joints;
+    }
+
+    /*
+     Full pose of the hand from the last frame it was tracked in, Flags has HAND_RECORD_VALID only if it was tracked in the last frame
+     */
+    const HandRecord& GetHandPose(int Hand) const
+    {
+        return HandPoses[Hand];
+    }
+
+    const HandSpaceFrameTransform& GetFrameTransform() const
+    {
+        return FrameTransform;
+    }
+
+protected:
+    HandSpaceFrameTransform FrameTransform;
+    HandJointBuffer Joints;
+    HandJointFilter Filter;
+    bool FilterWasEnabled;
+    HandRecord HandPoses[HAND_COUNT];
+    bool ValidInput;
+    JoystickVector PalmLocation_WorldSpace[HAND_COUNT];
+    JoystickVector FingerLocation_WorldSpace[HAND_COUNT];
+    JoystickVector PalmLocation_CharacterSpace[HAND_COUNT];
+    JoystickVector FingerLocation_CharacterSpace[HAND_COUNT];
+};
@@ -0,0 +1,888 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "HandPoseQuantization.h"
+
+#pragma once
+
+/**
+ * Compressed, streaming log of hand frames for long production sessions (QA, motion sickness analysis).
+ *
+ * Frames are quantized with HandPoseQuantization and split into HAND_MOTION_LOG_FIELD_COUNT integer fields (quaternions are split into their 10 bit parts).
+ * They are grouped into chunks of up to HAND_MOTION_LOG_CHUNK_FRAMES frames.  Each chunk is self-contained: the first frame is stored as zigzag varints,
+ * every following frame as the zigzag delta to the previous frame, Rice coded with a parameter chosen per field and chunk (a still hand costs about one bit per field).
+ *
+ * File layout: HandMotionLogFileHeader, then chunks (HandMotionLogChunkHeader + payload), then on Close() an index of HandMotionLogIndexEntry
+ * and a HandMotionLogTrailer.  The index lets the reader jump to the chunk holding any timestamp; if the file was not closed cleanly the reader rebuilds it by
+ * walking the chunk headers.
+ */
+
+static const int HAND_MOTION_LOG_HAND_FIELD_COUNT = 4 + 3 + (HAND_JOINT_COUNT - 1) * 3 + (1 + HAND_BONE_COUNT) * 4;
+static const int HAND_MOTION_LOG_FIELD_COUNT = 2 + HAND_COUNT * HAND_MOTION_LOG_HAND_FIELD_COUNT;
+static const uint32_t HAND_MOTION_LOG_CHUNK_FRAMES = 256;
+static const char HAND_MOTION_LOG_MAGIC[4] = { 'L', 'J', 'H', 'L' };
+static const char HAND_MOTION_LOG_CHUNK_MAGIC[4] = { 'C', 'H', 'N', 'K' };
+static const char HAND_MOTION_LOG_INDEX_MAGIC[4] = { 'L', 'J', 'H', 'I' };
+static const uint32_t HAND_MOTION_LOG_VERSION = 1;
+
+struct HandMotionLogFileHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint32_t FieldCount;
+    uint32_t Reserved;
+};
+
+struct HandMotionLogChunkHeader
+{
+    char Magic[4];
+    uint32_t FrameCount;
+    uint32_t PayloadSize; // bytes following this header
+    uint32_t Reserved;
+    int64_t FirstTimestamp;
+    int64_t LastTimestamp;
+};
+
+struct HandMotionLogIndexEntry
+{
+    int64_t FirstTimestamp;
+    int64_t LastTimestamp;
+    uint64_t Offset; // of the chunk header from the start of the file
+    uint32_t FrameCount;
+    uint32_t Reserved;
+};
+
+struct HandMotionLogTrailer
+{
+    uint64_t IndexOffset;
+    uint64_t ChunkCount;
+    char Magic[4];
+    uint32_t Reserved;
+};
+
+/**
+ * Chunk encoder / decoder shared by the writer and the reader
+ */
+class HandMotionLogCodec
+{
+public:
+
+    /*
+     Upper bound of an encoded chunk payload, every field of every frame escaped
+     */
+    static size_t GetMaxPayloadSize(uint32_t FrameCount)
+    {
+        return HAND_MOTION_LOG_FIELD_COUNT + (size_t)FrameCount * HAND_MOTION_LOG_FIELD_COUNT * 11 + 8;
+    }
+
+    static void ToFields(const QuantizedHandFrameRecord& Frame, int64_t* OutFields)
+    {
+        int Field = 0;
+        OutFields[Field++] = Frame.Timestamp;
+        OutFields[Field++] = Frame.FrameId;
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            const QuantizedHandRecord& Hand = Frame.Hands[HandIndex];
+            OutFields[Field++] = Hand.Flags;
+            OutFields[Field++] = Hand.Confidence;
+            OutFields[Field++] = Hand.GrabStrength;
+            OutFields[Field++] = Hand.PinchStrength;
+            for (int Axis = 0; Axis < 3; Axis++) {
+                OutFields[Field++] = Hand.PalmPosition[Axis];
+            }
+            for (int Joint = 0; Joint < HAND_JOINT_COUNT - 1; Joint++) {
+                for (int Axis = 0; Axis < 3; Axis++) {
+                    OutFields[Field++] = Hand.Joints[Joint][Axis];
+                }
+            }
+            SplitQuaternion(Hand.PalmOrientation, OutFields + Field);
+            Field += 4;
+            for (int Bone = 0; Bone < HAND_BONE_COUNT; Bone++) {
+                SplitQuaternion(Hand.BoneOrientations[Bone], OutFields + Field);
+                Field += 4;
+            }
+        }
+    }
+
+    static void FromFields(const int64_t* Fields, QuantizedHandFrameRecord& OutFrame)
+    {
+        int Field = 0;
+        OutFrame.Timestamp = Fields[Field++];
+        OutFrame.FrameId = Fields[Field++];
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            QuantizedHandRecord& Hand = OutFrame.Hands[HandIndex];
+            Hand.Flags = (uint8_t)Fields[Field++];
+            Hand.Confidence = (uint8_t)Fields[Field++];
+            Hand.GrabStrength = (uint8_t)Fields[Field++];
+            Hand.PinchStrength = (uint8_t)Fields[Field++];
+            for (int Axis = 0; Axis < 3; Axis++) {
+                Hand.PalmPosition[Axis] = (int16_t)Fields[Field++];
+            }
+            for (int Joint = 0; Joint < HAND_JOINT_COUNT - 1; Joint++) {
+                for (int Axis = 0; Axis < 3; Axis++) {
+                    Hand.Joints[Joint][Axis] = (int16_t)Fields[Field++];
+                }
+            }
+            Hand.PalmOrientation = JoinQuaternion(Fields + Field);
+            Field += 4;
+            for (int Bone = 0; Bone < HAND_BONE_COUNT; Bone++) {
+                Hand.BoneOrientations[Bone] = JoinQuaternion(Fields + Field);
+                Field += 4;
+            }
+            Hand.Reserved = 0;
+        }
+    }
+
+    /*
+     Appends the payload of one chunk to Out.  Out should have GetMaxPayloadSize() capacity reserved, then this never allocates.
+     */
+    static void EncodeChunk(const QuantizedHandFrameRecord* Frames, uint32_t FrameCount, std::vector<uint8_t>& Out)
+    {
+        int64_t Previous[HAND_MOTION_LOG_FIELD_COUNT];
+        int64_t Current[HAND_MOTION_LOG_FIELD_COUNT];
+        // Rice parameter per field from the mean zigzag delta over the chunk
+        uint64_t Sums[HAND_MOTION_LOG_FIELD_COUNT];
+        memset(Sums, 0, sizeof(Sums));
+        ToFields(Frames[0], Previous);
+        for (uint32_t FrameIndex = 1; FrameIndex < FrameCount; FrameIndex++) {
+            ToFields(Frames[FrameIndex], Current);
+            for (int Field = 0; Field < HAND_MOTION_LOG_FIELD_COUNT; Field++) {
+                uint64_t Value = ZigZag(Current[Field] - Previous[Field]);
+                Sums[Field] = Sums[Field] + Value < Sums[Field] ? UINT64_MAX : Sums[Field] + Value; // saturate
+                Previous[Field] = Current[Field];
+            }
+        }
+        uint8_t Parameters[HAND_MOTION_LOG_FIELD_COUNT];
+        for (int Field = 0; Field < HAND_MOTION_LOG_FIELD_COUNT; Field++) {
+            uint64_t Mean = FrameCount > 1 ? Sums[Field] / (FrameCount - 1) : 0;
+            uint8_t Parameter = 0;
+            while (Parameter < MAX_RICE_PARAMETER && (Mean >> (Parameter + 1)) != 0) {
+                Parameter++;
+            }
+            Parameters[Field] = Parameter;
+            Out.push_back(Parameter);
+        }
+
+        // key frame
+        ToFields(Frames[0], Previous);
+        for (int Field = 0; Field < HAND_MOTION_LOG_FIELD_COUNT; Field++) {
+            WriteVarint(ZigZag(Previous[Field]), Out);
+        }
+
+        // deltas
+        BitWriter Writer(Out);
+        for (uint32_t FrameIndex = 1; FrameIndex < FrameCount; FrameIndex++) {
+            ToFields(Frames[FrameIndex], Current);
+            for (int Field = 0; Field < HAND_MOTION_LOG_FIELD_COUNT; Field++) {
+                WriteRice(Writer, ZigZag(Current[Field] - Previous[Field]), Parameters[Field]);
+                Previous[Field] = Current[Field];
+            }
+        }
+        Writer.Finish();
+    }
+
+    /*
+     Decodes a payload written by EncodeChunk() into FrameCount frames, false if the payload is truncated or has a Rice parameter EncodeChunk() never writes
+     */
+    static bool DecodeChunk(const uint8_t* Payload, size_t PayloadSize, uint32_t FrameCount, QuantizedHandFrameRecord* OutFrames)
+    {
+        if (FrameCount == 0 || PayloadSize < HAND_MOTION_LOG_FIELD_COUNT) {
+            return false;
+        }
+        const uint8_t* Parameters = Payload;
+        for (int Field = 0; Field < HAND_MOTION_LOG_FIELD_COUNT; Field++) {
+            if (Parameters[Field] > MAX_RICE_PARAMETER) {
+                return false;
+            }
+        }
+        size_t Position = HAND_MOTION_LOG_FIELD_COUNT;
+        int64_t Fields[HAND_MOTION_LOG_FIELD_COUNT];
+        for (int Field = 0; Field < HAND_MOTION_LOG_FIELD_COUNT; Field++) {
+            uint64_t Value;
+            if (!ReadVarint(Payload, PayloadSize, Position, Value)) {
+                return false;
+            }
+            Fields[Field] = UnZigZag(Value);
+        }
+        FromFields(Fields, OutFrames[0]);
+        BitReader Reader(Payload + Position, PayloadSize - Position);
+        for (uint32_t FrameIndex = 1; FrameIndex < FrameCount; FrameIndex++) {
+            for (int Field = 0; Field < HAND_MOTION_LOG_FIELD_COUNT; Field++) {
+                Fields[Field] += UnZigZag(ReadRice(Reader, Parameters[Field]));
+            }
+            if (Reader.Overrun) {
+                return false;
+            }
+            FromFields(Fields, OutFrames[FrameIndex]);
+        }
+        return true;
+    }
+
+    /*
+     Varint and zigzag helpers, also used by the replication wire format (JoystickReplication.h)
+     */
+    static void WriteVarint(uint64_t Value, std::vector<uint8_t>& Out)
+    {
+        while (Value >= 0x80) {
+            Out.push_back((uint8_t)(Value | 0x80));
+            Value >>= 7;
+        }
+        Out.push_back((uint8_t)Value);
+    }
+
+    static bool ReadVarint(const uint8_t* Data, size_t Size, size_t& Position, uint64_t& OutValue)
+    {
+        OutValue = 0;
+        for (int Shift = 0; Shift < 64; Shift += 7) {
+            if (Position >= Size) {
+                return false;
+            }
+            uint8_t Byte = Data[Position++];
+            OutValue |= (uint64_t)(Byte & 0x7f) << Shift;
+            if ((Byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static uint64_t ZigZag(int64_t Value)
+    {
+        return ((uint64_t)Value << 1) ^ (uint64_t)(Value >> 63);
+    }
+
+    static int64_t UnZigZag(uint64_t Value)
+    {
+        return (int64_t)(Value >> 1) ^ -(int64_t)(Value & 1);
+    }
+
+protected:
+
+    static const int RICE_ESCAPE = 16; // quotients this large are written as RICE_ESCAPE ones and the raw 64 bit value
+    static const int MAX_RICE_PARAMETER = 56; // keeps every shift in ReadRice() below 64 bits
+
+    struct BitWriter
+    {
+        std::vector<uint8_t>& Out;
+        uint64_t Accumulator;
+        int BitCount;
+
+        BitWriter(std::vector<uint8_t>& Out) : Out(Out), Accumulator(0), BitCount(0) {}
+
+        // Count up to 32
+        void Write(uint64_t Bits, int Count)
+        {
+            Accumulator |= (Bits & ((1ull << Count) - 1)) << BitCount;
+            BitCount += Count;
+            while (BitCount >= 8) {
+                Out.push_back((uint8_t)Accumulator);
+                Accumulator >>= 8;
+                BitCount -= 8;
+            }
+        }
+
+        void Finish()
+        {
+            if (BitCount > 0) {
+                Out.push_back((uint8_t)Accumulator);
+            }
+            Accumulator = 0;
+            BitCount = 0;
+        }
+    };
+
+    struct BitReader
+    {
+        const uint8_t* Data;
+        size_t Size;
+        size_t Position;
+        uint64_t Accumulator;
+        int BitCount;
+        bool Overrun;
+
+        BitReader(const uint8_t* Data, size_t Size) : Data(Data), Size(Size), Position(0), Accumulator(0), BitCount(0), Overrun(false) {}
+
+        // Count up to 32
+        uint64_t Read(int Count)
+        {
+            while (BitCount < Count) {
+                uint64_t Byte = 0;
+                if (Position < Size) {
+                    Byte = Data[Position++];
+                }
+                else {
+                    Overrun = true;
+                }
+                Accumulator |= Byte << BitCount;
+                BitCount += 8;
+            }
+            uint64_t Bits = Accumulator & ((1ull << Count) - 1);
+            Accumulator >>= Count;
+            BitCount -= Count;
+            return Bits;
+        }
+    };
+
+    static void WriteRice(BitWriter& Writer, uint64_t Value, int Parameter)
+    {
+        uint64_t Quotient = Value >> Parameter;
+        if (Quotient >= RICE_ESCAPE) {
+            Writer.Write((1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+            Writer.Write(Value & 0xffffffffu, 32);
+            Writer.Write(Value >> 32, 32);
+            return;
+        }
+        // unary quotient (ones, then a zero), then the low bits
+        Writer.Write((1u << Quotient) - 1, (int)Quotient + 1);
+        while (Parameter > 32) {
+            Writer.Write(Value, 32);
+            Value >>= 32;
+            Parameter -= 32;
+        }
+        Writer.Write(Value, Parameter);
+    }
+
+    static uint64_t ReadRice(BitReader& Reader, int Parameter)
+    {
+        uint64_t Quotient = 0;
+        while (Quotient < RICE_ESCAPE && Reader.Read(1) != 0) {
+            Quotient++;
+            if (Reader.Overrun) {
+                return 0;
+            }
+        }
+        if (Quotient == RICE_ESCAPE) {
+            uint64_t Low = Reader.Read(32);
+            return Low | (Reader.Read(32) << 32);
+        }
+        uint64_t Remainder = 0;
+        int Shift = 0;
+        while (Parameter > 32) {
+            Remainder |= Reader.Read(32) << Shift;
+            Shift += 32;
+            Parameter -= 32;
+        }
+        Remainder |= Reader.Read(Parameter) << Shift;
+        return (Quotient << (Shift + Parameter)) | Remainder;
+    }
+
+    /*
+     Packed smallest-three quaternion as (dropped component index, three 10 bit components), so each part changes smoothly from frame to frame
+     */
+    static void SplitQuaternion(uint32_t Packed, int64_t* OutFields)
+    {
+        OutFields[0] = Packed >> 30;
+        OutFields[1] = (Packed >> 20) & 1023u;
+        OutFields[2] = (Packed >> 10) & 1023u;
+        OutFields[3] = Packed & 1023u;
+    }
+
+    static uint32_t JoinQuaternion(const int64_t* Fields)
+    {
+        return ((uint32_t)Fields[0] & 3u) << 30 | ((uint32_t)Fields[1] & 1023u) << 20 | ((uint32_t)Fields[2] & 1023u) << 10 | ((uint32_t)Fields[3] & 1023u);
+    }
+};
+
+/*
+ Snapshot of the writer counters
+ */
+struct HandMotionLogStats
+{
+    uint64_t FramesLogged;  // accepted by Log()
+    uint64_t FramesDropped; // rejected by Log() because the queue was full
+    uint64_t FramesWritten; // encoded and written to the file
+    uint64_t ChunksWritten;
+    uint64_t BytesWritten;
+};
+
+/*
+ 64 bit file offsets on every platform
+ */
+inline bool HandMotionLogSeek(FILE* File, uint64_t Offset, int Origin = SEEK_SET)
+{
+#if defined(_WIN32)
+    return _fseeki64(File, (__int64)Offset, Origin) == 0;
+#else
+    return fseeko(File, (off_t)Offset, Origin) == 0;
+#endif
+}
+
+inline uint64_t HandMotionLogTell(FILE* File)
+{
+#if defined(_WIN32)
+    return (uint64_t)_ftelli64(File);
+#else
+    return (uint64_t)ftello(File);
+#endif
+}
+
+/**
+ * Streams hand frames into a compressed log on a background thread.
+ * Log() is called on the game thread: it quantizes the frame straight into a slot of a fixed-size lock-free queue and returns, it never waits on the writer.
+ * If the writer falls behind by more than the queue capacity, frames are dropped and counted instead.  All buffers are allocated by Open(), so memory stays bounded
+ * (queue + one chunk + one encoded chunk, plus 32 bytes of index per chunk).  Each finished chunk is flushed to disk, so a crash loses at most the chunk in progress.
+ */
+class HandMotionLogWriter
+{
+public:
+    /*
+     QueueCapacity is rounded up to a power of two.  The default holds about 8 seconds at 120 Hz.
+     PollIntervalMicros is how long the writer thread sleeps when the queue is empty.
+     */
+    HandMotionLogWriter(uint32_t QueueCapacity = 1024, int PollIntervalMicros = 5000)
+    {
+        this->QueueCapacity = 1;
+        while (this->QueueCapacity < QueueCapacity) {
+            this->QueueCapacity <<= 1;
+        }
+        this->PollIntervalMicros = PollIntervalMicros;
+        File = nullptr;
+        ChunkFrameCount = 0;
+        Running.store(false);
+        QueueHead.store(0);
+        QueueTail.store(0);
+        ResetStats();
+    }
+
+    ~HandMotionLogWriter()
+    {
+        Close();
+    }
+
+    bool Open(const char* Path)
+    {
+        Close();
+        File = fopen(Path, "wb");
+        if (File == nullptr) {
+            return false;
+        }
+        HandMotionLogFileHeader Header;
+        memset(&Header, 0, sizeof(Header));
+        memcpy(Header.Magic, HAND_MOTION_LOG_MAGIC, sizeof(Header.Magic));
+        Header.Version = HAND_MOTION_LOG_VERSION;
+        Header.FieldCount = HAND_MOTION_LOG_FIELD_COUNT;
+        if (fwrite(&Header, sizeof(Header), 1, File) != 1) {
+            fclose(File);
+            File = nullptr;
+            return false;
+        }
+        Queue.resize(QueueCapacity);
+        Chunk.resize(HAND_MOTION_LOG_CHUNK_FRAMES);
+        Payload.reserve(HandMotionLogCodec::GetMaxPayloadSize(HAND_MOTION_LOG_CHUNK_FRAMES));
+        Index.clear();
+        ChunkFrameCount = 0;
+        QueueHead.store(0);
+        QueueTail.store(0);
+        ResetStats();
+        Running.store(true);
+        WriterThread = std::thread(&HandMotionLogWriter::Run, this);
+        return true;
+    }
+
+    bool IsOpen() const
+    {
+        return File != nullptr;
+    }
+
+    /*
+     Game thread side.  False if the frame was dropped (log not open or queue full).  Only one thread may call Log().
+     */
+    bool Log(const HandFrameRecord& Frame)
+    {
+        if (!Running.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        uint64_t Head = QueueHead.load(std::memory_order_relaxed);
+        if (Head - QueueTail.load(std::memory_order_acquire) >= QueueCapacity) {
+            FramesDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        HandPoseQuantization::QuantizeFrame(Frame, Queue[Head & (QueueCapacity - 1)]);
+        QueueHead.store(Head + 1, std::memory_order_release);
+        FramesLogged.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /*
+     Writes everything still queued, the index and the trailer, and closes the file.  Blocks until the writer thread is done, so call it at shutdown, not per frame.
+     */
+    void Close()
+    {
+        if (File == nullptr) {
+            return;
+        }
+        Running.store(false);
+        WriterThread.join();
+        HandMotionLogTrailer Trailer;
+        memset(&Trailer, 0, sizeof(Trailer));
+        Trailer.IndexOffset = HandMotionLogTell(File);
+        Trailer.ChunkCount = Index.size();
+        memcpy(Trailer.Magic, HAND_MOTION_LOG_INDEX_MAGIC, sizeof(Trailer.Magic));
+        if (!Index.empty()) {
+            fwrite(&Index[0], sizeof(HandMotionLogIndexEntry), Index.size(), File);
+        }
+        fwrite(&Trailer, sizeof(Trailer), 1, File);
+        fclose(File);
+        File = nullptr;
+    }
+
+    HandMotionLogStats GetStats() const
+    {
+        HandMotionLogStats Stats;
+        Stats.FramesLogged = FramesLogged.load(std::memory_order_relaxed);
+        Stats.FramesDropped = FramesDropped.load(std::memory_order_relaxed);
+        Stats.FramesWritten = FramesWritten.load(std::memory_order_relaxed);
+        Stats.ChunksWritten = ChunksWritten.load(std::memory_order_relaxed);
+        Stats.BytesWritten = BytesWritten.load(std::memory_order_relaxed);
+        return Stats;
+    }
+
+protected:
+
+    void ResetStats()
+    {
+        FramesLogged.store(0);
+        FramesDropped.store(0);
+        FramesWritten.store(0);
+        ChunksWritten.store(0);
+        BytesWritten.store(sizeof(HandMotionLogFileHeader));
+    }
+
+    void Run()
+    {
+        for (;;) {
+            // read Running before draining, so frames logged before Close() cleared it are always written
+            bool StillRunning = Running.load(std::memory_order_acquire);
+            uint64_t Tail = QueueTail.load(std::memory_order_relaxed);
+            uint64_t Head = QueueHead.load(std::memory_order_acquire);
+            while (Tail != Head) {
+                Chunk[ChunkFrameCount++] = Queue[Tail & (QueueCapacity - 1)];
+                Tail++;
+                QueueTail.store(Tail, std::memory_order_release);
+                if (ChunkFrameCount == HAND_MOTION_LOG_CHUNK_FRAMES) {
+                    WriteChunk();
+                }
+            }
+            if (!StillRunning) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(PollIntervalMicros));
+        }
+        if (ChunkFrameCount > 0) {
+            WriteChunk();
+        }
+    }
+
+    void WriteChunk()
+    {
+        Payload.clear();
+        HandMotionLogCodec::EncodeChunk(&Chunk[0], ChunkFrameCount, Payload);
+        HandMotionLogChunkHeader Header;
+        memset(&Header, 0, sizeof(Header));
+        memcpy(Header.Magic, HAND_MOTION_LOG_CHUNK_MAGIC, sizeof(Header.Magic));
+        Header.FrameCount = ChunkFrameCount;
+        Header.PayloadSize = (uint32_t)Payload.size();
+        Header.FirstTimestamp = Chunk[0].Timestamp;
+        Header.LastTimestamp = Chunk[ChunkFrameCount - 1].Timestamp;
+        HandMotionLogIndexEntry Entry;
+        memset(&Entry, 0, sizeof(Entry));
+        Entry.FirstTimestamp = Header.FirstTimestamp;
+        Entry.LastTimestamp = Header.LastTimestamp;
+        Entry.Offset = HandMotionLogTell(File);
+        Entry.FrameCount = ChunkFrameCount;
+        if (fwrite(&Header, sizeof(Header), 1, File) == 1 && fwrite(&Payload[0], 1, Payload.size(), File) == Payload.size()) {
+            fflush(File);
+            Index.push_back(Entry);
+            FramesWritten.fetch_add(ChunkFrameCount, std::memory_order_relaxed);
+            ChunksWritten.fetch_add(1, std::memory_order_relaxed);
+            BytesWritten.fetch_add(sizeof(Header) + Payload.size(), std::memory_order_relaxed);
+        }
+        ChunkFrameCount = 0;
+    }
+
+    FILE* File;
+    uint32_t QueueCapacity;
+    int PollIntervalMicros;
+    std::atomic<bool> Running;
+    std::thread WriterThread;
+
+    // single producer / single consumer ring, QueueHead is only written by Log() and QueueTail only by the writer thread
+    std::vector<QuantizedHandFrameRecord> Queue;
+    std::atomic<uint64_t> QueueHead;
+    std::atomic<uint64_t> QueueTail;
+
+    // writer thread only
+    std::vector<QuantizedHandFrameRecord> Chunk;
+    uint32_t ChunkFrameCount;
+    std::vector<uint8_t> Payload;
+    std::vector<HandMotionLogIndexEntry> Index;
+
+    std::atomic<uint64_t> FramesLogged;
+    std::atomic<uint64_t> FramesDropped;
+    std::atomic<uint64_t> FramesWritten;
+    std::atomic<uint64_t> ChunksWritten;
+    std::atomic<uint64_t> BytesWritten;
+};
+
+/**
+ * Reads a log written by HandMotionLogWriter.  Only the chunk being read is decoded, Seek() uses the index to go straight to the chunk holding a timestamp.
+ * Frames come back dequantized (see HandPoseQuantization for the precision).
+ */
+class HandMotionLogReader
+{
+public:
+    HandMotionLogReader()
+    {
+        File = nullptr;
+        FrameCount = 0;
+        CurrentChunk = 0;
+        DecodedChunk = UINT64_MAX;
+        ChunkFrameCount = 0;
+        ChunkFrameIndex = 0;
+    }
+
+    ~HandMotionLogReader()
+    {
+        Close();
+    }
+
+    bool Open(const char* Path)
+    {
+        Close();
+        File = fopen(Path, "rb");
+        if (File == nullptr) {
+            return false;
+        }
+        HandMotionLogFileHeader Header;
+        if (fread(&Header, sizeof(Header), 1, File) != 1 || memcmp(Header.Magic, HAND_MOTION_LOG_MAGIC, sizeof(Header.Magic)) != 0
+            || Header.Version != HAND_MOTION_LOG_VERSION || Header.FieldCount != HAND_MOTION_LOG_FIELD_COUNT) {
+            Close();
+            return false;
+        }
+        if (!ReadIndex()) {
+            ScanChunks();
+        }
+        FrameCount = 0;
+        for (size_t i = 0; i < Index.size(); i++) {
+            FrameCount += Index[i].FrameCount;
+        }
+        Chunk.resize(HAND_MOTION_LOG_CHUNK_FRAMES);
+        Rewind();
+        return true;
+    }
+
+    void Close()
+    {
+        if (File != nullptr) {
+            fclose(File);
+            File = nullptr;
+        }
+        Index.clear();
+        FrameCount = 0;
+        DecodedChunk = UINT64_MAX;
+    }
+
+    bool IsOpen() const
+    {
+        return File != nullptr;
+    }
+
+    uint64_t GetFrameCount() const
+    {
+        return FrameCount;
+    }
+
+    uint64_t GetChunkCount() const
+    {
+        return Index.size();
+    }
+
+    int64_t GetFirstTimestamp() const
+    {
+        return Index.empty() ? 0 : Index.front().FirstTimestamp;
+    }
+
+    int64_t GetLastTimestamp() const
+    {
+        return Index.empty() ? 0 : Index.back().LastTimestamp;
+    }
+
+    void Rewind()
+    {
+        CurrentChunk = 0;
+        ChunkFrameIndex = 0;
+    }
+
+    /*
+     Positions the reader on the first frame with a timestamp at or after Timestamp, decoding only the chunk that holds it.  False if every frame is earlier.
+     */
+    bool Seek(int64_t Timestamp)
+    {
+        // binary search for the first chunk that ends at or after Timestamp
+        size_t Low = 0;
+        size_t High = Index.size();
+        while (Low < High) {
+            size_t Middle = (Low + High) / 2;
+            if (Index[Middle].LastTimestamp < Timestamp) {
+                Low = Middle + 1;
+            }
+            else {
+                High = Middle;
+            }
+        }
+        if (Low == Index.size() || !DecodeChunk(Low)) {
+            CurrentChunk = Index.size();
+            return false;
+        }
+        CurrentChunk = Low;
+        ChunkFrameIndex = 0;
+        while (ChunkFrameIndex < ChunkFrameCount && Chunk[ChunkFrameIndex].Timestamp < Timestamp) {
+            ChunkFrameIndex++;
+        }
+        return true;
+    }
+
+    /*
+     Next frame in file order, false at the end of the log or if a chunk is damaged
+     */
+    bool ReadQuantizedFrame(QuantizedHandFrameRecord& OutFrame)
+    {
+        while (CurrentChunk < Index.size()) {
+            if (!DecodeChunk(CurrentChunk)) {
+                return false;
+            }
+            if (ChunkFrameIndex < ChunkFrameCount) {
+                OutFrame = Chunk[ChunkFrameIndex++];
+                return true;
+            }
+            CurrentChunk++;
+            ChunkFrameIndex = 0;
+        }
+        return false;
+    }
+
+    bool ReadFrame(HandFrameRecord& OutFrame)
+    {
+        QuantizedHandFrameRecord Frame;
+        if (!ReadQuantizedFrame(Frame)) {
+            return false;
+        }
+        HandPoseQuantization::DequantizeFrame(Frame, OutFrame);
+        return true;
+    }
+
+protected:
+
+    bool ReadIndex()
+    {
+        HandMotionLogTrailer Trailer;
+        if (!HandMotionLogSeek(File, 0, SEEK_END)) {
+            return false;
+        }
+        uint64_t FileSize = HandMotionLogTell(File);
+        if (FileSize < sizeof(HandMotionLogFileHeader) + sizeof(Trailer) || !HandMotionLogSeek(File, FileSize - sizeof(Trailer))
+            || fread(&Trailer, sizeof(Trailer), 1, File) != 1 || memcmp(Trailer.Magic, HAND_MOTION_LOG_INDEX_MAGIC, sizeof(Trailer.Magic)) != 0) {
+            return false;
+        }
+        // a corrupt trailer must not wrap the size check below or resize the index past the file
+        uint64_t IndexEnd = FileSize - sizeof(Trailer);
+        if (Trailer.ChunkCount > IndexEnd / sizeof(HandMotionLogIndexEntry)
+            || Trailer.IndexOffset != IndexEnd - Trailer.ChunkCount * sizeof(HandMotionLogIndexEntry)) {
+            return false;
+        }
+        Index.resize((size_t)Trailer.ChunkCount);
+        if (!HandMotionLogSeek(File, Trailer.IndexOffset) || (!Index.empty() && fread(&Index[0], sizeof(HandMotionLogIndexEntry), Index.size(), File) != Index.size())) {
+            Index.clear();
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     No trailer (e.g. the game crashed): walk the chunk headers from the start and keep every complete chunk
+     */
+    void ScanChunks()
+    {
+        Index.clear();
+        uint64_t Offset = sizeof(HandMotionLogFileHeader);
+        HandMotionLogSeek(File, 0, SEEK_END);
+        uint64_t FileSize = HandMotionLogTell(File);
+        HandMotionLogChunkHeader Header;
+        while (Offset + sizeof(Header) <= FileSize && HandMotionLogSeek(File, Offset) && fread(&Header, sizeof(Header), 1, File) == 1
+               && memcmp(Header.Magic, HAND_MOTION_LOG_CHUNK_MAGIC, sizeof(Header.Magic)) == 0 && Header.FrameCount <= HAND_MOTION_LOG_CHUNK_FRAMES
+               && Offset + sizeof(Header) + Header.PayloadSize <= FileSize) {
+            HandMotionLogIndexEntry Entry;
+            memset(&Entry, 0, sizeof(Entry));
+            Entry.FirstTimestamp = Header.FirstTimestamp;
+            Entry.LastTimestamp = Header.LastTimestamp;
+            Entry.Offset = Offset;
+            Entry.FrameCount = Header.FrameCount;
+            Index.push_back(Entry);
+            Offset += sizeof(Header) + Header.PayloadSize;
+        }
+    }
+
+    bool DecodeChunk(uint64_t ChunkIndex)
+    {
+        if (DecodedChunk == ChunkIndex) {
+            return true;
+        }
+        const HandMotionLogIndexEntry& Entry = Index[(size_t)ChunkIndex];
+        HandMotionLogChunkHeader Header;
+        if (!HandMotionLogSeek(File, Entry.Offset) || fread(&Header, sizeof(Header), 1, File) != 1
+            || memcmp(Header.Magic, HAND_MOTION_LOG_CHUNK_MAGIC, sizeof(Header.Magic)) != 0 || Header.FrameCount != Entry.FrameCount || Header.FrameCount > HAND_MOTION_LOG_CHUNK_FRAMES) {
+            return false;
+        }
+        Payload.resize(Header.PayloadSize);
+        if (Header.PayloadSize > 0 && fread(&Payload[0], 1, Payload.size(), File) != Payload.size()) {
+            return false;
+        }
+        if (Payload.empty() || !HandMotionLogCodec::DecodeChunk(&Payload[0], Payload.size(), Header.FrameCount, &Chunk[0])) {
+            return false;
+        }
+        DecodedChunk = ChunkIndex;
+        ChunkFrameCount = Header.FrameCount;
+        return true;
+    }
+
+    FILE* File;
+    std::vector<HandMotionLogIndexEntry> Index;
+    uint64_t FrameCount;
+    uint64_t CurrentChunk;
+    uint64_t DecodedChunk;
+    std::vector<QuantizedHandFrameRecord> Chunk;
+    uint32_t ChunkFrameCount;
+    uint32_t ChunkFrameIndex;
+    std::vector<uint8_t> Payload;
+};
@@ -0,0 +1,235 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cmath>
+#include <cstdint>
+#include "HandFrameRecord.h"
+
+#pragma once
+
+/*
+ Fixed-point scale of quantized positions: 16 steps per millimeter, so an int16 covers +/- 2 m at 1/16 mm, well below the tracking noise
+ */
+static const float HAND_POSE_POSITION_UNITS_PER_MM = 16.f;
+
+/**
+ * Compact form of HandRecord for storage and network replication, 252 bytes instead of 684.
+ * - the palm is absolute and the other 26 joints are relative to the palm, all as int16 at HAND_POSE_POSITION_UNITS_PER_MM
+ * - palm and bone orientations are unit quaternions packed "smallest three" into 32 bits (2 bit index of the dropped largest component, 3 x 10 bits), max error about 0.25 degree.
+ *   The palm normal and direction are stored as the palm orientation (Y = -normal, Z = -direction, the Leap hand basis).
+ * - confidence, grab and pinch strength as 0 to 255
+ * All fields are naturally aligned and the layout has no implicit padding, so records can be memcpy'd to and from a byte stream.
+ */
+struct QuantizedHandRecord
+{
+    uint32_t PalmOrientation;
+    uint32_t BoneOrientations[HAND_BONE_COUNT];
+    uint8_t Flags;
+    uint8_t Confidence;
+    uint8_t GrabStrength;
+    uint8_t PinchStrength;
+    int16_t PalmPosition[3];
+    int16_t Joints[HAND_JOINT_COUNT - 1][3]; // every HandJoint after the palm, i.e. index HandJoint - 1
+    uint16_t Reserved;
+};
+
+struct QuantizedHandFrameRecord
+{
+    int64_t Timestamp;
+    int64_t FrameId;
+    QuantizedHandRecord Hands[HAND_COUNT];
+};
+
+static_assert(sizeof(QuantizedHandRecord) == 252, "QuantizedHandRecord layout changed");
+static_assert(sizeof(QuantizedHandFrameRecord) % 8 == 0, "QuantizedHandFrameRecord size must keep following records 8 byte aligned");
+
+/**
+ * Conversion between HandRecord and QuantizedHandRecord.  Quantize() then Dequantize() is within 1/32 mm per joint coordinate (joints are stored relative to the
+ * already rounded palm, so the errors do not add up), 1/510 for confidence/grab/pinch and about 0.25 degree for orientations.
+ */
+class HandPoseQuantization
+{
+public:
+
+    static void Quantize(const HandRecord& Hand, QuantizedHandRecord& OutHand)
+    {
+        OutHand.Flags = (uint8_t)Hand.Flags;
+        OutHand.Confidence = QuantizeUnit(Hand.Confidence);
+        OutHand.GrabStrength = QuantizeUnit(Hand.GrabStrength);
+        OutHand.PinchStrength = QuantizeUnit(Hand.PinchStrength);
+        const float* Palm = Hand.Joints[HAND_JOINT_PALM];
+        for (int Axis = 0; Axis < 3; Axis++) {
+            OutHand.PalmPosition[Axis] = QuantizePosition(Palm[Axis]);
+        }
+        // relative to the dequantized palm, so the palm rounding error does not add up with the joint's own
+        float QuantizedPalm[3];
+        for (int Axis = 0; Axis < 3; Axis++) {
+            QuantizedPalm[Axis] = DequantizePosition(OutHand.PalmPosition[Axis]);
+        }
+        for (int Joint = HAND_JOINT_PALM + 1; Joint < HAND_JOINT_COUNT; Joint++) {
+            for (int Axis = 0; Axis < 3; Axis++) {
+                OutHand.Joints[Joint - 1][Axis] = QuantizePosition(Hand.Joints[Joint][Axis] - QuantizedPalm[Axis]);
+            }
+        }
+        float YAxis[3] = { -Hand.PalmNormal[0], -Hand.PalmNormal[1], -Hand.PalmNormal[2] };
+        float ZAxis[3] = { -Hand.PalmDirection[0], -Hand.PalmDirection[1], -Hand.PalmDirection[2] };
+        float PalmOrientation[4];
+        HandQuaternionFromAxes(YAxis, ZAxis, PalmOrientation);
+        OutHand.PalmOrientation = PackQuaternion(PalmOrientation);
+        for (int Bone = 0; Bone < HAND_BONE_COUNT; Bone++) {
+            OutHand.BoneOrientations[Bone] = PackQuaternion(Hand.BoneOrientations[Bone]);
+        }
+        OutHand.Reserved = 0;
+    }
+
+    static void Dequantize(const QuantizedHandRecord& Hand, HandRecord& OutHand)
+    {
+        OutHand.Flags = Hand.Flags;
+        OutHand.Confidence = Hand.Confidence / 255.f;
+        OutHand.GrabStrength = Hand.GrabStrength / 255.f;
+        OutHand.PinchStrength = Hand.PinchStrength / 255.f;
+        float* Palm = OutHand.Joints[HAND_JOINT_PALM];
+        for (int Axis = 0; Axis < 3; Axis++) {
+            Palm[Axis] = DequantizePosition(Hand.PalmPosition[Axis]);
+        }
+        for (int Joint = HAND_JOINT_PALM + 1; Joint < HAND_JOINT_COUNT; Joint++) {
+            for (int Axis = 0; Axis < 3; Axis++) {
+                OutHand.Joints[Joint][Axis] = Palm[Axis] + DequantizePosition(Hand.Joints[Joint - 1][Axis]);
+            }
+        }
+        float PalmOrientation[4];
+        UnpackQuaternion(Hand.PalmOrientation, PalmOrientation);
+        HandQuaternionAxis(PalmOrientation, 1, OutHand.PalmNormal);
+        HandQuaternionAxis(PalmOrientation, 2, OutHand.PalmDirection);
+        for (int Axis = 0; Axis < 3; Axis++) {
+            OutHand.PalmNormal[Axis] = -OutHand.PalmNormal[Axis];
+            OutHand.PalmDirection[Axis] = -OutHand.PalmDirection[Axis];
+        }
+        for (int Bone = 0; Bone < HAND_BONE_COUNT; Bone++) {
+            UnpackQuaternion(Hand.BoneOrientations[Bone], OutHand.BoneOrientations[Bone]);
+        }
+    }
+
+    static void QuantizeFrame(const HandFrameRecord& Frame, QuantizedHandFrameRecord& OutFrame)
+    {
+        OutFrame.Timestamp = Frame.Timestamp;
+        OutFrame.FrameId = Frame.FrameId;
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            Quantize(Frame.Hands[HandIndex], OutFrame.Hands[HandIndex]);
+        }
+    }
+
+    static void DequantizeFrame(const QuantizedHandFrameRecord& Frame, HandFrameRecord& OutFrame)
+    {
+        OutFrame.Timestamp = Frame.Timestamp;
+        OutFrame.FrameId = Frame.FrameId;
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            Dequantize(Frame.Hands[HandIndex], OutFrame.Hands[HandIndex]);
+        }
+    }
+
+    /*
+     Smallest three: q and -q are the same rotation, so the largest component is made positive and dropped, and rebuilt from the unit length on unpack.
+     The other three are within +/- 1/sqrt(2) and get 10 bits each.  Non-finite components count as 0, so a broken orientation from the tracker
+     packs to a valid rotation instead of undefined float to int conversions.
+     */
+    static uint32_t PackQuaternion(const float* RawQuaternion)
+    {
+        float Quaternion[4];
+        for (int i = 0; i < 4; i++) {
+            Quaternion[i] = std::isfinite(RawQuaternion[i]) ? RawQuaternion[i] : 0.f;
+        }
+        int Largest = 0;
+        for (int i = 1; i < 4; i++) {
+            if (fabsf(Quaternion[i]) > fabsf(Quaternion[Largest])) {
+                Largest = i;
+            }
+        }
+        float Sign = Quaternion[Largest] < 0.f ? -1.f : 1.f;
+        uint32_t Packed = (uint32_t)Largest << 30;
+        int Shift = 20;
+        for (int i = 0; i < 4; i++) {
+            if (i == Largest) {
+                continue;
+            }
+            float Normalized = Sign * Quaternion[i] * QUATERNION_COMPONENT_SCALE * 0.5f + 0.5f;
+            Normalized = Normalized < 0.f ? 0.f : (Normalized > 1.f ? 1.f : Normalized);
+            Packed |= (uint32_t)(Normalized * 1023.f + 0.5f) << Shift;
+            Shift -= 10;
+        }
+        return Packed;
+    }
+
+    static void UnpackQuaternion(uint32_t Packed, float* OutQuaternion)
+    {
+        int Largest = (int)(Packed >> 30);
+        int Shift = 20;
+        float SumOfSquares = 0.f;
+        for (int i = 0; i < 4; i++) {
+            if (i == Largest) {
+                continue;
+            }
+            float Normalized = (float)((Packed >> Shift) & 1023u) / 1023.f;
+            OutQuaternion[i] = (Normalized - 0.5f) * 2.f / QUATERNION_COMPONENT_SCALE;
+            SumOfSquares += OutQuaternion[i] * OutQuaternion[i];
+            Shift -= 10;
+        }
+        OutQuaternion[Largest] = SumOfSquares < 1.f ? sqrtf(1.f - SumOfSquares) : 0.f;
+    }
+
+    /*
+     Clamped to the int16 range; NaN and infinities are 0, since casting them to an integer is undefined
+     */
+    static int16_t QuantizePosition(float Millimeters)
+    {
+        if (!std::isfinite(Millimeters)) {
+            return 0;
+        }
+        float Scaled = Millimeters * HAND_POSE_POSITION_UNITS_PER_MM;
+        Scaled = Scaled < -32767.f ? -32767.f : (Scaled > 32767.f ? 32767.f : Scaled);
+        return (int16_t)lrintf(Scaled);
+    }
+
+    static float DequantizePosition(int16_t Units)
+    {
+        return Units / HAND_POSE_POSITION_UNITS_PER_MM;
+    }
+
+    static uint8_t QuantizeUnit(float Value)
+    {
+        if (Value != Value) {
+            return 0;
+        }
+        Value = Value < 0.f ? 0.f : (Value > 1.f ? 1.f : Value);
+        return (uint8_t)(Value * 255.f + 0.5f);
+    }
+
+protected:
+
+    static constexpr float QUATERNION_COMPONENT_SCALE = 1.41421356f; // sqrt(2), maps +/- 1/sqrt(2) to +/- 1
+};
@@ -0,0 +1,249 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include "JoystickCore.h"
+
+#pragma once
+
+/**
+ * Engine-independent version of the Leap to Unreal coordinate conversion done by LeapInputReader, so it can be run and measured without a live Unreal world.
+ * Vectors use JoystickVector (Unreal axes: X=forward, Y=right, Z=up).
+ */
+
+/*
+ Snapshot of everything the conversion needs from the HMD and the Character
+ */
+struct HandSpacePose
+{
+    bool HasHMDOrientation; // false if there is no HMD or head tracking is not allowed
+    float HMDOrientation[4]; // quaternion X, Y, Z, W
+    JoystickVector ActorLocation;
+    JoystickVector ActorForward;
+    JoystickVector ActorRight;
+    JoystickVector ActorUp;
+    JoystickVector ActorScale;
+
+    HandSpacePose()
+    {
+        HasHMDOrientation = false;
+        HMDOrientation[0] = 0.f;
+        HMDOrientation[1] = 0.f;
+        HMDOrientation[2] = 0.f;
+        HMDOrientation[3] = 1.f;
+        ActorLocation = MakeVector(0.f, 0.f, 0.f);
+        ActorForward = MakeVector(1.f, 0.f, 0.f);
+        ActorRight = MakeVector(0.f, 1.f, 0.f);
+        ActorUp = MakeVector(0.f, 0.f, 1.f);
+        ActorScale = MakeVector(1.f, 1.f, 1.f);
+    }
+
+    static JoystickVector MakeVector(float X, float Y, float Z)
+    {
+        JoystickVector Vector;
+        Vector.X = X;
+        Vector.Y = Y;
+        Vector.Z = Z;
+        return Vector;
+    }
+};
+
+/*
+ Same meaning and defaults as the LeapInputReader fields with the same names
+ */
+struct HandSpaceSettings
+{
+    float LeapToUnrealScalingFactor;
+    JoystickVector LeapMountOffset; // in Leap coordinates (millimeters)!
+    JoystickVector LeapHandOffset;
+
+    HandSpaceSettings()
+    {
+        LeapToUnrealScalingFactor = 0.1;
+        LeapMountOffset = HandSpacePose::MakeVector(150.f, 0.f, -20.f);
+        LeapHandOffset = HandSpacePose::MakeVector(10.0, 0.0, 45.0);
+    }
+};
+
+/**
+ * Leap to world and world to Character transforms for one frame, built once from a single HandSpacePose snapshot.
+ * Swizzle, mount offset, HMD unrotate, scaling, hand offset and the Character basis are all folded into one 4x4 matrix, so every point of the frame costs one
+ * matrix multiply, and all points of a frame are consistent with each other even if the HMD moves while the frame is processed.
+ */
+struct HandSpaceFrameTransform
+{
+    float LeapToWorld[4][4]; // row major, column vector convention: World = LeapToWorld * (Leap, 1)
+    float WorldToCharacter[4][4];
+
+    /*
+     Raw Leap position (millimeters, Leap axes) to world space
+     */
+    JoystickVector TransformLeapToWorld(const float* LeapPosition) const
+    {
+        return TransformPoint(LeapToWorld, LeapPosition[0], LeapPosition[1], LeapPosition[2]);
+    }
+
+    /*
+     Equivalent of Character->GetTransform().InverseTransformPosition() with the pose of this frame
+     */
+    JoystickVector TransformWorldToCharacter(const JoystickVector& WorldLocation) const
+    {
+        return TransformPoint(WorldToCharacter, WorldLocation.X, WorldLocation.Y, WorldLocation.Z);
+    }
+
+    static JoystickVector TransformPoint(const float Matrix[4][4], float X, float Y, float Z)
+    {
+        return HandSpacePose::MakeVector(
+            Matrix[0][0] * X + Matrix[0][1] * Y + Matrix[0][2] * Z + Matrix[0][3],
+            Matrix[1][0] * X + Matrix[1][1] * Y + Matrix[1][2] * Z + Matrix[1][3],
+            Matrix[2][0] * X + Matrix[2][1] * Y + Matrix[2][2] * Z + Matrix[2][3]);
+    }
+
+    static HandSpaceFrameTransform Build(const HandSpaceSettings& Settings, const HandSpacePose& Pose);
+};
+
+class HandSpaceTransform
+{
+public:
+
+    /*
+     Translates a raw Leap position (millimeters, Leap axes) to a world space location.
+     NOTE: because of the different coordinate systems for Leap forward = Y whereas for a character Forward = X
+     */
+    static JoystickVector LeapToWorld(const HandSpaceSettings& Settings, const HandSpacePose& Pose, const float* LeapPosition)
+    {
+        // Adjust for mount offset and also current HMD orientation
+        // NOTE: reverse X and Y because of different coordinate systems
+        JoystickVector Corrected = HandSpacePose::MakeVector(LeapPosition[1] + Settings.LeapMountOffset.X, LeapPosition[0] + Settings.LeapMountOffset.Y, LeapPosition[2] + Settings.LeapMountOffset.Z);
+        if (Pose.HasHMDOrientation) {
+            Corrected = UnrotateVector(Pose.HMDOrientation, Corrected); // TODO: adjust for leap rotation not being the same as HMD rotation
+        }
+        float ScaledX = Corrected.X * Settings.LeapToUnrealScalingFactor;
+        float ScaledY = Corrected.Y * Settings.LeapToUnrealScalingFactor;
+        float ScaledZ = Corrected.Z * Settings.LeapToUnrealScalingFactor;
+        float Forward = ScaledX + Settings.LeapHandOffset.X;
+        float Up = ScaledZ - Settings.LeapHandOffset.Z;
+        return HandSpacePose::MakeVector(
+            Pose.ActorLocation.X - (Pose.ActorRight.X * ScaledY) + (Pose.ActorForward.X * Forward) - (Pose.ActorUp.X * Up),
+            Pose.ActorLocation.Y - (Pose.ActorRight.Y * ScaledY) + (Pose.ActorForward.Y * Forward) - (Pose.ActorUp.Y * Up),
+            Pose.ActorLocation.Z - (Pose.ActorRight.Z * ScaledY) + (Pose.ActorForward.Z * Forward) - (Pose.ActorUp.Z * Up));
+    }
+
+    /*
+     Equivalent of Character->GetTransform().InverseTransformPosition()
+     */
+    static JoystickVector WorldToCharacter(const HandSpacePose& Pose, const JoystickVector& WorldLocation)
+    {
+        float DeltaX = WorldLocation.X - Pose.ActorLocation.X;
+        float DeltaY = WorldLocation.Y - Pose.ActorLocation.Y;
+        float DeltaZ = WorldLocation.Z - Pose.ActorLocation.Z;
+        return HandSpacePose::MakeVector(
+            (DeltaX * Pose.ActorForward.X + DeltaY * Pose.ActorForward.Y + DeltaZ * Pose.ActorForward.Z) / Pose.ActorScale.X,
+            (DeltaX * Pose.ActorRight.X + DeltaY * Pose.ActorRight.Y + DeltaZ * Pose.ActorRight.Z) / Pose.ActorScale.Y,
+            (DeltaX * Pose.ActorUp.X + DeltaY * Pose.ActorUp.Y + DeltaZ * Pose.ActorUp.Z) / Pose.ActorScale.Z);
+    }
+
+    /*
+     Rotates a vector by the inverse of a unit quaternion (X, Y, Z, W), same as FRotator::UnrotateVector for the equivalent rotator
+     */
+    static JoystickVector UnrotateVector(const float* Quaternion, const JoystickVector& Vector)
+    {
+        float QX = -Quaternion[0];
+        float QY = -Quaternion[1];
+        float QZ = -Quaternion[2];
+        float QW = Quaternion[3];
+        // t = 2 * cross(q, v), v' = v + w * t + cross(q, t)
+        float TX = 2.f * (QY * Vector.Z - QZ * Vector.Y);
+        float TY = 2.f * (QZ * Vector.X - QX * Vector.Z);
+        float TZ = 2.f * (QX * Vector.Y - QY * Vector.X);
+        return HandSpacePose::MakeVector(
+            Vector.X + QW * TX + (QY * TZ - QZ * TY),
+            Vector.Y + QW * TY + (QZ * TX - QX * TZ),
+            Vector.Z + QW * TZ + (QX * TY - QY * TX));
+    }
+};
+
+inline HandSpaceFrameTransform HandSpaceFrameTransform::Build(const HandSpaceSettings& Settings, const HandSpacePose& Pose)
+{
+    // World = ActorLocation + Forward * HandOffset.X + Up * HandOffset.Z + Basis * Scale * Unrotate * (Swizzle * Leap + MountOffset)
+    // where the columns of Basis are (Forward, -Right, -Up).  Everything in front of Leap is linear, so it collapses into one matrix plus translation.
+    const JoystickVector Basis[3] = {
+        Pose.ActorForward,
+        HandSpacePose::MakeVector(-Pose.ActorRight.X, -Pose.ActorRight.Y, -Pose.ActorRight.Z),
+        HandSpacePose::MakeVector(-Pose.ActorUp.X, -Pose.ActorUp.Y, -Pose.ActorUp.Z)
+    };
+    // Unrotate matrix: columns are the unrotated unit axes
+    JoystickVector Unrotate[3] = {
+        HandSpacePose::MakeVector(1.f, 0.f, 0.f),
+        HandSpacePose::MakeVector(0.f, 1.f, 0.f),
+        HandSpacePose::MakeVector(0.f, 0.f, 1.f)
+    };
+    if (Pose.HasHMDOrientation) {
+        for (int Axis = 0; Axis < 3; Axis++) {
+            Unrotate[Axis] = HandSpaceTransform::UnrotateVector(Pose.HMDOrientation, Unrotate[Axis]);
+        }
+    }
+    // Leap X feeds Unreal Y and Leap Y feeds Unreal X (see the NOTE in LeapToWorld), so swap the first two columns of the unrotate
+    const JoystickVector SwizzledUnrotate[3] = { Unrotate[1], Unrotate[0], Unrotate[2] };
+    const float Scale = Settings.LeapToUnrealScalingFactor;
+    // the mount offset is added before the unrotate, so it gets unrotated too
+    const JoystickVector MountOffset = Pose.HasHMDOrientation ? HandSpaceTransform::UnrotateVector(Pose.HMDOrientation, Settings.LeapMountOffset) : Settings.LeapMountOffset;
+
+    HandSpaceFrameTransform Transform;
+    const float ActorLocation[3] = { Pose.ActorLocation.X, Pose.ActorLocation.Y, Pose.ActorLocation.Z };
+    const float Forward[3] = { Pose.ActorForward.X, Pose.ActorForward.Y, Pose.ActorForward.Z };
+    const float Up[3] = { Pose.ActorUp.X, Pose.ActorUp.Y, Pose.ActorUp.Z };
+    for (int Row = 0; Row < 3; Row++) {
+        const float BasisRow[3] = {
+            (&Basis[0].X)[Row],
+            (&Basis[1].X)[Row],
+            (&Basis[2].X)[Row]
+        };
+        for (int Column = 0; Column < 3; Column++) {
+            const JoystickVector& UnrotatedAxis = SwizzledUnrotate[Column];
+            Transform.LeapToWorld[Row][Column] = Scale * (BasisRow[0] * UnrotatedAxis.X + BasisRow[1] * UnrotatedAxis.Y + BasisRow[2] * UnrotatedAxis.Z);
+        }
+        Transform.LeapToWorld[Row][3] = ActorLocation[Row] + Forward[Row] * Settings.LeapHandOffset.X + Up[Row] * Settings.LeapHandOffset.Z
+            + Scale * (BasisRow[0] * MountOffset.X + BasisRow[1] * MountOffset.Y + BasisRow[2] * MountOffset.Z);
+        Transform.LeapToWorld[3][Row] = 0.f;
+    }
+    Transform.LeapToWorld[3][3] = 1.f;
+
+    // World to Character: dot with each basis vector and divide by the actor scale
+    const JoystickVector CharacterAxes[3] = { Pose.ActorForward, Pose.ActorRight, Pose.ActorUp };
+    const float InverseScale[3] = { 1.f / Pose.ActorScale.X, 1.f / Pose.ActorScale.Y, 1.f / Pose.ActorScale.Z };
+    for (int Row = 0; Row < 3; Row++) {
+        const JoystickVector& Axis = CharacterAxes[Row];
+        Transform.WorldToCharacter[Row][0] = Axis.X * InverseScale[Row];
+        Transform.WorldToCharacter[Row][1] = Axis.Y * InverseScale[Row];
+        Transform.WorldToCharacter[Row][2] = Axis.Z * InverseScale[Row];
+        Transform.WorldToCharacter[Row][3] = -(Axis.X * ActorLocation[0] + Axis.Y * ActorLocation[1] + Axis.Z * ActorLocation[2]) * InverseScale[Row];
+        Transform.WorldToCharacter[3][Row] = 0.f;
+    }
+    Transform.WorldToCharacter[3][3] = 1.f;
+    return Transform;
+}
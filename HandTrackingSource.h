@@ -0,0 +1,56 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include "HandFrameRecord.h"
+
+#pragma once
+
+/**
+ * Interface for anything that can provide hand frames to LeapInputReader: the Leap SDK, a recorded capture file, a synthetic generator, etc.
+ * Frames are always in the HandFrameRecord layout (raw Leap coordinates), so every source goes through exactly the same path in the reader.
+ */
+class IHandTrackingSource
+{
+public:
+    virtual ~IHandTrackingSource() {}
+
+    /*
+     Returns the newest frame, or nullptr if there is no frame available (e.g. a replay that reached the end).
+     The returned pointer stays valid until the next call to ReadFrame() on this source, so sources can hand out their own buffers (or a memory mapping) without copying.
+     */
+    virtual const HandFrameRecord* ReadFrame() = 0;
+
+    /*
+     Current time in microseconds on the clock HandFrameRecord::Timestamp comes from, so the age of a frame can be measured when it is consumed.
+     0 if the source has no live clock (replays, synthetic data).
+     */
+    virtual int64_t GetTrackerTimeMicros()
+    {
+        return 0;
+    }
+};
@@ -0,0 +1,481 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#pragma once
+
+/*
+ Trace points are compiled out of shipping builds: INPUT_TRACE_SCOPE then expands to nothing and INPUT_TRACE_SINCE only evaluates its start time.
+ Define VIRTUAL_JOYSTICK_TRACE to 0 or 1 to override.  When compiled in, tracing is still off until InputTrace::SetEnabled(true), which leaves one relaxed atomic load per trace point.
+ */
+#ifndef VIRTUAL_JOYSTICK_TRACE
+#if defined(UE_BUILD_SHIPPING) && UE_BUILD_SHIPPING
+#define VIRTUAL_JOYSTICK_TRACE 0
+#else
+#define VIRTUAL_JOYSTICK_TRACE 1
+#endif
+#endif
+
+/*
+ Stages of the motion-to-control path
+ */
+enum InputTraceStage
+{
+    INPUT_TRACE_READ_FRAME = 0,           // IHandTrackingSource::ReadFrame(), including the Leap capture
+    INPUT_TRACE_UPDATE_HAND_LOCATIONS = 1, // LeapInputReader::UpdateHandLocations()
+    INPUT_TRACE_CALCULATE_MOVEMENT = 2,    // VirtualJoystick3D::CalculateMovementFromHandLocation()
+    INPUT_TRACE_APPLY_MOVEMENT = 3,        // the game's MoveForward / MoveRight / TurnAtRate calls, traced by the game code
+    INPUT_TRACE_MOTION_TO_CONTROL = 4,     // from a new hand frame reaching the game thread to the movement being applied (see LeapInputReader::GetFrameArrivalNanoseconds())
+    INPUT_TRACE_FRAME_AGE = 5,             // from the tracker timestamping a frame to the game thread first seeing it, on the tracker's clock
+    INPUT_TRACE_STAGE_COUNT = 6
+};
+
+static const char* const INPUT_TRACE_STAGE_NAMES[INPUT_TRACE_STAGE_COUNT] = {
+    "ReadFrame", "UpdateHandLocations", "CalculateMovementFromHandLocation", "ApplyMovement", "MotionToControl", "FrameAge"
+};
+
+struct InputTraceEvent
+{
+    int64_t StartNanoseconds; // InputTrace::Now() clock
+    uint32_t DurationNanoseconds;
+    uint16_t Stage;
+    uint16_t ThreadIndex; // index of the ring, reused by a later thread once the one that had it exits
+};
+
+/**
+ * Log-linear latency histogram in the style of HdrHistogram: 32 linear sub-buckets per power of two, so every value is kept within about 3%
+ * from 1 ns up to the full uint64 range in a fixed 1920 counters.  Recording is a couple of shifts and an increment.
+ */
+class InputTraceHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT = (65 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT; // values from 2^63 up take the last 32
+
+    InputTraceHistogram()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            Counts[i] = 0;
+        }
+        TotalCount = 0;
+        Total = 0;
+        Max = 0;
+    }
+
+    void Record(uint64_t Value)
+    {
+        Counts[GetBucketIndex(Value)]++;
+        TotalCount++;
+        Total += Value;
+        Max = Value > Max ? Value : Max;
+    }
+
+    uint64_t GetCount() const
+    {
+        return TotalCount;
+    }
+
+    uint64_t GetMax() const
+    {
+        return Max;
+    }
+
+    double GetMean() const
+    {
+        return TotalCount > 0 ? (double)Total / TotalCount : 0.0;
+    }
+
+    /*
+     Value at Fraction (0 to 1) of the recorded values, reported as the upper end of its bucket (so never below the real percentile)
+     */
+    uint64_t GetPercentile(double Fraction) const
+    {
+        if (TotalCount == 0) {
+            return 0;
+        }
+        uint64_t Rank = (uint64_t)(Fraction * TotalCount + 0.5);
+        Rank = Rank < 1 ? 1 : (Rank > TotalCount ? TotalCount : Rank);
+        uint64_t Seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            Seen += Counts[i];
+            if (Seen >= Rank) {
+                uint64_t Upper = i + 1 < BUCKET_COUNT ? GetBucketLowerBound(i + 1) - 1 : UINT64_MAX;
+                return Upper < Max ? Upper : Max;
+            }
+        }
+        return Max;
+    }
+
+    static int GetBucketIndex(uint64_t Value)
+    {
+        if (Value < 2 * SUB_BUCKET_COUNT) {
+            return (int)Value;
+        }
+        int Shift = HighestBit(Value) - SUB_BUCKET_BITS;
+        return (Shift + 1) * SUB_BUCKET_COUNT + (int)((Value >> Shift) - SUB_BUCKET_COUNT);
+    }
+
+    static uint64_t GetBucketLowerBound(int Index)
+    {
+        if (Index < 2 * SUB_BUCKET_COUNT) {
+            return (uint64_t)Index;
+        }
+        if (Index >= BUCKET_COUNT) {
+            return UINT64_MAX;
+        }
+        int Shift = Index / SUB_BUCKET_COUNT - 1;
+        return (uint64_t)(SUB_BUCKET_COUNT + Index % SUB_BUCKET_COUNT) << Shift;
+    }
+
+protected:
+
+    static int HighestBit(uint64_t Value)
+    {
+#if defined(_MSC_VER)
+        unsigned long Index;
+        _BitScanReverse64(&Index, Value);
+        return (int)Index;
+#else
+        return 63 - __builtin_clzll(Value);
+#endif
+    }
+
+    uint64_t Counts[BUCKET_COUNT];
+    uint64_t TotalCount;
+    uint64_t Total;
+    uint64_t Max;
+};
+
+/**
+ * Single producer / single consumer ring of trace events, one per tracing thread.  The owning thread writes, InputTrace::Collect() reads.
+ * When the ring is full new events are dropped and counted, the producer never waits.  When its thread exits the ring goes back to InputTrace
+ * for the next new thread, so threads that come and go do not each leave one behind.
+ */
+struct InputTraceRing
+{
+    static const uint32_t CAPACITY = 4096;
+
+    InputTraceEvent Events[CAPACITY];
+    std::atomic<uint64_t> Head;
+    std::atomic<uint64_t> Tail;
+    std::atomic<uint64_t> Dropped;
+    uint16_t ThreadIndex;
+
+    InputTraceRing(uint16_t ThreadIndex) : Head(0), Tail(0), Dropped(0), ThreadIndex(ThreadIndex) {}
+
+    void Push(int64_t StartNanoseconds, int64_t DurationNanoseconds, int Stage)
+    {
+        uint64_t CurrentHead = Head.load(std::memory_order_relaxed);
+        if (CurrentHead - Tail.load(std::memory_order_acquire) >= CAPACITY) {
+            Dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        InputTraceEvent& Event = Events[CurrentHead & (CAPACITY - 1)];
+        Event.StartNanoseconds = StartNanoseconds;
+        Event.DurationNanoseconds = DurationNanoseconds < 0 ? 0u : (DurationNanoseconds > 0xffffffffll ? 0xffffffffu : (uint32_t)DurationNanoseconds);
+        Event.Stage = (uint16_t)Stage;
+        Event.ThreadIndex = ThreadIndex;
+        Head.store(CurrentHead + 1, std::memory_order_release);
+    }
+};
+
+/**
+ * Process-wide tracer for the input path.  Trace points (INPUT_TRACE_SCOPE / INPUT_TRACE_SINCE) push events into a ring owned by the calling thread,
+ * registered on its first event and recycled when the thread exits.  At most MAX_THREAD_RINGS threads trace at the same time, events of any
+ * further thread are counted as dropped.  Collect(), called from any one thread (e.g. once per frame or at the end of a session), drains every ring into one latency histogram
+ * per stage and keeps the events for WriteChromeTrace(), up to a fixed number.
+ */
+class InputTrace
+{
+public:
+    static const size_t MAX_THREAD_RINGS = 256; // about 64 KB each
+
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void SetEnabled(bool Enabled)
+    {
+        GetEnabledFlag().store(Enabled, std::memory_order_relaxed);
+    }
+
+    static bool IsEnabled()
+    {
+        return GetEnabledFlag().load(std::memory_order_relaxed);
+    }
+
+    /*
+     Records one event on the calling thread's ring
+     */
+    static void Record(int Stage, int64_t StartNanoseconds, int64_t EndNanoseconds)
+    {
+        InputTraceRing* Ring = GetThreadRing();
+        if (Ring == nullptr) {
+            GetState().DroppedWithoutRing.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Ring->Push(StartNanoseconds, EndNanoseconds - StartNanoseconds, Stage);
+    }
+
+    /*
+     Drains all rings into the histograms and the retained events
+     */
+    static void Collect()
+    {
+        InputTraceState& State = GetState();
+        std::lock_guard<std::mutex> Lock(State.Mutex);
+        for (size_t RingIndex = 0; RingIndex < State.Rings.size(); RingIndex++) {
+            InputTraceRing& Ring = *State.Rings[RingIndex];
+            uint64_t Tail = Ring.Tail.load(std::memory_order_relaxed);
+            uint64_t Head = Ring.Head.load(std::memory_order_acquire);
+            for (; Tail != Head; Tail++) {
+                const InputTraceEvent& Event = Ring.Events[Tail & (InputTraceRing::CAPACITY - 1)];
+                State.Histograms[Event.Stage].Record(Event.DurationNanoseconds);
+                if (State.RetainedEvents.size() < State.MaxRetainedEvents) {
+                    State.RetainedEvents.push_back(Event);
+                }
+                else {
+                    State.EventsNotRetained++;
+                }
+            }
+            Ring.Tail.store(Tail, std::memory_order_release);
+        }
+    }
+
+    /*
+     Copy of the histogram of one stage, as of the last Collect()
+     */
+    static InputTraceHistogram GetHistogram(int Stage)
+    {
+        InputTraceState& State = GetState();
+        std::lock_guard<std::mutex> Lock(State.Mutex);
+        return State.Histograms[Stage];
+    }
+
+    /*
+     Events lost because a ring was full (Collect() not called often enough) or more than MAX_THREAD_RINGS threads were tracing
+     */
+    static uint64_t GetDroppedCount()
+    {
+        InputTraceState& State = GetState();
+        std::lock_guard<std::mutex> Lock(State.Mutex);
+        uint64_t Dropped = State.DroppedWithoutRing.load(std::memory_order_relaxed);
+        for (size_t RingIndex = 0; RingIndex < State.Rings.size(); RingIndex++) {
+            Dropped += State.Rings[RingIndex]->Dropped.load(std::memory_order_relaxed);
+        }
+        return Dropped;
+    }
+
+    /*
+     Clears histograms and retained events (the rings keep their registration).  MaxRetainedEvents bounds the memory kept for WriteChromeTrace(), 0 keeps none.
+     */
+    static void Reset(size_t MaxRetainedEvents = 1 << 20)
+    {
+        InputTraceState& State = GetState();
+        std::lock_guard<std::mutex> Lock(State.Mutex);
+        for (int Stage = 0; Stage < INPUT_TRACE_STAGE_COUNT; Stage++) {
+            State.Histograms[Stage].Reset();
+        }
+        State.RetainedEvents.clear();
+        State.RetainedEvents.reserve(MaxRetainedEvents);
+        State.MaxRetainedEvents = MaxRetainedEvents;
+        State.EventsNotRetained = 0;
+    }
+
+    /*
+     Writes the retained events as Chrome trace JSON (chrome://tracing, Perfetto): one complete ("X") event per trace point, one track per thread.
+     */
+    static bool WriteChromeTrace(const char* Path)
+    {
+        FILE* File = fopen(Path, "w");
+        if (File == nullptr) {
+            return false;
+        }
+        InputTraceState& State = GetState();
+        std::lock_guard<std::mutex> Lock(State.Mutex);
+        int64_t Epoch = State.RetainedEvents.empty() ? 0 : State.RetainedEvents[0].StartNanoseconds;
+        for (size_t i = 1; i < State.RetainedEvents.size(); i++) {
+            Epoch = State.RetainedEvents[i].StartNanoseconds < Epoch ? State.RetainedEvents[i].StartNanoseconds : Epoch;
+        }
+        fprintf(File, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        for (size_t i = 0; i < State.RetainedEvents.size(); i++) {
+            const InputTraceEvent& Event = State.RetainedEvents[i];
+            fprintf(File, "%s{\"name\":\"%s\",\"cat\":\"input\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", i > 0 ? ",\n" : "",
+                    INPUT_TRACE_STAGE_NAMES[Event.Stage], (unsigned)Event.ThreadIndex, (Event.StartNanoseconds - Epoch) / 1000.0, Event.DurationNanoseconds / 1000.0);
+        }
+        fprintf(File, "\n]}\n");
+        return fclose(File) == 0;
+    }
+
+    /*
+     One line per stage: count, mean, p50/p90/p99/p99.9 and max in microseconds
+     */
+    static void PrintSummary(FILE* Output)
+    {
+        fprintf(Output, "%-36s %10s %9s %9s %9s %9s %9s %9s\n", "stage (us)", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+        for (int Stage = 0; Stage < INPUT_TRACE_STAGE_COUNT; Stage++) {
+            InputTraceHistogram Histogram = GetHistogram(Stage);
+            if (Histogram.GetCount() == 0) {
+                continue;
+            }
+            fprintf(Output, "%-36s %10llu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", INPUT_TRACE_STAGE_NAMES[Stage], (unsigned long long)Histogram.GetCount(),
+                    Histogram.GetMean() / 1000.0, Histogram.GetPercentile(0.5) / 1000.0, Histogram.GetPercentile(0.9) / 1000.0,
+                    Histogram.GetPercentile(0.99) / 1000.0, Histogram.GetPercentile(0.999) / 1000.0, Histogram.GetMax() / 1000.0);
+        }
+    }
+
+protected:
+
+    struct InputTraceState
+    {
+        std::mutex Mutex;
+        std::vector<std::unique_ptr<InputTraceRing>> Rings;
+        std::vector<InputTraceRing*> FreeRings; // rings of threads that exited, Collect() still drains them
+        std::atomic<size_t> FreeRingCount;      // FreeRings.size(), read without the lock
+        std::atomic<uint64_t> DroppedWithoutRing;
+        InputTraceHistogram Histograms[INPUT_TRACE_STAGE_COUNT];
+        std::vector<InputTraceEvent> RetainedEvents;
+        size_t MaxRetainedEvents;
+        uint64_t EventsNotRetained;
+
+        InputTraceState() : FreeRingCount(0), DroppedWithoutRing(0), MaxRetainedEvents(1 << 20), EventsNotRetained(0) {}
+    };
+
+    /*
+     Hands the thread's ring back when the thread exits.  Thread locals are destroyed before statics, so the state is still there.
+     */
+    struct ThreadRingOwner
+    {
+        InputTraceRing* Ring;
+        bool Exhausted; // no ring was free last time, only retry once one is
+
+        ThreadRingOwner() : Ring(nullptr), Exhausted(false) {}
+
+        ~ThreadRingOwner()
+        {
+            if (Ring != nullptr) {
+                InputTraceState& State = GetState();
+                std::lock_guard<std::mutex> Lock(State.Mutex);
+                State.FreeRings.push_back(Ring);
+                State.FreeRingCount.store(State.FreeRings.size(), std::memory_order_relaxed);
+            }
+        }
+    };
+
+    static InputTraceState& GetState()
+    {
+        static InputTraceState State;
+        return State;
+    }
+
+    static std::atomic<bool>& GetEnabledFlag()
+    {
+        static std::atomic<bool> Enabled(false);
+        return Enabled;
+    }
+
+    /*
+     The calling thread's ring, taken from the free rings or created on first use (the only time tracing takes a lock).  nullptr while all
+     MAX_THREAD_RINGS rings belong to running threads.
+     */
+    static InputTraceRing* GetThreadRing()
+    {
+        static thread_local ThreadRingOwner Owner;
+        if (Owner.Ring != nullptr) {
+            return Owner.Ring;
+        }
+        InputTraceState& State = GetState();
+        if (Owner.Exhausted && State.FreeRingCount.load(std::memory_order_relaxed) == 0) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> Lock(State.Mutex);
+        if (!State.FreeRings.empty()) {
+            Owner.Ring = State.FreeRings.back();
+            State.FreeRings.pop_back();
+            State.FreeRingCount.store(State.FreeRings.size(), std::memory_order_relaxed);
+        }
+        else if (State.Rings.size() < MAX_THREAD_RINGS) {
+            State.Rings.push_back(std::unique_ptr<InputTraceRing>(new InputTraceRing((uint16_t)State.Rings.size())));
+            Owner.Ring = State.Rings.back().get();
+        }
+        Owner.Exhausted = Owner.Ring == nullptr;
+        return Owner.Ring;
+    }
+};
+
+/**
+ * Traces the enclosing scope as one event of Stage, if tracing is enabled when the scope is entered
+ */
+class InputTraceScope
+{
+public:
+    explicit InputTraceScope(int Stage)
+    {
+        this->Stage = Stage;
+        StartNanoseconds = InputTrace::IsEnabled() ? InputTrace::Now() : 0;
+    }
+
+    ~InputTraceScope()
+    {
+        if (StartNanoseconds != 0) {
+            InputTrace::Record(Stage, StartNanoseconds, InputTrace::Now());
+        }
+    }
+
+protected:
+    int Stage;
+    int64_t StartNanoseconds;
+};
+
+#if VIRTUAL_JOYSTICK_TRACE
+#define INPUT_TRACE_CONCAT_INNER(A, B) A##B
+#define INPUT_TRACE_CONCAT(A, B) INPUT_TRACE_CONCAT_INNER(A, B)
+#define INPUT_TRACE_SCOPE(Stage) InputTraceScope INPUT_TRACE_CONCAT(InputTraceScope_, __LINE__)(Stage)
+// records an event of Stage from StartNanoseconds (InputTrace::Now() clock, 0 = unknown) until now
+#define INPUT_TRACE_SINCE(Stage, StartNanoseconds) do { int64_t InputTraceStart = (StartNanoseconds); if (InputTraceStart != 0 && InputTrace::IsEnabled()) { InputTrace::Record((Stage), InputTraceStart, InputTrace::Now()); } } while (0)
+#else
+#define INPUT_TRACE_SCOPE(Stage) do { } while (0)
+#define INPUT_TRACE_SINCE(Stage, StartNanoseconds) do { (void)(StartNanoseconds); } while (0)
+#endif
@@ -0,0 +1,173 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#pragma once
+
+/**
+ * Small fixed-size pool of worker threads for data-parallel loops over arrays (ParallelFor).
+ * Work is handed out in chunks through an atomic counter and the calling thread works on chunks too, so a pool of N threads keeps N cores busy.
+ * Jobs are a plain function pointer plus context, so dispatching never allocates.  One ParallelFor at a time, from one thread.
+ */
+class JobThreadPool
+{
+public:
+    typedef void (*RangeFunction)(void* Context, size_t Begin, size_t End);
+
+    /*
+     ThreadCount includes the calling thread, 0 means one per hardware thread
+     */
+    explicit JobThreadPool(int ThreadCount = 0)
+    {
+        if (ThreadCount <= 0) {
+            ThreadCount = (int)std::thread::hardware_concurrency();
+        }
+        if (ThreadCount <= 0) {
+            ThreadCount = 1;
+        }
+        this->ThreadCount = ThreadCount;
+        Generation = 0;
+        ShuttingDown = false;
+        WorkersDone = 0;
+        Function = nullptr;
+        Context = nullptr;
+        Count = 0;
+        ChunkSize = 1;
+        NextBegin.store(0);
+        for (int i = 1; i < ThreadCount; i++) {
+            Workers.push_back(std::thread(&JobThreadPool::WorkerLoop, this));
+        }
+    }
+
+    ~JobThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            ShuttingDown = true;
+        }
+        WorkAvailable.notify_all();
+        for (size_t i = 0; i < Workers.size(); i++) {
+            Workers[i].join();
+        }
+    }
+
+    int GetThreadCount() const
+    {
+        return ThreadCount;
+    }
+
+    /*
+     Calls Function(Context, Begin, End) for consecutive ranges covering [0, Count), at most ChunkSize long, spread over all threads.  Returns when all ranges are done.
+     */
+    void ParallelFor(size_t Count, size_t ChunkSize, RangeFunction Function, void* Context)
+    {
+        if (Count == 0) {
+            return;
+        }
+        if (ChunkSize == 0) {
+            ChunkSize = 1;
+        }
+        if (Workers.empty() || Count <= ChunkSize) {
+            Function(Context, 0, Count);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            this->Function = Function;
+            this->Context = Context;
+            this->Count = Count;
+            this->ChunkSize = ChunkSize;
+            NextBegin.store(0, std::memory_order_relaxed);
+            WorkersDone = 0;
+            Generation++;
+        }
+        WorkAvailable.notify_all();
+        RunChunks();
+        // wait until every worker has left this job, so the job fields can be reused by the next call
+        std::unique_lock<std::mutex> Lock(Mutex);
+        AllDone.wait(Lock, [this] { return WorkersDone == Workers.size(); });
+    }
+
+protected:
+
+    void RunChunks()
+    {
+        for (;;) {
+            size_t Begin = NextBegin.fetch_add(ChunkSize, std::memory_order_relaxed);
+            if (Begin >= Count) {
+                return;
+            }
+            size_t End = Begin + ChunkSize < Count ? Begin + ChunkSize : Count;
+            Function(Context, Begin, End);
+        }
+    }
+
+    void WorkerLoop()
+    {
+        uint64_t SeenGeneration = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> Lock(Mutex);
+                WorkAvailable.wait(Lock, [this, SeenGeneration] { return ShuttingDown || Generation != SeenGeneration; });
+                if (ShuttingDown) {
+                    return;
+                }
+                SeenGeneration = Generation;
+            }
+            RunChunks();
+            {
+                std::lock_guard<std::mutex> Lock(Mutex);
+                WorkersDone++;
+            }
+            AllDone.notify_one();
+        }
+    }
+
+    int ThreadCount;
+    std::vector<std::thread> Workers;
+    std::mutex Mutex;
+    std::condition_variable WorkAvailable;
+    std::condition_variable AllDone;
+    uint64_t Generation;
+    bool ShuttingDown;
+    size_t WorkersDone;
+
+    // the current job, written under the mutex before the workers are woken
+    RangeFunction Function;
+    void* Context;
+    size_t Count;
+    size_t ChunkSize;
+    std::atomic<size_t> NextBegin;
+};
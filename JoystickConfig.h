@@ -0,0 +1,497 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HandJointFilter.h"
+
+#pragma once
+
+/**
+ * Everything that used to need a recompile to retune: the joystick tuning, the Leap to Unreal transform settings and the hand filter.
+ * The defaults are the constructor values of VirtualJoystick3D and LeapInputReader.  Snapshots are immutable once published.
+ */
+struct JoystickConfig
+{
+    JoystickTuning Tuning;       // the response curves are not part of the config and stay nullptr
+    HandSpaceSettings HandSpace;
+    HandFilterSettings Filter;
+    bool DrawSimpleHands;
+    uint32_t Generation;         // 0 for the defaults, increases with every published snapshot
+
+    JoystickConfig()
+    {
+        DrawSimpleHands = true;
+        Generation = 0;
+    }
+};
+
+/**
+ * Reads and writes the ini form of JoystickConfig, the DefaultInput.ini style:
+ *     ; comment
+ *     [VirtualJoystick3D]
+ *     ActivationDiskRadius=20
+ *     ActivationDiskLocationX=60
+ *     [LeapInputReader]
+ *     LeapMountOffsetX=150
+ *     [HandFilter]
+ *     Enabled=true
+ * Keys left out keep the value of the base config, so a file can hold only what it changes.
+ */
+class JoystickConfigFile
+{
+public:
+
+    /*
+     Parses Text on top of Base into OutConfig and validates the result.  On a malformed line, an unknown key or a value Validate() rejects it
+     returns false with the reason in OutError and OutConfig is not to be used, so a file caught half written is never applied.  OutError is
+     cleared on success.
+     */
+    static bool Parse(const char* Text, const JoystickConfig& Base, JoystickConfig& OutConfig, std::string& OutError)
+    {
+        OutError.clear();
+        OutConfig = Base;
+        std::string Section;
+        int LineNumber = 0;
+        const char* Line = Text;
+        while (*Line != '\0') {
+            const char* LineEnd = Line;
+            while (*LineEnd != '\0' && *LineEnd != '\n') {
+                LineEnd++;
+            }
+            LineNumber++;
+            std::string Content = Trim(std::string(Line, LineEnd));
+            Line = *LineEnd == '\n' ? LineEnd + 1 : LineEnd;
+            if (Content.empty() || Content[0] == ';' || Content[0] == '#') {
+                continue;
+            }
+            if (Content[0] == '[') {
+                if (Content[Content.size() - 1] != ']') {
+                    return Fail(OutError, LineNumber, "unterminated section name");
+                }
+                Section = Trim(Content.substr(1, Content.size() - 2));
+                continue;
+            }
+            size_t Equals = Content.find('=');
+            if (Equals == std::string::npos) {
+                return Fail(OutError, LineNumber, "expected Key=Value");
+            }
+            std::string Key = Trim(Content.substr(0, Equals));
+            std::string Value = Trim(Content.substr(Equals + 1));
+            const JoystickConfigKey* Entry = FindKey(Section, Key);
+            if (Entry == nullptr) {
+                return Fail(OutError, LineNumber, "unknown key " + Key + " in section [" + Section + "]");
+            }
+            if (!ParseValue(*Entry, Value, OutConfig)) {
+                return Fail(OutError, LineNumber, "bad value for " + Key);
+            }
+        }
+        return Validate(OutConfig, OutError);
+    }
+
+    /*
+     Checks that a config makes sense and not only parses: every number finite, the radii and scaling factors positive, the donut hole inside
+     the movement disk (else CalculateSpeed() divides by zero or goes negative) and positive filter cutoffs.  False with the reason in OutError.
+     */
+    static bool Validate(const JoystickConfig& Config, std::string& OutError)
+    {
+        int KeyCount;
+        const JoystickConfigKey* Keys = GetKeys(KeyCount);
+        for (int i = 0; i < KeyCount; i++) {
+            if (Keys[i].Type == CONFIG_VALUE_FLOAT && !std::isfinite(*(float*)Keys[i].Field(const_cast<JoystickConfig&>(Config)))) {
+                OutError = std::string(Keys[i].Name) + " must be a finite number";
+                return false;
+            }
+        }
+        const JoystickTuning& Tuning = Config.Tuning;
+        const char* Problem = nullptr;
+        if (Tuning.ActivationDiskRadius <= 0.f) {
+            Problem = "ActivationDiskRadius must be greater than 0";
+        }
+        else if (Tuning.MovementDiskRadius <= 0.f) {
+            Problem = "MovementDiskRadius must be greater than 0";
+        }
+        else if (Tuning.MovementDiskDonutHoleRadius < 0.f || Tuning.MovementDiskDonutHoleRadius >= Tuning.MovementDiskRadius) {
+            Problem = "MovementDiskDonutHoleRadius must be at least 0 and less than MovementDiskRadius";
+        }
+        else if (Tuning.SpeedScalingFactor <= 0.f) {
+            Problem = "SpeedScalingFactor must be greater than 0";
+        }
+        else if (Tuning.MaxTurnRate < 0.f || Tuning.TurnAngleToRateScale < 0.f) {
+            Problem = "MaxTurnRate and TurnAngleToRateScale must not be negative";
+        }
+        else if (Tuning.TurnAngleThreshold < 0.f || Tuning.TurnAngleThreshold >= 180.f) {
+            Problem = "TurnAngleThreshold must be between 0 and 180 degrees";
+        }
+        else if (Tuning.DeactivationBufferHeight < 0.f) {
+            Problem = "DeactivationBufferHeight must not be negative";
+        }
+        else if (Config.HandSpace.LeapToUnrealScalingFactor <= 0.f) {
+            Problem = "LeapToUnrealScalingFactor must be greater than 0";
+        }
+        else if (Config.Filter.MinCutoff <= 0.f || Config.Filter.DerivativeCutoff <= 0.f) {
+            Problem = "MinCutoff and DerivativeCutoff must be greater than 0";
+        }
+        else if (Config.Filter.Beta < 0.f || Config.Filter.PredictionSeconds < 0.f) {
+            Problem = "Beta and PredictionSeconds must not be negative";
+        }
+        if (Problem != nullptr) {
+            OutError = Problem;
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     Loads Path on top of Base, false if the file cannot be read or does not parse.  OutError is cleared on success.
+     */
+    static bool Load(const char* Path, const JoystickConfig& Base, JoystickConfig& OutConfig, std::string& OutError)
+    {
+        OutError.clear();
+        std::string Text;
+        if (!ReadText(Path, Text)) {
+            OutError = std::string("could not open ") + Path;
+            return false;
+        }
+        return Parse(Text.c_str(), Base, OutConfig, OutError);
+    }
+
+    static bool ReadText(const char* Path, std::string& OutText)
+    {
+        FILE* File = fopen(Path, "rb");
+        if (File == nullptr) {
+            return false;
+        }
+        OutText.clear();
+        char Buffer[4096];
+        size_t Read;
+        while ((Read = fread(Buffer, 1, sizeof(Buffer), File)) > 0) {
+            OutText.append(Buffer, Read);
+        }
+        fclose(File);
+        return true;
+    }
+
+    /*
+     Writes every key, e.g. to create a config file holding the current defaults.  Comment, if given, goes first as '; ' lines, one per line of it.
+     */
+    static bool Write(const char* Path, const JoystickConfig& Config, const char* Comment = nullptr)
+    {
+        FILE* File = fopen(Path, "w");
+        if (File == nullptr) {
+            return false;
+        }
+        while (Comment != nullptr && *Comment != '\0') {
+            const char* CommentEnd = strchr(Comment, '\n');
+            size_t Length = CommentEnd != nullptr ? (size_t)(CommentEnd - Comment) : strlen(Comment);
+            fprintf(File, "; %.*s\n", (int)Length, Comment);
+            Comment = CommentEnd != nullptr ? CommentEnd + 1 : Comment + Length;
+        }
+        const char* Section = "";
+        int KeyCount;
+        const JoystickConfigKey* Keys = GetKeys(KeyCount);
+        for (int i = 0; i < KeyCount; i++) {
+            if (strcmp(Section, Keys[i].Section) != 0) {
+                Section = Keys[i].Section;
+                fprintf(File, "%s[%s]\n", i > 0 ? "\n" : "", Section);
+            }
+            void* Field = Keys[i].Field(const_cast<JoystickConfig&>(Config));
+            if (Keys[i].Type == CONFIG_VALUE_BOOL) {
+                fprintf(File, "%s=%s\n", Keys[i].Name, *(bool*)Field ? "true" : "false");
+            }
+            else {
+                fprintf(File, "%s=%.9g\n", Keys[i].Name, *(float*)Field);
+            }
+        }
+        return fclose(File) == 0;
+    }
+
+protected:
+    enum JoystickConfigValueType
+    {
+        CONFIG_VALUE_FLOAT,
+        CONFIG_VALUE_BOOL
+    };
+
+    struct JoystickConfigKey
+    {
+        const char* Section;
+        const char* Name;
+        JoystickConfigValueType Type;
+        void* (*Field)(JoystickConfig& Config);
+    };
+
+    static const JoystickConfigKey* GetKeys(int& OutCount)
+    {
+        static const JoystickConfigKey Keys[] = {
+            { "VirtualJoystick3D", "ActivationDiskRadius", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.ActivationDiskRadius; } },
+            { "VirtualJoystick3D", "MovementDiskHeight", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.MovementDiskHeight; } },
+            { "VirtualJoystick3D", "MovementDiskRadius", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.MovementDiskRadius; } },
+            { "VirtualJoystick3D", "MovementDiskDonutHoleRadius", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.MovementDiskDonutHoleRadius; } },
+            { "VirtualJoystick3D", "TurnAngleThreshold", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.TurnAngleThreshold; } },
+            { "VirtualJoystick3D", "TurnRateOffset", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.TurnRateOffset; } },
+            { "VirtualJoystick3D", "MaxTurnRate", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.MaxTurnRate; } },
+            { "VirtualJoystick3D", "TurnAngleToRateScale", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.TurnAngleToRateScale; } },
+            { "VirtualJoystick3D", "DeactivationBufferHeight", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.DeactivationBufferHeight; } },
+            { "VirtualJoystick3D", "SpeedScalingFactor", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.SpeedScalingFactor; } },
+            { "VirtualJoystick3D", "ActivationDiskLocationX", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.ActivationDiskLocation.X; } },
+            { "VirtualJoystick3D", "ActivationDiskLocationY", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.ActivationDiskLocation.Y; } },
+            { "VirtualJoystick3D", "ActivationDiskLocationZ", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Tuning.ActivationDiskLocation.Z; } },
+            { "LeapInputReader", "LeapToUnrealScalingFactor", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.HandSpace.LeapToUnrealScalingFactor; } },
+            { "LeapInputReader", "LeapMountOffsetX", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.HandSpace.LeapMountOffset.X; } },
+            { "LeapInputReader", "LeapMountOffsetY", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.HandSpace.LeapMountOffset.Y; } },
+            { "LeapInputReader", "LeapMountOffsetZ", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.HandSpace.LeapMountOffset.Z; } },
+            { "LeapInputReader", "LeapHandOffsetX", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.HandSpace.LeapHandOffset.X; } },
+            { "LeapInputReader", "LeapHandOffsetY", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.HandSpace.LeapHandOffset.Y; } },
+            { "LeapInputReader", "LeapHandOffsetZ", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.HandSpace.LeapHandOffset.Z; } },
+            { "LeapInputReader", "LeapDrawSimpleHands", CONFIG_VALUE_BOOL, [](JoystickConfig& C) -> void* { return &C.DrawSimpleHands; } },
+            { "HandFilter", "Enabled", CONFIG_VALUE_BOOL, [](JoystickConfig& C) -> void* { return &C.Filter.Enabled; } },
+            { "HandFilter", "MinCutoff", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Filter.MinCutoff; } },
+            { "HandFilter", "Beta", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Filter.Beta; } },
+            { "HandFilter", "DerivativeCutoff", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Filter.DerivativeCutoff; } },
+            { "HandFilter", "PredictionSeconds", CONFIG_VALUE_FLOAT, [](JoystickConfig& C) -> void* { return &C.Filter.PredictionSeconds; } },
+        };
+        OutCount = (int)(sizeof(Keys) / sizeof(Keys[0]));
+        return Keys;
+    }
+
+    static const JoystickConfigKey* FindKey(const std::string& Section, const std::string& Name)
+    {
+        int KeyCount;
+        const JoystickConfigKey* Keys = GetKeys(KeyCount);
+        for (int i = 0; i < KeyCount; i++) {
+            if (Section == Keys[i].Section && Name == Keys[i].Name) {
+                return &Keys[i];
+            }
+        }
+        return nullptr;
+    }
+
+    static bool ParseValue(const JoystickConfigKey& Key, const std::string& Value, JoystickConfig& Config)
+    {
+        void* Field = Key.Field(Config);
+        if (Key.Type == CONFIG_VALUE_BOOL) {
+            if (Value == "true" || Value == "True" || Value == "1") {
+                *(bool*)Field = true;
+                return true;
+            }
+            if (Value == "false" || Value == "False" || Value == "0") {
+                *(bool*)Field = false;
+                return true;
+            }
+            return false;
+        }
+        char* End = nullptr;
+        float Number = strtof(Value.c_str(), &End);
+        if (Value.empty() || *End != '\0' || Number != Number) {
+            return false;
+        }
+        *(float*)Field = Number;
+        return true;
+    }
+
+    static std::string Trim(const std::string& Text)
+    {
+        size_t Begin = Text.find_first_not_of(" \t\r");
+        if (Begin == std::string::npos) {
+            return std::string();
+        }
+        size_t End = Text.find_last_not_of(" \t\r");
+        return Text.substr(Begin, End - Begin + 1);
+    }
+
+    static bool Fail(std::string& OutError, int LineNumber, const std::string& Message)
+    {
+        OutError = "line " + std::to_string(LineNumber) + ": " + Message;
+        return false;
+    }
+};
+
+/**
+ * Holds the current config snapshot behind an atomic pointer.  Readers call Get() once per tick: a single acquire load, no lock, and the snapshot
+ * stays valid for as long as the store lives.  Publish() swaps in a new snapshot; the old ones are retired, not freed, because a reader on another
+ * thread may still be looking at them.  A snapshot is a few hundred bytes and is only made when the file changes, so keeping them is cheaper than
+ * any reclamation scheme on the read side.
+ */
+class JoystickConfigStore
+{
+public:
+    JoystickConfigStore()
+    {
+        Snapshots.push_back(new JoystickConfig());
+        Current.store(Snapshots.back(), std::memory_order_release);
+    }
+
+    ~JoystickConfigStore()
+    {
+        for (size_t i = 0; i < Snapshots.size(); i++) {
+            delete Snapshots[i];
+        }
+    }
+
+    const JoystickConfig* Get() const
+    {
+        return Current.load(std::memory_order_acquire);
+    }
+
+    /*
+     Publishes a copy of Config as the new snapshot and returns it.  Safe to call from any thread.
+     */
+    const JoystickConfig* Publish(const JoystickConfig& Config)
+    {
+        std::lock_guard<std::mutex> Lock(PublishMutex);
+        JoystickConfig* Snapshot = new JoystickConfig(Config);
+        Snapshot->Generation = Current.load(std::memory_order_relaxed)->Generation + 1;
+        Snapshots.push_back(Snapshot);
+        Current.store(Snapshot, std::memory_order_release);
+        return Snapshot;
+    }
+
+protected:
+    std::atomic<const JoystickConfig*> Current;
+    std::mutex PublishMutex;
+    std::vector<JoystickConfig*> Snapshots; // every snapshot ever published, freed with the store
+
+private:
+    JoystickConfigStore(const JoystickConfigStore&);
+    JoystickConfigStore& operator=(const JoystickConfigStore&);
+};
+
+/**
+ * Watches a config file on a background thread and publishes it to a JoystickConfigStore whenever it changes, for live retuning of a running build.
+ * Files that parse but fail JoystickConfigFile::Validate() are not applied either.
+ * The file is read every PollMilliseconds (it is small and this is off the game thread) and compared with the last contents, which unlike
+ * modification times also catches two saves within a second.  Changed contents are only parsed once they stayed the same for one more poll, so an
+ * editor's partial write is skipped.  A file that does not parse is not applied (the previous snapshot stays) and GetLastError() says why.
+ * Values missing from the file are the JoystickConfig defaults.
+ */
+class JoystickConfigWatcher
+{
+public:
+    JoystickConfigWatcher(JoystickConfigStore* Store, const char* Path, int PollMilliseconds = 250)
+    {
+        this->Store = Store;
+        this->Path = Path;
+        this->PollMilliseconds = PollMilliseconds;
+        Stopping = false;
+        LoadCount = 0;
+        // the first load happens right away so the config is in place before the first tick
+        PollOnce(true);
+        Thread = std::thread(&JoystickConfigWatcher::WatchLoop, this);
+    }
+
+    ~JoystickConfigWatcher()
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            Stopping = true;
+        }
+        Wake.notify_all();
+        Thread.join();
+    }
+
+    /*
+     Empty when the last load succeeded
+     */
+    std::string GetLastError()
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        return LastError;
+    }
+
+    uint32_t GetLoadCount()
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        return LoadCount;
+    }
+
+protected:
+    void WatchLoop()
+    {
+        std::unique_lock<std::mutex> Lock(Mutex);
+        while (!Stopping) {
+            Wake.wait_for(Lock, std::chrono::milliseconds(PollMilliseconds));
+            if (Stopping) {
+                break;
+            }
+            Lock.unlock();
+            PollOnce(false);
+            Lock.lock();
+        }
+    }
+
+    void PollOnce(bool Initial)
+    {
+        std::string Text;
+        if (!JoystickConfigFile::ReadText(Path.c_str(), Text)) {
+            return; // keep the current snapshot while the file is missing, e.g. during an editor's save by rename
+        }
+        if (Text == LoadedText) {
+            PolledText.clear();
+            return;
+        }
+        if (!Initial && Text != PolledText) {
+            // changed since the last poll, wait until it is stable
+            PolledText.swap(Text);
+            return;
+        }
+        LoadedText = Text;
+        PolledText.clear();
+        JoystickConfig Config;
+        std::string Error;
+        bool Loaded = JoystickConfigFile::Parse(Text.c_str(), JoystickConfig(), Config, Error);
+        if (Loaded) {
+            Store->Publish(Config);
+        }
+        std::lock_guard<std::mutex> Lock(Mutex);
+        LastError = Loaded ? std::string() : Error;
+        LoadCount += Loaded ? 1 : 0;
+    }
+
+    JoystickConfigStore* Store;
+    std::string Path;
+    int PollMilliseconds;
+    std::thread Thread;
+    std::mutex Mutex;
+    std::condition_variable Wake;
+    bool Stopping;
+    std::string LastError;
+    uint32_t LoadCount;
+    // only touched by PollOnce(), i.e. the constructor and then the watcher thread
+    std::string LoadedText; // last contents parsed, whether they were valid or not
+    std::string PolledText; // changed contents seen by the last poll, waiting to be stable
+};
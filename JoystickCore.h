@@ -0,0 +1,235 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cmath>
+#include <cstddef>
+#include "ResponseCurve.h"
+
+#pragma once
+
+/**
+ * Engine-independent core of the 3D virtual joystick.
+ * All of the activation state machine, speed curve and turn angle math lives here so it can be run (and measured) outside of a live Unreal world, e.g. to replay recorded hand frames on a build machine.
+ * VirtualJoystick3D is a thin wrapper around this that adds the Unreal types and the debug drawing.
+ */
+
+/*
+ Plain float3 so the core does not depend on FVector.  Same axis convention as Unreal character space: X=forward, Y=right, Z=up
+ */
+struct JoystickVector
+{
+    float X;
+    float Y;
+    float Z;
+};
+
+/*
+ Tuning values for the joystick.  The defaults are the values that VirtualJoystick3D has always used.
+ */
+struct JoystickTuning
+{
+    float ActivationDiskRadius;
+    float MovementDiskHeight;
+    float MovementDiskRadius;
+    float MovementDiskDonutHoleRadius;
+    float TurnAngleThreshold;
+    float TurnRateOffset;
+    float MaxTurnRate;
+    float TurnAngleToRateScale;
+    float DeactivationBufferHeight;
+    float SpeedScalingFactor;
+    JoystickVector ActivationDiskLocation; // in Character space
+
+    /*
+     Optional data-defined curves for speed and turn rate, not owned.  nullptr means the built-in curves: x^2 for speed and x^1.5 for turn rate.
+     */
+    const ResponseCurve* SpeedCurve;
+    const ResponseCurve* TurnCurve;
+
+    JoystickTuning()
+    {
+        ActivationDiskRadius = 20.0;
+        MovementDiskHeight = 0.7;
+        MovementDiskRadius = 10.0;
+        MovementDiskDonutHoleRadius = 2.0;
+        TurnAngleThreshold = 10.0;
+        TurnRateOffset = 0.0;
+        MaxTurnRate = 1.5;
+        TurnAngleToRateScale = 6.0;
+        DeactivationBufferHeight = 10.0;
+        SpeedScalingFactor = 1.0;
+        ActivationDiskLocation.X = 60.0;
+        ActivationDiskLocation.Y = -10.0;
+        ActivationDiskLocation.Z = 45.0;
+        SpeedCurve = nullptr;
+        TurnCurve = nullptr;
+    }
+};
+
+/*
+ Everything the joystick carries over from one frame to the next.
+ */
+struct JoystickState
+{
+    bool IsActivated;
+    JoystickVector DiskLocation; // in Character space
+    float ForwardMovement;
+    float RightMovement;
+    float TurnRate;
+
+    JoystickState()
+    {
+        IsActivated = false;
+        DiskLocation.X = 0.f;
+        DiskLocation.Y = 0.f;
+        DiskLocation.Z = 0.f;
+        ForwardMovement = 0.f;
+        RightMovement = 0.f;
+        TurnRate = 0.f;
+    }
+};
+
+/*
+ One hand sample, palm and middle finger locations in Character space
+ */
+struct JoystickSample
+{
+    JoystickVector PalmLocation;
+    JoystickVector FingerLocation;
+};
+
+struct JoystickOutput
+{
+    float ForwardMovement;
+    float RightMovement;
+    float TurnRate;
+    bool IsActivated;
+};
+
+class VirtualJoystickCore
+{
+public:
+
+    /*
+     Advances the activation state machine and the movement values by one hand sample.  This is exactly what VirtualJoystick3D::CalculateMovementFromHandLocation does minus the drawing.
+     */
+    static JoystickOutput Evaluate(const JoystickTuning& Tuning, JoystickState& State, const JoystickSample& Sample)
+    {
+        UpdateActivation(Tuning, State, Sample.PalmLocation, Sample.FingerLocation);
+        if (State.IsActivated) {
+            // project the movement hand palm location onto the plane of the top of the donut
+            float ForwardPosition = Sample.PalmLocation.X - State.DiskLocation.X;
+            float RightPosition = Sample.PalmLocation.Y - State.DiskLocation.Y;
+            State.ForwardMovement = CalculateSpeed(Tuning, ForwardPosition);
+            State.RightMovement = CalculateSpeed(Tuning, RightPosition);
+            State.TurnRate = CalculateTurnRate(Tuning, Sample.PalmLocation, Sample.FingerLocation);
+        }
+        JoystickOutput Output;
+        Output.ForwardMovement = State.ForwardMovement;
+        Output.RightMovement = State.RightMovement;
+        Output.TurnRate = State.TurnRate;
+        Output.IsActivated = State.IsActivated;
+        return Output;
+    }
+
+    /*
+     Runs a whole sequence of samples through one joystick, in order.  Outputs must have room for Count entries.
+     Intended for offline tuning and regression runs that replay recorded frames, so there is no per-sample overhead beyond the math itself.
+     */
+    static void EvaluateBatch(const JoystickTuning& Tuning, JoystickState& State, const JoystickSample* Samples, JoystickOutput* Outputs, size_t Count)
+    {
+        for (size_t i = 0; i < Count; i++) {
+            Outputs[i] = Evaluate(Tuning, State, Samples[i]);
+        }
+    }
+
+    /*
+     Activation only happens if the middle finger crosses the disk plane inside the activation disk.  Deactivation happens once the finger drops below the plane by more than DeactivationBufferHeight.
+     */
+    static void UpdateActivation(const JoystickTuning& Tuning, JoystickState& State, const JoystickVector& PalmLocation, const JoystickVector& FingerLocation)
+    {
+        const JoystickVector& DiskCenter = Tuning.ActivationDiskLocation;
+        if (FingerLocation.Z > DiskCenter.Z) {
+            if (!State.IsActivated) {
+                // for unactivating crossing the Z plane is fine, but for activating want to make sure we are within the disk.
+                float DeltaX = FingerLocation.X - DiskCenter.X;
+                float DeltaY = FingerLocation.Y - DiskCenter.Y;
+                if (sqrtf(DeltaX * DeltaX + DeltaY * DeltaY) < Tuning.ActivationDiskRadius) {
+                    State.IsActivated = true;
+                    State.DiskLocation.X = PalmLocation.X;
+                    State.DiskLocation.Y = PalmLocation.Y;
+                    State.DiskLocation.Z = DiskCenter.Z;
+                }
+            }
+        }
+        else {
+            if (State.IsActivated && FingerLocation.Z < (DiskCenter.Z - Tuning.DeactivationBufferHeight)) { // have some small buffer for finger going below disk if it's already activated, to make it more robust
+                State.IsActivated = false;
+                State.TurnRate = 0.0;
+                State.ForwardMovement = 0.0;
+                State.RightMovement = 0.0;
+            }
+        }
+    }
+
+    /*
+     The speed function is nonlinear so that the character can move fluidly either fast or slow.  Tuning.SpeedCurve replaces the default x^2.
+     */
+    static float CalculateSpeed(const JoystickTuning& Tuning, float PositionOnMotionDonutAxis)
+    {
+        float Speed = 0.0;
+        if ((fabsf(PositionOnMotionDonutAxis) > Tuning.MovementDiskDonutHoleRadius)) {  // only add forward movement if we are outside of the donut hole
+            float PercentagePosition = (fabsf(PositionOnMotionDonutAxis) - Tuning.MovementDiskDonutHoleRadius) / (Tuning.MovementDiskRadius - Tuning.MovementDiskDonutHoleRadius);
+            float SpeedFunctionValue = Tuning.SpeedCurve != nullptr ? Tuning.SpeedCurve->Evaluate(PercentagePosition) : PowerCurve<2, 1>::Evaluate(PercentagePosition); // by default just square it to make it non-linear
+            Speed = SpeedFunctionValue * copysignf(Tuning.SpeedScalingFactor, PositionOnMotionDonutAxis); // apply scaling factor and restore the positive/negative direction sign
+        }
+        return Speed;
+    }
+
+    /*
+     Turn rate comes from the angle between palm and middle finger, with a dead zone of TurnAngleThreshold degrees.  Tuning.TurnCurve replaces the default x^1.5.
+     */
+    static float CalculateTurnRate(const JoystickTuning& Tuning, const JoystickVector& PalmLocation, const JoystickVector& FingerLocation)
+    {
+        float MovementHandAngleZ = (FingerLocation.Z - PalmLocation.Z);
+        float MovementHandAngleY = (FingerLocation.Y - PalmLocation.Y);
+        float MovementHandAngle = (atan2f(MovementHandAngleY, MovementHandAngleZ) * (180 / JoystickPi));
+        float TurnRate = 0.0;
+        if (fabsf(MovementHandAngle) >= Tuning.TurnAngleThreshold) { // only turn if angle is greater than some threshold
+            float PercentageRotation = (fabsf(MovementHandAngle) - Tuning.TurnAngleThreshold) / 90.0;
+            float TurnFunctionValue = Tuning.TurnCurve != nullptr ? Tuning.TurnCurve->Evaluate(PercentageRotation) : PowerCurve<3, 2>::Evaluate(PercentageRotation);
+            TurnRate = TurnFunctionValue * Tuning.TurnAngleToRateScale * copysignf(1.f, MovementHandAngle);
+            if (TurnRate > Tuning.MaxTurnRate) {
+                TurnRate = Tuning.MaxTurnRate;
+            }
+        }
+        return TurnRate;
+    }
+
+    static constexpr float JoystickPi = 3.1415926535897932f;
+};
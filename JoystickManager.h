@@ -0,0 +1,149 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <vector>
+#include "JoystickCore.h"
+#include "JobThreadPool.h"
+
+#pragma once
+/**
+ * Evaluates many virtual joysticks at once, e.g. every tracked user and replayed "ghost" player in one server process.
+ * The tuning, state and input sample of each joystick are stored as the VirtualJoystickCore structs in three contiguous arrays, and Update()
+ * runs every joystick through VirtualJoystickCore::Evaluate() in place, optionally split across a JobThreadPool.  Joysticks are independent,
+ * so the pass scales with the number of cores.  The arrays are only resized by AddJoystick(), never during Update().
+ */
+class VirtualJoystickManager
+{
+public:
+    VirtualJoystickManager()
+    {
+    }
+
+    /*
+     Reserves room for Capacity joysticks up front so AddJoystick() does not reallocate
+     */
+    void Reserve(size_t Capacity)
+    {
+        Tunings.reserve(Capacity);
+        States.reserve(Capacity);
+        Samples.reserve(Capacity);
+    }
+
+    /*
+     Returns the index of the new joystick, which starts deactivated with a zero sample
+     */
+    size_t AddJoystick(const JoystickTuning& Tuning)
+    {
+        JoystickSample Sample;
+        Sample.PalmLocation.X = Sample.PalmLocation.Y = Sample.PalmLocation.Z = 0.f;
+        Sample.FingerLocation = Sample.PalmLocation;
+        Tunings.push_back(Tuning);
+        States.push_back(JoystickState());
+        Samples.push_back(Sample);
+        return Tunings.size() - 1;
+    }
+
+    size_t GetCount() const
+    {
+        return Tunings.size();
+    }
+
+    void SetTuning(size_t Index, const JoystickTuning& Tuning)
+    {
+        Tunings[Index] = Tuning;
+    }
+
+    const JoystickTuning& GetTuning(size_t Index) const
+    {
+        return Tunings[Index];
+    }
+
+    void SetState(size_t Index, const JoystickState& State)
+    {
+        States[Index] = State;
+    }
+
+    const JoystickState& GetState(size_t Index) const
+    {
+        return States[Index];
+    }
+
+    /*
+     Hand sample for the next Update(), palm and middle finger in the Character space of that joystick's character
+     */
+    void SetSample(size_t Index, const JoystickSample& Sample)
+    {
+        Samples[Index] = Sample;
+    }
+
+    JoystickOutput GetOutput(size_t Index) const
+    {
+        const JoystickState& State = States[Index];
+        JoystickOutput Output;
+        Output.ForwardMovement = State.ForwardMovement;
+        Output.RightMovement = State.RightMovement;
+        Output.TurnRate = State.TurnRate;
+        Output.IsActivated = State.IsActivated;
+        return Output;
+    }
+
+    /*
+     Advances every joystick by its current sample.  With a pool the joysticks are split into chunks of ChunkSize across its threads.
+     Results are identical to calling VirtualJoystickCore::Evaluate() on each joystick in turn.
+     */
+    void Update(JobThreadPool* Pool = nullptr, size_t ChunkSize = 256)
+    {
+        if (Pool == nullptr) {
+            UpdateRange(0, GetCount());
+        }
+        else {
+            Pool->ParallelFor(GetCount(), ChunkSize, &UpdateRangeJob, this);
+        }
+    }
+
+    /*
+     Advances joysticks [Begin, End).  Different ranges touch disjoint array elements, so ranges can run on different threads.
+     */
+    void UpdateRange(size_t Begin, size_t End)
+    {
+        for (size_t i = Begin; i < End; i++) {
+            VirtualJoystickCore::Evaluate(Tunings[i], States[i], Samples[i]);
+        }
+    }
+
+protected:
+
+    static void UpdateRangeJob(void* Context, size_t Begin, size_t End)
+    {
+        ((VirtualJoystickManager*)Context)->UpdateRange(Begin, End);
+    }
+
+    std::vector<JoystickTuning> Tunings;
+    std::vector<JoystickState> States;
+    std::vector<JoystickSample> Samples;
+};
@@ -0,0 +1,708 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "HandMotionLog.h"
+#include "JoystickCore.h"
+
+#pragma once
+
+/**
+ * Wire format and sender / receiver for replicating a player's joystick output (and optionally the hand pose for avatars) in multiplayer.
+ * Transport independent: the sender builds datagrams into a caller buffer and the receiver takes them as received, every time is passed in
+ * by the caller in microseconds, so the same code runs over UDP, the engine's net driver or a loopback test.
+ *
+ * Packet layout (all integers are LEB128 varints unless noted, signed values zigzag coded as in HandMotionLog):
+ *     u8 'J', u8 version, u8 flags (JoystickReplicationPacketFlags)
+ *     packet sequence, frame count, sequence of the first frame, zigzag timestamp of the first frame
+ *     per frame: (timestamp delta to the previous frame (0 for the first) << 1 | activated), then zigzag deltas of forward, right and turn
+ *                quantized at 1/JOYSTICK_REPLICATION_OUTPUT_SCALE to the previous frame of the packet (the first frame to 0)
+ *     if REPLICATION_PACKET_HAS_POSE: distance from the last frame back to the pose's frame, for a delta pose the distance from the pose's frame back
+ *                to its keyframe, then the HandMotionLog fields (minus timestamp and frame id) as zigzag deltas to the keyframe (to 0 in a keyframe)
+ * Frames have consecutive sequence numbers, so only the first one is sent.  Several input frames are coalesced into each packet and the last
+ * Redundancy already sent frames are repeated, so a lost packet does not lose input.  Delta poses are relative to the last keyframe instead of the
+ * previous pose, so a lost delta does not break the following ones and a lost keyframe only costs poses until the next keyframe.
+ */
+
+static const uint8_t JOYSTICK_REPLICATION_MAGIC = 'J';
+static const uint8_t JOYSTICK_REPLICATION_VERSION = 1;
+static const size_t JOYSTICK_REPLICATION_MAX_PACKET_BYTES = 1200; // stays below common path MTUs
+static const uint32_t JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET = 32;
+static const float JOYSTICK_REPLICATION_OUTPUT_SCALE = 1024.f;
+static const int JOYSTICK_REPLICATION_POSE_FIELD_COUNT = HAND_MOTION_LOG_FIELD_COUNT - 2; // without timestamp and frame id
+
+enum JoystickReplicationPacketFlags
+{
+    REPLICATION_PACKET_HAS_POSE = 1,
+    REPLICATION_PACKET_POSE_KEYFRAME = 2
+};
+
+/*
+ One input frame of one player: the joystick output at the sender's Timestamp (microseconds, sender clock)
+ */
+struct JoystickReplicationFrame
+{
+    uint32_t Sequence;
+    int64_t Timestamp;
+    int32_t ForwardMovement; // quantized, 1/JOYSTICK_REPLICATION_OUTPUT_SCALE units
+    int32_t RightMovement;
+    int32_t TurnRate;
+    bool IsActivated;
+};
+
+struct JoystickReplicationSenderStats
+{
+    uint64_t PacketsSent;
+    uint64_t BytesSent;      // payload only, add the UDP/IP headers for the link rate
+    uint64_t FramesSent;     // including repeats
+    uint64_t FramesSkipped;  // frames that were never sent because more than the sender's ring was pushed between two Poll() calls
+    uint64_t PosesSent;
+    uint64_t PosesDeferred;  // poses left out of a packet by the byte budget or the packet size
+    uint64_t PacketsDeferred; // Poll() calls with a packet due that waited for the byte budget to cover the new frames
+};
+
+struct JoystickReplicationReceiverStats
+{
+    uint64_t PacketsReceived;
+    uint64_t PacketsMalformed;
+    uint64_t FramesReceived;  // new frames, repeats not counted
+    uint64_t FramesRepeated;
+    uint64_t FramesLost;      // sequence gaps between the first and the newest frame never filled
+    uint64_t PosesReceived;
+    uint64_t PosesMissingKeyframe;
+    uint64_t Extrapolations;  // Sample() calls that ran past the newest frame
+};
+
+/*
+ Bounds checked byte writer into a fixed packet buffer, Overflow is set instead of writing past the end
+ */
+struct JoystickReplicationWriter
+{
+    uint8_t* Data;
+    size_t Capacity;
+    size_t Size;
+    bool Overflow;
+
+    JoystickReplicationWriter(uint8_t* Data, size_t Capacity)
+    {
+        this->Data = Data;
+        this->Capacity = Capacity;
+        Size = 0;
+        Overflow = false;
+    }
+
+    void WriteByte(uint8_t Value)
+    {
+        if (Size >= Capacity) {
+            Overflow = true;
+            return;
+        }
+        Data[Size++] = Value;
+    }
+
+    void WriteVarint(uint64_t Value)
+    {
+        while (Value >= 0x80) {
+            WriteByte((uint8_t)(Value | 0x80));
+            Value >>= 7;
+        }
+        WriteByte((uint8_t)Value);
+    }
+
+    void WriteSigned(int64_t Value)
+    {
+        WriteVarint(HandMotionLogCodec::ZigZag(Value));
+    }
+};
+
+/*
+ Non-finite outputs are sent as 0, like HandPoseQuantization does for poses, so a NaN never turns into full movement on the server
+ */
+inline int32_t JoystickReplicationQuantize(float Value)
+{
+    if (!std::isfinite(Value)) {
+        return 0;
+    }
+    float Scaled = Value * JOYSTICK_REPLICATION_OUTPUT_SCALE;
+    Scaled = fminf(fmaxf(Scaled, -1e9f), 1e9f);
+    return (int32_t)lrintf(Scaled);
+}
+
+inline float JoystickReplicationDequantize(int32_t Value)
+{
+    return (float)Value / JOYSTICK_REPLICATION_OUTPUT_SCALE;
+}
+
+/**
+ * Client side: push one frame per input tick with PushFrame() (and the pose with SetPose() when avatars need it), and call Poll() every tick.
+ * Poll() builds a packet every SendIntervalMicros that coalesces all frames pushed since the last packet plus Redundancy repeats.
+ * Every byte sent is charged to a token bucket of MaxBytesPerSecond (with a quarter second burst), so the payload stays within MaxBytesPerSecond
+ * over any stretch of time plus one burst.  When the bucket runs short the repeats go first, then the pose waits for a later packet, and when it
+ * cannot even cover the new frames the packet waits, so more frames are coalesced into the next one.  Nothing is allocated after construction.
+ */
+class JoystickReplicationSender
+{
+public:
+    int64_t SendIntervalMicros;
+    uint32_t Redundancy;
+    float MaxBytesPerSecond;
+    uint32_t PoseKeyframeInterval; // every Nth pose sent is a keyframe
+
+    JoystickReplicationSender()
+    {
+        SendIntervalMicros = 33333; // 30 packets per second
+        Redundancy = 3;
+        MaxBytesPerSecond = 8000.f;
+        PoseKeyframeInterval = 8;
+        NextSequence = 0;
+        SentSequence = 0;
+        PacketSequence = 0;
+        NextSendTime = 0;
+        Tokens = 0.f;
+        LastRefillTime = 0;
+        Started = false;
+        PosePending = false;
+        PoseSequence = 0;
+        HasKeyframe = false;
+        KeyframeSequence = 0;
+        PosesSinceKeyframe = 0;
+        memset(&Stats, 0, sizeof(Stats));
+    }
+
+    /*
+     Appends the joystick output of one input tick, e.g. VirtualJoystickCore::Evaluate()'s result or the VirtualJoystick3D getters
+     */
+    void PushFrame(int64_t Timestamp, const JoystickOutput& Output)
+    {
+        JoystickReplicationFrame& Frame = Frames[NextSequence % FRAME_RING];
+        Frame.Sequence = NextSequence++;
+        Frame.Timestamp = Timestamp;
+        Frame.ForwardMovement = JoystickReplicationQuantize(Output.ForwardMovement);
+        Frame.RightMovement = JoystickReplicationQuantize(Output.RightMovement);
+        Frame.TurnRate = JoystickReplicationQuantize(Output.TurnRate);
+        Frame.IsActivated = Output.IsActivated;
+    }
+
+    /*
+     Hand pose belonging to the last pushed frame, e.g. from LeapInputReader::GetHandPose() through HandPoseQuantization.  Only the latest pose is
+     kept, it goes out with the next packet the budget allows.
+     */
+    void SetPose(const QuantizedHandFrameRecord& Pose)
+    {
+        if (NextSequence == 0) {
+            return;
+        }
+        HandMotionLogCodec::ToFields(Pose, PoseFields);
+        PoseSequence = NextSequence - 1;
+        PosePending = true;
+    }
+
+    /*
+     Builds the next packet into Packet (JOYSTICK_REPLICATION_MAX_PACKET_BYTES) if one is due at NowMicros and there are new frames.
+     Returns the packet size, 0 when there is nothing to send.  A packet is also due before the interval is up once a full packet of new frames
+     (JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET) is pending, and while more than that is pending every call returns another packet, so call it
+     until it returns 0.  Frames are only skipped if more than the sender's ring (64 frames) piles up, either because Poll() was not called or because
+     MaxBytesPerSecond cannot carry the frames even fully coalesced.
+     */
+    size_t Poll(int64_t NowMicros, uint8_t* Packet)
+    {
+        if (!Started) {
+            Started = true;
+            NextSendTime = NowMicros;
+            LastRefillTime = NowMicros;
+            Tokens = GetBurstBytes();
+        }
+        Tokens = fminf(Tokens + (float)(NowMicros - LastRefillTime) * MaxBytesPerSecond * 1e-6f, GetBurstBytes());
+        LastRefillTime = NowMicros;
+        uint32_t Pending = NextSequence - SentSequence;
+        if (Pending == 0 || (NowMicros < NextSendTime && Pending < JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET)) {
+            return 0;
+        }
+        if (Pending > FRAME_RING) {
+            // the oldest pending frames were already overwritten in the ring
+            Stats.FramesSkipped += Pending - FRAME_RING;
+            SentSequence = NextSequence - FRAME_RING;
+            Pending = FRAME_RING;
+        }
+        uint32_t NewFrames = Pending < JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET ? Pending : JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET;
+        uint32_t EndSequence = SentSequence + NewFrames;
+        // the bucket always refills to at least one full packet, so the frames go out once enough budget has accrued
+        size_t NewFramesSize = WriteFrames(Packet, EndSequence, NewFrames);
+        if ((float)NewFramesSize > Tokens) {
+            Stats.PacketsDeferred++;
+            return 0;
+        }
+        if (EndSequence != NextSequence) {
+            NextSendTime = NowMicros; // the rest goes out with the next call
+        }
+        else if (NowMicros < NextSendTime) {
+            NextSendTime = NowMicros + SendIntervalMicros; // sent early because a packet filled up
+        }
+        else {
+            // keep the cadence, but do not try to catch up after a long stall
+            NextSendTime = NowMicros - NextSendTime > SendIntervalMicros ? NowMicros + SendIntervalMicros : NextSendTime + SendIntervalMicros;
+        }
+
+        uint32_t FrameCount = NewFrames + Redundancy;
+        FrameCount = FrameCount < EndSequence ? FrameCount : EndSequence;
+        FrameCount = FrameCount < JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET ? FrameCount : JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET;
+
+        size_t Size = NewFramesSize;
+        if (FrameCount > NewFrames) {
+            Size = WriteFrames(Packet, EndSequence, FrameCount);
+            if ((float)Size > Tokens) {
+                FrameCount = NewFrames;
+                Size = WriteFrames(Packet, EndSequence, FrameCount);
+            }
+        }
+        // the pose belongs to the last pushed frame, it rides on the packet that carries that frame
+        if (PosePending && EndSequence == NextSequence) {
+            bool Keyframe = !HasKeyframe || PosesSinceKeyframe + 1 >= PoseKeyframeInterval || NextSequence - KeyframeSequence > FRAME_RING;
+            size_t PoseSize = WritePose(Packet, Size, Keyframe);
+            if (PoseSize > 0 && (float)PoseSize <= Tokens) {
+                Size = PoseSize;
+                Packet[2] = (uint8_t)(REPLICATION_PACKET_HAS_POSE | (Keyframe ? REPLICATION_PACKET_POSE_KEYFRAME : 0));
+                PosePending = false;
+                Stats.PosesSent++;
+                if (Keyframe) {
+                    memcpy(KeyframeFields, PoseFields, sizeof(KeyframeFields));
+                    KeyframeSequence = PoseSequence;
+                    HasKeyframe = true;
+                    PosesSinceKeyframe = 0;
+                }
+                else {
+                    PosesSinceKeyframe++;
+                }
+            }
+            else {
+                Stats.PosesDeferred++;
+            }
+        }
+
+        Tokens -= (float)Size;
+        SentSequence = EndSequence;
+        PacketSequence++;
+        Stats.PacketsSent++;
+        Stats.BytesSent += Size;
+        Stats.FramesSent += FrameCount;
+        return Size;
+    }
+
+    const JoystickReplicationSenderStats& GetStats() const
+    {
+        return Stats;
+    }
+
+    /*
+     Largest amount of bytes the bucket holds, BytesSent stays within MaxBytesPerSecond * seconds plus this
+     */
+    float GetBurstBytes() const
+    {
+        // a quarter second of budget, and always enough for one full packet
+        return fmaxf(MaxBytesPerSecond * 0.25f, (float)JOYSTICK_REPLICATION_MAX_PACKET_BYTES);
+    }
+
+protected:
+    static const uint32_t FRAME_RING = 64; // at least JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET
+
+    /*
+     Header and the FrameCount frames before EndSequence, returns the size
+     */
+    size_t WriteFrames(uint8_t* Packet, uint32_t EndSequence, uint32_t FrameCount)
+    {
+        JoystickReplicationWriter Writer(Packet, JOYSTICK_REPLICATION_MAX_PACKET_BYTES);
+        Writer.WriteByte(JOYSTICK_REPLICATION_MAGIC);
+        Writer.WriteByte(JOYSTICK_REPLICATION_VERSION);
+        Writer.WriteByte(0); // flags, set once the pose is in
+        Writer.WriteVarint(PacketSequence);
+        Writer.WriteVarint(FrameCount);
+        uint32_t FirstSequence = EndSequence - FrameCount;
+        Writer.WriteVarint(FirstSequence);
+        JoystickReplicationFrame Previous = Frames[FirstSequence % FRAME_RING];
+        Writer.WriteSigned(Previous.Timestamp);
+        Previous.ForwardMovement = 0;
+        Previous.RightMovement = 0;
+        Previous.TurnRate = 0;
+        for (uint32_t Sequence = FirstSequence; Sequence != EndSequence; Sequence++) {
+            const JoystickReplicationFrame& Frame = Frames[Sequence % FRAME_RING];
+            uint64_t TimestampDelta = Frame.Timestamp > Previous.Timestamp ? (uint64_t)(Frame.Timestamp - Previous.Timestamp) : 0;
+            Writer.WriteVarint(TimestampDelta << 1 | (Frame.IsActivated ? 1 : 0));
+            Writer.WriteSigned((int64_t)Frame.ForwardMovement - Previous.ForwardMovement);
+            Writer.WriteSigned((int64_t)Frame.RightMovement - Previous.RightMovement);
+            Writer.WriteSigned((int64_t)Frame.TurnRate - Previous.TurnRate);
+            int64_t Timestamp = Previous.Timestamp + (int64_t)TimestampDelta; // what the receiver decodes, timestamps never go backwards
+            Previous = Frame;
+            Previous.Timestamp = Timestamp;
+        }
+        return Writer.Size;
+    }
+
+    /*
+     Appends the pending pose after the FramesSize bytes of frames, the caller sets the pose flags.  Returns the new size, 0 if it does not fit.
+     */
+    size_t WritePose(uint8_t* Packet, size_t FramesSize, bool Keyframe)
+    {
+        JoystickReplicationWriter Writer(Packet, JOYSTICK_REPLICATION_MAX_PACKET_BYTES);
+        Writer.Size = FramesSize;
+        Writer.WriteVarint(NextSequence - 1 - PoseSequence);
+        if (!Keyframe) {
+            Writer.WriteVarint(PoseSequence - KeyframeSequence);
+        }
+        for (int Field = 0; Field < JOYSTICK_REPLICATION_POSE_FIELD_COUNT; Field++) {
+            int64_t Base = Keyframe ? 0 : KeyframeFields[Field + 2];
+            Writer.WriteSigned(PoseFields[Field + 2] - Base);
+        }
+        return Writer.Overflow ? 0 : Writer.Size;
+    }
+
+    JoystickReplicationFrame Frames[FRAME_RING];
+    uint32_t NextSequence; // of the next pushed frame
+    uint32_t SentSequence; // frames before this one have been sent at least once
+    uint32_t PacketSequence;
+    int64_t NextSendTime;
+    float Tokens;
+    int64_t LastRefillTime;
+    bool Started;
+
+    int64_t PoseFields[HAND_MOTION_LOG_FIELD_COUNT];
+    bool PosePending;
+    uint32_t PoseSequence;
+    int64_t KeyframeFields[HAND_MOTION_LOG_FIELD_COUNT];
+    bool HasKeyframe;
+    uint32_t KeyframeSequence;
+    uint32_t PosesSinceKeyframe;
+
+    JoystickReplicationSenderStats Stats;
+};
+
+/*
+ What the receiver plays out at one local time
+ */
+struct JoystickReplicationSample
+{
+    bool Valid;        // false until the first frame arrived
+    bool Extrapolated; // the playout time was past the newest frame
+    float ForwardMovement;
+    float RightMovement;
+    float TurnRate;
+    bool IsActivated;
+};
+
+/**
+ * Server side, one per player: feed every datagram to Receive() and read the joystick output for the current tick with Sample().
+ * Frames go into a jitter buffer indexed by sequence number.  Sample() plays out PlayoutDelayMicros behind the newest sender time (the sender clock
+ * is mapped to the local one from the smallest observed transit time), interpolating between the two frames around the playout time and
+ * extrapolating from the last two frames for at most MaxExtrapolationMicros when the next frame is late.  Activation changes are never blended.
+ */
+class JoystickReplicationReceiver
+{
+public:
+    int64_t PlayoutDelayMicros;
+    int64_t MaxExtrapolationMicros;
+
+    JoystickReplicationReceiver()
+    {
+        PlayoutDelayMicros = 50000;
+        MaxExtrapolationMicros = 50000;
+        for (uint32_t i = 0; i < FRAME_RING; i++) {
+            Received[i] = false;
+        }
+        HasFrames = false;
+        FirstSequence = 0;
+        NewestSequence = 0;
+        ClockOffset = 0;
+        HasKeyframe = false;
+        KeyframeSequence = 0;
+        HasPose = false;
+        PoseSequence = 0;
+        memset(&Stats, 0, sizeof(Stats));
+    }
+
+    /*
+     Decodes one packet received at NowMicros (local clock).  Returns false for a malformed packet, which is dropped.
+     */
+    bool Receive(const uint8_t* Packet, size_t Size, int64_t NowMicros)
+    {
+        Stats.PacketsReceived++;
+        if (Size < 3 || Packet[0] != JOYSTICK_REPLICATION_MAGIC || Packet[1] != JOYSTICK_REPLICATION_VERSION) {
+            Stats.PacketsMalformed++;
+            return false;
+        }
+        uint8_t Flags = Packet[2];
+        size_t Position = 3;
+        uint64_t PacketSequence, FrameCount, Sequence, Timestamp;
+        if (!HandMotionLogCodec::ReadVarint(Packet, Size, Position, PacketSequence) || !HandMotionLogCodec::ReadVarint(Packet, Size, Position, FrameCount)
+            || !HandMotionLogCodec::ReadVarint(Packet, Size, Position, Sequence) || !HandMotionLogCodec::ReadVarint(Packet, Size, Position, Timestamp)
+            || FrameCount == 0 || FrameCount > JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET) {
+            Stats.PacketsMalformed++;
+            return false;
+        }
+        JoystickReplicationFrame Decoded[JOYSTICK_REPLICATION_MAX_FRAMES_PER_PACKET];
+        JoystickReplicationFrame Previous;
+        Previous.Timestamp = HandMotionLogCodec::UnZigZag(Timestamp);
+        Previous.ForwardMovement = 0;
+        Previous.RightMovement = 0;
+        Previous.TurnRate = 0;
+        for (uint32_t i = 0; i < (uint32_t)FrameCount; i++) {
+            uint64_t Fields[4];
+            for (int Field = 0; Field < 4; Field++) {
+                if (!HandMotionLogCodec::ReadVarint(Packet, Size, Position, Fields[Field])) {
+                    Stats.PacketsMalformed++;
+                    return false;
+                }
+            }
+            JoystickReplicationFrame& Frame = Decoded[i];
+            Frame.Sequence = (uint32_t)Sequence + i;
+            Frame.Timestamp = Previous.Timestamp + (int64_t)(Fields[0] >> 1);
+            Frame.IsActivated = (Fields[0] & 1) != 0;
+            Frame.ForwardMovement = (int32_t)(Previous.ForwardMovement + HandMotionLogCodec::UnZigZag(Fields[1]));
+            Frame.RightMovement = (int32_t)(Previous.RightMovement + HandMotionLogCodec::UnZigZag(Fields[2]));
+            Frame.TurnRate = (int32_t)(Previous.TurnRate + HandMotionLogCodec::UnZigZag(Fields[3]));
+            Previous = Frame;
+        }
+        if ((Flags & REPLICATION_PACKET_HAS_POSE) && !ReadPose(Packet, Size, Position, Flags, Decoded, (uint32_t)FrameCount)) {
+            Stats.PacketsMalformed++;
+            return false;
+        }
+        for (uint32_t i = 0; i < (uint32_t)FrameCount; i++) {
+            Store(Decoded[i], NowMicros);
+        }
+        return true;
+    }
+
+    /*
+     Joystick output to apply at local time NowMicros
+     */
+    JoystickReplicationSample Sample(int64_t NowMicros)
+    {
+        JoystickReplicationSample Result;
+        memset(&Result, 0, sizeof(Result));
+        if (!HasFrames) {
+            return Result;
+        }
+        Result.Valid = true;
+        int64_t PlayoutTime = NowMicros - ClockOffset - PlayoutDelayMicros;
+        // walk back from the newest frame to the last one at or before the playout time, usually only a few frames
+        const JoystickReplicationFrame* Before = nullptr;
+        const JoystickReplicationFrame* After = nullptr;
+        const JoystickReplicationFrame* BeforeBefore = nullptr;
+        uint32_t Oldest = NewestSequence - FirstSequence < FRAME_RING ? FirstSequence : NewestSequence - FRAME_RING + 1;
+        for (uint32_t Sequence = NewestSequence; ; Sequence--) {
+            const JoystickReplicationFrame* Frame = GetFrame(Sequence);
+            if (Frame != nullptr) {
+                if (Before != nullptr) {
+                    BeforeBefore = Frame;
+                    break;
+                }
+                if (Frame->Timestamp <= PlayoutTime) {
+                    Before = Frame;
+                }
+                else {
+                    After = Frame;
+                }
+            }
+            if (Sequence == Oldest) {
+                break;
+            }
+        }
+        if (Before == nullptr) {
+            // playout time is older than everything buffered, hold the oldest frame
+            SetOutput(Result, *After, *After, 0.f);
+        }
+        else if (After != nullptr) {
+            float Blend = (float)(PlayoutTime - Before->Timestamp) / (float)(After->Timestamp - Before->Timestamp);
+            SetOutput(Result, *Before, *After, Before->IsActivated == After->IsActivated ? Blend : 0.f);
+        }
+        else {
+            Result.Extrapolated = PlayoutTime > Before->Timestamp;
+            Stats.Extrapolations += Result.Extrapolated ? 1 : 0;
+            int64_t Ahead = PlayoutTime - Before->Timestamp;
+            Ahead = Ahead < MaxExtrapolationMicros ? Ahead : MaxExtrapolationMicros;
+            if (BeforeBefore != nullptr && BeforeBefore->IsActivated == Before->IsActivated && Before->Timestamp > BeforeBefore->Timestamp) {
+                float Blend = 1.f + (float)Ahead / (float)(Before->Timestamp - BeforeBefore->Timestamp);
+                SetOutput(Result, *BeforeBefore, *Before, Blend);
+            }
+            else {
+                SetOutput(Result, *Before, *Before, 0.f);
+            }
+        }
+        return Result;
+    }
+
+    /*
+     Latest decoded hand pose and the sequence of the frame it belongs to, false until one arrived.  Timestamp is that frame's sender time and
+     FrameId its sequence, not the Leap values (Timestamp is 0 if the frame was not in the pose's packet).
+     */
+    bool GetPose(QuantizedHandFrameRecord& OutPose, uint32_t* OutSequence = nullptr) const
+    {
+        if (!HasPose) {
+            return false;
+        }
+        OutPose = Pose;
+        if (OutSequence != nullptr) {
+            *OutSequence = PoseSequence;
+        }
+        return true;
+    }
+
+    /*
+     Sender time of the newest frame received, 0 before the first one
+     */
+    int64_t GetNewestTimestamp() const
+    {
+        const JoystickReplicationFrame* Newest = HasFrames ? GetFrame(NewestSequence) : nullptr;
+        return Newest != nullptr ? Newest->Timestamp : 0;
+    }
+
+    /*
+     True if the frame with this sequence has been received and is still in the jitter buffer
+     */
+    bool HasFrame(uint32_t Sequence) const
+    {
+        return GetFrame(Sequence) != nullptr;
+    }
+
+    /*
+     Local minus sender clock as estimated from the smallest transit time.  Sample() plays out the sender time NowMicros - GetClockOffset() - PlayoutDelayMicros.
+     */
+    int64_t GetClockOffset() const
+    {
+        return ClockOffset;
+    }
+
+    const JoystickReplicationReceiverStats& GetStats() const
+    {
+        return Stats;
+    }
+
+protected:
+    static const uint32_t FRAME_RING = 128;
+
+    const JoystickReplicationFrame* GetFrame(uint32_t Sequence) const
+    {
+        uint32_t Slot = Sequence % FRAME_RING;
+        return Received[Slot] && Frames[Slot].Sequence == Sequence ? &Frames[Slot] : nullptr;
+    }
+
+    static void SetOutput(JoystickReplicationSample& Result, const JoystickReplicationFrame& From, const JoystickReplicationFrame& To, float Blend)
+    {
+        float FromValues[3] = { JoystickReplicationDequantize(From.ForwardMovement), JoystickReplicationDequantize(From.RightMovement), JoystickReplicationDequantize(From.TurnRate) };
+        float ToValues[3] = { JoystickReplicationDequantize(To.ForwardMovement), JoystickReplicationDequantize(To.RightMovement), JoystickReplicationDequantize(To.TurnRate) };
+        Result.ForwardMovement = FromValues[0] + (ToValues[0] - FromValues[0]) * Blend;
+        Result.RightMovement = FromValues[1] + (ToValues[1] - FromValues[1]) * Blend;
+        Result.TurnRate = FromValues[2] + (ToValues[2] - FromValues[2]) * Blend;
+        Result.IsActivated = Blend < 1.f ? From.IsActivated : To.IsActivated;
+    }
+
+    void Store(const JoystickReplicationFrame& Frame, int64_t NowMicros)
+    {
+        if (HasFrames && (int32_t)(NewestSequence - Frame.Sequence) >= (int32_t)FRAME_RING) {
+            return; // older than the buffer
+        }
+        if (GetFrame(Frame.Sequence) != nullptr) {
+            Stats.FramesRepeated++;
+            return;
+        }
+        uint32_t Slot = Frame.Sequence % FRAME_RING;
+        Frames[Slot] = Frame;
+        Received[Slot] = true;
+        Stats.FramesReceived++;
+        if (!HasFrames) {
+            HasFrames = true;
+            FirstSequence = Frame.Sequence;
+            NewestSequence = Frame.Sequence;
+            ClockOffset = NowMicros - Frame.Timestamp;
+        }
+        if ((int32_t)(Frame.Sequence - NewestSequence) > 0) {
+            NewestSequence = Frame.Sequence;
+        }
+        if ((int32_t)(FirstSequence - Frame.Sequence) > 0) {
+            FirstSequence = Frame.Sequence;
+        }
+        Stats.FramesLost = (uint64_t)(NewestSequence - FirstSequence + 1) - Stats.FramesReceived;
+        // smallest transit time seen, slowly forgotten so clock drift and route changes are followed
+        int64_t Offset = NowMicros - Frame.Timestamp;
+        ClockOffset = Offset < ClockOffset ? Offset : ClockOffset + (Offset - ClockOffset) / 1024;
+    }
+
+    bool ReadPose(const uint8_t* Packet, size_t Size, size_t Position, uint8_t Flags, const JoystickReplicationFrame* Decoded, uint32_t FrameCount)
+    {
+        const JoystickReplicationFrame& LastFrame = Decoded[FrameCount - 1];
+        bool Keyframe = (Flags & REPLICATION_PACKET_POSE_KEYFRAME) != 0;
+        uint64_t Distance, BaseDistance = 0;
+        if (!HandMotionLogCodec::ReadVarint(Packet, Size, Position, Distance) || (!Keyframe && !HandMotionLogCodec::ReadVarint(Packet, Size, Position, BaseDistance))) {
+            return false;
+        }
+        uint32_t Sequence = LastFrame.Sequence - (uint32_t)Distance;
+        if (!Keyframe && (!HasKeyframe || Sequence - (uint32_t)BaseDistance != KeyframeSequence)) {
+            Stats.PosesMissingKeyframe++;
+            return true; // the frames are still good
+        }
+        int64_t Fields[HAND_MOTION_LOG_FIELD_COUNT];
+        for (int Field = 0; Field < JOYSTICK_REPLICATION_POSE_FIELD_COUNT; Field++) {
+            uint64_t Value;
+            if (!HandMotionLogCodec::ReadVarint(Packet, Size, Position, Value)) {
+                return false;
+            }
+            Fields[Field + 2] = HandMotionLogCodec::UnZigZag(Value) + (Keyframe ? 0 : KeyframeFields[Field + 2]);
+        }
+        if (Keyframe) {
+            memcpy(KeyframeFields, Fields, sizeof(KeyframeFields));
+            KeyframeSequence = Sequence;
+            HasKeyframe = true;
+        }
+        if (HasPose && (int32_t)(Sequence - PoseSequence) <= 0) {
+            return true; // a newer pose arrived first
+        }
+        Fields[0] = Distance < FrameCount ? Decoded[FrameCount - 1 - Distance].Timestamp : 0;
+        Fields[1] = Sequence;
+        HandMotionLogCodec::FromFields(Fields, Pose);
+        PoseSequence = Sequence;
+        HasPose = true;
+        Stats.PosesReceived++;
+        return true;
+    }
+
+    JoystickReplicationFrame Frames[FRAME_RING];
+    bool Received[FRAME_RING];
+    bool HasFrames;
+    uint32_t FirstSequence;
+    uint32_t NewestSequence;
+    int64_t ClockOffset; // local time minus sender time, smallest transit seen
+
+    int64_t KeyframeFields[HAND_MOTION_LOG_FIELD_COUNT];
+    bool HasKeyframe;
+    uint32_t KeyframeSequence;
+    QuantizedHandFrameRecord Pose;
+    bool HasPose;
+    uint32_t PoseSequence;
+
+    JoystickReplicationReceiverStats Stats;
+};
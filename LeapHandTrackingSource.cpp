@@ -0,0 +1,113 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include "OculusARPOC.h"
+#include "LeapHandTrackingSource.h"
+
+LeapHandTrackingSource::LeapHandTrackingSource(Leap::Controller* Controller)
+{
+    this->Controller = Controller;
+    HasCapturedFrame = false;
+    memset(&CurrentFrame, 0, sizeof(CurrentFrame));
+}
+
+LeapHandTrackingSource::~LeapHandTrackingSource()
+{
+}
+
+const HandFrameRecord* LeapHandTrackingSource::ReadFrame()
+{
+    Leap::Frame Frame = Controller->frame();
+    // The game usually ticks faster than the Leap tracks, in that case the same frame comes back and the last capture can be reused as is
+    if (HasCapturedFrame && Frame.id() == CurrentFrame.FrameId) {
+        return &CurrentFrame;
+    }
+    CaptureLeapFrame(Frame, CurrentFrame);
+    HasCapturedFrame = true;
+    return &CurrentFrame;
+}
+
+int64_t LeapHandTrackingSource::GetTrackerTimeMicros()
+{
+    return Controller->now();
+}
+
+void LeapHandTrackingSource::CopyPosition(const Leap::Vector& Position, float* OutPosition)
+{
+    OutPosition[0] = Position.x;
+    OutPosition[1] = Position.y;
+    OutPosition[2] = Position.z;
+}
+
+void LeapHandTrackingSource::CopyBoneOrientation(const Leap::Matrix& Basis, float* OutQuaternion)
+{
+    // X is rebuilt from Y and Z, which also turns the left-handed basis Leap uses for left hands into a rotation
+    float YAxis[3];
+    float ZAxis[3];
+    CopyPosition(Basis.yBasis, YAxis);
+    CopyPosition(Basis.zBasis, ZAxis);
+    HandQuaternionFromAxes(YAxis, ZAxis, OutQuaternion);
+}
+
+// NOTE: the full pose of every hand is copied (all joints, bone orientations, palm normal/direction, grab/pinch, confidence); the Leap lists are indexed instead of copying every Hand/Finger out of an iterator
+void LeapHandTrackingSource::CaptureLeapFrame(const Leap::Frame& Frame, HandFrameRecord& OutRecord)
+{
+    OutRecord.Timestamp = Frame.timestamp();
+    OutRecord.FrameId = Frame.id();
+    OutRecord.Hands[HAND_LEFT].Flags = 0;
+    OutRecord.Hands[HAND_RIGHT].Flags = 0;
+    const Leap::HandList Hands = Frame.hands();
+    const int HandCount = Hands.count();
+    for (int HandIndex = 0; HandIndex < HandCount; HandIndex++) {
+        const Leap::Hand Hand = Hands[HandIndex];
+        HandRecord& Record = OutRecord.Hands[Hand.isLeft() ? HAND_LEFT : HAND_RIGHT];
+        Record.Flags = HAND_RECORD_VALID;
+        Record.Confidence = Hand.confidence();
+        Record.GrabStrength = Hand.grabStrength();
+        Record.PinchStrength = Hand.pinchStrength();
+        const Leap::Vector palmPosition = Hand.palmPosition();
+        const Leap::Vector wristPosition = Hand.wristPosition();
+        CopyPosition(palmPosition, Record.Joints[HAND_JOINT_PALM]);
+        CopyPosition(wristPosition, Record.Joints[HAND_JOINT_WRIST]);
+        CopyPosition(Hand.palmNormal(), Record.PalmNormal);
+        CopyPosition(Hand.direction(), Record.PalmDirection);
+        const Leap::FingerList Fingers = Hand.fingers();
+        const int FingerCount = Fingers.count();
+        for (int FingerIndex = 0; FingerIndex < FingerCount; FingerIndex++) {
+            const Leap::Finger finger = Fingers[FingerIndex];
+            const int FingerType = finger.type();
+            // joint N is the start of bone N, the tip comes from tipPosition() as before
+            for (int BoneType = Leap::Bone::TYPE_METACARPAL; BoneType <= Leap::Bone::TYPE_DISTAL; BoneType++) {
+                const Leap::Bone bone = finger.bone((Leap::Bone::Type)BoneType);
+                CopyPosition(bone.prevJoint(), Record.Joints[HandJointIndex(FingerType, BoneType)]);
+                CopyBoneOrientation(bone.basis(), Record.BoneOrientations[HandBoneIndex(FingerType, BoneType)]);
+            }
+            CopyPosition(finger.tipPosition(), Record.Joints[HandJointIndex(FingerType, FINGER_JOINT_TIP)]);
+        }
+    }
+}
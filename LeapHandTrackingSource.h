@@ -0,0 +1,67 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+#include "Leap.h"
+#include "HandTrackingSource.h"
+
+#pragma once
+
+/**
+ * Hand tracking source backed by the Leap SDK.
+ * Steady state does no heap allocation of its own: the capture goes into a member HandFrameRecord, gestures are never requested and nothing is converted to strings.
+ * What the SDK allocates inside frame() and the hand/finger lists is outside our control, and InputPathBenchmark cannot check it since it builds without the SDK.
+ */
+class LeapHandTrackingSource : public IHandTrackingSource
+{
+public:
+    /*
+     The Leap::Controller is initialized outside of this class, since the Leap::Controller should only be initialized once in an application
+     */
+    LeapHandTrackingSource(Leap::Controller* Controller);
+    virtual ~LeapHandTrackingSource();
+    
+    virtual const HandFrameRecord* ReadFrame();
+    
+    /*
+     Leap::Controller::now(), the clock of Leap::Frame::timestamp()
+     */
+    virtual int64_t GetTrackerTimeMicros();
+    
+protected:
+
+    /*
+     Copies the full pose of every hand in a Leap frame (joints, bone orientations, palm normal/direction, grab/pinch, confidence) into a HandFrameRecord
+     */
+    void CaptureLeapFrame(const Leap::Frame& Frame, HandFrameRecord& OutRecord);
+    
+    static void CopyPosition(const Leap::Vector& Position, float* OutPosition);
+    static void CopyBoneOrientation(const Leap::Matrix& Basis, float* OutQuaternion);
+    
+    Leap::Controller* Controller;
+    HandFrameRecord CurrentFrame;
+    bool HasCapturedFrame;
+};
@@ -30,21 +30,78 @@ or implied, of Leonardo Malave.
 #include "Engine.h"
 #include "IHeadMountedDisplay.h"
 #include "LeapInputReader.h"
+#include "LeapHandTrackingSource.h"
+#include "UnrealDebugDrawBackend.h"
 
 LeapInputReader::LeapInputReader(Leap::Controller* Controller, ACharacter* Character)
 {
-    this->Controller = Controller;
+    Initialize(new LeapHandTrackingSource(Controller), Character);
+    OwnedSource = Source;
+}
+
+LeapInputReader::LeapInputReader(IHandTrackingSource* Source, ACharacter* Character)
+{
+    Initialize(Source, Character);
+}
+
+void LeapInputReader::Initialize(IHandTrackingSource* Source, ACharacter* Character)
+{
+    this->Source = Source;
     this->Character = Character;
+    OwnedSource = nullptr;
     LeapDrawSimpleHands = true;
     LeapToUnrealScalingFactor = 0.1;  // Leap Unit is a millimiter and Unreal units are centimeters
     // NOTE: Mount offset is still in Leap coordinates, not Unreal units!!
     LeapMountOffset = FVector(150.f, 0.f, -20.f);
     LeapHandOffset = FVector(10.0, 0.0, 45.0); // note: x=forward, y=right, z=up
     ValidInputLastFrame = false;
+    Recorder = nullptr;
+    MotionLog = nullptr;
+    GestureEngine = nullptr;
+    ConfigStore = nullptr;
+    AppliedConfig = nullptr;
+    DebugDraw = &OwnDebugDraw;
+    FrameArrivalNanoseconds = 0;
+    LastFrameId = -1;
 }
 
 LeapInputReader::~LeapInputReader()
 {
+    delete OwnedSource;
+}
+
+void LeapInputReader::SetRecorder(HandFrameRecorder* Recorder) {
+    this->Recorder = Recorder;
+}
+
+void LeapInputReader::SetMotionLog(HandMotionLogWriter* MotionLog) {
+    this->MotionLog = MotionLog;
+}
+
+void LeapInputReader::SetGestureEngine(HandGestureEngine* GestureEngine) {
+    this->GestureEngine = GestureEngine;
+    AppliedConfig = nullptr; // hand the current snapshot's joystick tuning to the new engine on the next update
+}
+
+void LeapInputReader::SetConfigStore(const JoystickConfigStore* Store) {
+    ConfigStore = Store;
+    AppliedConfig = nullptr;
+}
+
+void LeapInputReader::ApplyConfig(const JoystickConfig& Config) {
+    LeapToUnrealScalingFactor = Config.HandSpace.LeapToUnrealScalingFactor;
+    LeapMountOffset = ToFVector(Config.HandSpace.LeapMountOffset);
+    LeapHandOffset = ToFVector(Config.HandSpace.LeapHandOffset);
+    LeapFilterSettings = Config.Filter;
+    LeapDrawSimpleHands = Config.DrawSimpleHands;
+    if (GestureEngine != nullptr) {
+        GestureEngine->SetTuning(Config.Tuning);
+    }
+    AppliedConfig = &Config;
+}
+
+void LeapInputReader::SetDebugDrawBuffer(DebugDrawBuffer* Buffer) {
+    DebugDraw = Buffer != nullptr ? Buffer : &OwnDebugDraw;
 }
 
 bool LeapInputReader::IsValidInputLastFrame() {
@@ -53,103 +110,160 @@ bool LeapInputReader::IsValidInputLastFrame() {
 
 
 FVector LeapInputReader::GetLeftPalmLocation_WorldSpace() {
-    return LeftPalmLocation_WorldSpace;
+    return ToFVector(Locations.GetPalmLocation_WorldSpace(HAND_LEFT));
 }
 
 FVector LeapInputReader::GetLeftFingerLocation_WorldSpace() {
-    return LeftFingerLocation_WorldSpace;
+    return ToFVector(Locations.GetFingerLocation_WorldSpace(HAND_LEFT));
 }
 
 FVector LeapInputReader::GetRightPalmLocation_WorldSpace() {
-    return RightPalmLocation_WorldSpace;
+    return ToFVector(Locations.GetPalmLocation_WorldSpace(HAND_RIGHT));
 }
 
 FVector LeapInputReader::GetRightFingerLocation_WorldSpace() {
-    return RightFingerLocation_WorldSpace;
+    return ToFVector(Locations.GetFingerLocation_WorldSpace(HAND_RIGHT));
 }
 
 FVector LeapInputReader::GetLeftPalmLocation_CharacterSpace() {
-    return LeftPalmLocation_CharacterSpace;
+    return ToFVector(Locations.GetPalmLocation_CharacterSpace(HAND_LEFT));
 }
 
 FVector LeapInputReader::GetLeftFingerLocation_CharacterSpace() {
-    return LeftFingerLocation_CharacterSpace;
+    return ToFVector(Locations.GetFingerLocation_CharacterSpace(HAND_LEFT));
 }
 
 FVector LeapInputReader::GetRightPalmLocation_CharacterSpace() {
-    return RightPalmLocation_CharacterSpace;
+    return ToFVector(Locations.GetPalmLocation_CharacterSpace(HAND_RIGHT));
 }
 
 FVector LeapInputReader::GetRightFingerLocation_CharacterSpace() {
-    return RightFingerLocation_CharacterSpace;
+    return ToFVector(Locations.GetFingerLocation_CharacterSpace(HAND_RIGHT));
 }
 
 void LeapInputReader::UpdateHandLocations()
 {
-    // First just get hand and finger positions and draw the hands
-    Leap::Frame Frame = Controller->frame();
-    Leap::HandList Hands = Frame.hands();
-    Leap::PointableList Pointables = Frame.pointables();
-    Leap::GestureList gestures = Frame.gestures();
-    FColor handColor = FColor::Magenta;
-    FColor fingertipColor = handColor;
-    
-    UWorld* World = Character->GetWorld();
-   
-    ValidInputLastFrame = false;
-    for (Leap::HandList::const_iterator HandsIter = Hands.begin(); HandsIter != Hands.end(); HandsIter++) {
-        ValidInputLastFrame = true; // for now valid if hands detected.  in future, will check if movement is "natural"
-        Leap::Hand Hand = (Leap::Hand)(*HandsIter);
-        Leap::Vector palmPosition = Hand.palmPosition();
-        FVector palmLocation = LeapPositionToUnrealLocation(palmPosition, LeapHandOffset);
-        if (Hand.isLeft()) {
-            LeftPalmLocation_WorldSpace = palmLocation;
-        }
-        else {
-            RightPalmLocation_WorldSpace = palmLocation;
+    INPUT_TRACE_SCOPE(INPUT_TRACE_UPDATE_HAND_LOCATIONS);
+    // First just get hand and finger positions, and record them if requested
+    const HandFrameRecord* Frame;
+    {
+        INPUT_TRACE_SCOPE(INPUT_TRACE_READ_FRAME);
+        Frame = Source->ReadFrame();
+    }
+    if (Frame == nullptr) {
+        ValidInputLastFrame = false;
+        return;
+    }
+#if VIRTUAL_JOYSTICK_TRACE
+    if (Frame->FrameId != LastFrameId) {
+        FrameArrivalNanoseconds = InputTrace::IsEnabled() ? InputTrace::Now() : 0;
+        LastFrameId = Frame->FrameId;
+        // frame age on the tracker's own clock (Controller::now() - Frame::timestamp() for the Leap), ending at the arrival on the game thread
+        int64_t TrackerTimeMicros = FrameArrivalNanoseconds != 0 ? Source->GetTrackerTimeMicros() : 0;
+        if (TrackerTimeMicros != 0) {
+            int64_t AgeNanoseconds = TrackerTimeMicros > Frame->Timestamp ? (TrackerTimeMicros - Frame->Timestamp) * 1000 : 0;
+            InputTrace::Record(INPUT_TRACE_FRAME_AGE, FrameArrivalNanoseconds - AgeNanoseconds, FrameArrivalNanoseconds);
         }
-        if (LeapDrawSimpleHands) {
-            DrawDebugSphere(World, palmLocation, 1.0, 12, handColor);
+    }
+#endif
+    if (Recorder != nullptr) {
+        Recorder->Write(*Frame);
+    }
+    if (MotionLog != nullptr) {
+        MotionLog->Log(*Frame);
+    }
+    UpdateHandLocationsFromFrame(*Frame);
+}
+
+void LeapInputReader::UpdateHandLocationsFromFrame(const HandFrameRecord& Frame)
+{
+    DebugDrawColor handColor = DebugDrawColor::Make(255, 0, 255); // magenta
+    DebugDrawColor fingertipColor = handColor;
+    
+    // live config: one pointer load per frame, the fields are only rewritten when a new snapshot was published
+    if (ConfigStore != nullptr) {
+        const JoystickConfig* Config = ConfigStore->Get();
+        if (Config != AppliedConfig) {
+            ApplyConfig(*Config);
         }
-        Leap::FingerList Fingers = Hand.fingers();
-        for (Leap::FingerList::const_iterator FingersIter = Fingers.begin(); FingersIter != Fingers.end(); FingersIter++) {
-            Leap::Finger finger = (Leap::Finger)(*FingersIter);
-            Leap::Vector tipPosition = finger.tipPosition();
-            FString fingerPosition(tipPosition.toString().c_str());
-            FVector fingerLocation = LeapPositionToUnrealLocation(tipPosition, LeapHandOffset);
-            if (finger.type() == Leap::Finger::TYPE_MIDDLE) { // only middle finger used for leap input
-                fingertipColor = FColor::Red;
-               if (Hand.isLeft()) {
-                    LeftFingerLocation_WorldSpace = fingerLocation;
-                }
-                else {
-                    RightFingerLocation_WorldSpace = fingerLocation;
-                }
-            }
-            else {
-                fingertipColor = handColor;
+    }
+    
+    // snapshot HMD and Character pose once, then transform every joint of both hands to world and Character space in one pass
+    ValidInputLastFrame = Locations.Update(GetHandSpaceSettings(), GetHandSpacePose(), LeapFilterSettings, Frame);
+   
+#if VIRTUAL_JOYSTICK_DEBUG_DRAW
+    if (LeapDrawSimpleHands) {
+        const HandJointBuffer& Joints = Locations.GetJoints();
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            if (!(Frame.Hands[HandIndex].Flags & HAND_RECORD_VALID)) {
+                continue;
             }
-            if (LeapDrawSimpleHands) {
-                DrawDebugSphere(World, fingerLocation, 0.5, 12, fingertipColor);
-                DrawDebugLine(World, palmLocation, fingerLocation, handColor);
+            JoystickVector palmWorldLocation = Joints.GetWorldLocation(HandIndex, HAND_JOINT_PALM);
+            DebugDraw->AddSphere(palmWorldLocation, 1.0, 12, handColor);
+            for (int FingerIndex = 0; FingerIndex < FINGER_COUNT; FingerIndex++) {
+                JoystickVector fingerLocation = Joints.GetWorldLocation(HandIndex, HandJointIndex(FingerIndex, FINGER_JOINT_TIP));
+                fingertipColor = (FingerIndex == FINGER_MIDDLE) ? DebugDrawColor::Make(255, 0, 0) : handColor;
+                DebugDraw->AddSphere(fingerLocation, 0.5, 12, fingertipColor);
+                DebugDraw->AddLine(palmWorldLocation, fingerLocation, handColor);
             }
         }
     }
-    // end result: get hand/finger locations in Character space
-    FTransform CharacterTransform = Character->GetTransform();
-    LeftPalmLocation_CharacterSpace = CharacterTransform.InverseTransformPosition(LeftPalmLocation_WorldSpace);
-    LeftFingerLocation_CharacterSpace = CharacterTransform.InverseTransformPosition(LeftFingerLocation_WorldSpace);
-    RightPalmLocation_CharacterSpace = CharacterTransform.InverseTransformPosition(RightPalmLocation_WorldSpace);
-    RightFingerLocation_CharacterSpace = CharacterTransform.InverseTransformPosition(RightFingerLocation_WorldSpace);
+#endif
     
+    if (GestureEngine != nullptr) {
+        // the same Character space locations the joystick gets, including the held location of a hand that is not tracked
+        GestureEngine->Update(Frame, Locations.GetPalmLocations_CharacterSpace(), Locations.GetFingerLocations_CharacterSpace());
+    }
+    
+#if VIRTUAL_JOYSTICK_DEBUG_DRAW
+    // a shared buffer is flushed by its owner once per frame
+    if (DebugDraw == &OwnDebugDraw) {
+        UnrealDebugDrawBackend Backend(Character->GetWorld());
+        OwnDebugDraw.Flush(Backend);
+    }
+#endif
+}
+
+FVector LeapInputReader::GetJointLocation_WorldSpace(int Hand, int Joint) {
+    return ToFVector(Locations.GetJoints().GetWorldLocation(Hand, Joint));
+}
+
+FVector LeapInputReader::GetJointLocation_CharacterSpace(int Hand, int Joint) {
+    return ToFVector(Locations.GetJoints().GetCharacterLocation(Hand, Joint));
+}
+
+const HandJointBuffer& LeapInputReader::GetJoints() {
+    return Locations.GetJoints();
+}
+
+const HandRecord& LeapInputReader::GetHandPose(int Hand) {
+    return Locations.GetHandPose(Hand);
+}
+
+int64_t LeapInputReader::GetFrameArrivalNanoseconds() {
+    return FrameArrivalNanoseconds;
 }
 
 // NOTE: because of the different coordinate systems for Leap forward = Y whereas for a character Forward = X
 FVector LeapInputReader::LeapPositionToUnrealLocation(Leap::Vector LeapVector, FVector UnrealOffset) {
     
-    // Adjust for mount offset and also current HMD orientation
-    // NOTE: reverse X and Y because of different coordinate systems
-    FVector LeapVectorCorrected = FVector(LeapVector.y, LeapVector.x, LeapVector.z) + LeapMountOffset;
+    // the actual math lives in HandSpaceTransform so it can also be run headless
+    HandSpaceSettings Settings = GetHandSpaceSettings();
+    Settings.LeapHandOffset = ToJoystickVector(UnrealOffset);
+    float LeapPosition[3] = { LeapVector.x, LeapVector.y, LeapVector.z };
+    return ToFVector(HandSpaceTransform::LeapToWorld(Settings, GetHandSpacePose(), LeapPosition));
+}
+
+HandSpaceSettings LeapInputReader::GetHandSpaceSettings() {
+    HandSpaceSettings Settings;
+    Settings.LeapToUnrealScalingFactor = LeapToUnrealScalingFactor;
+    Settings.LeapMountOffset = ToJoystickVector(LeapMountOffset);
+    Settings.LeapHandOffset = ToJoystickVector(LeapHandOffset);
+    return Settings;
+}
+
+HandSpacePose LeapInputReader::GetHandSpacePose() {
+    HandSpacePose Pose;
     if (GEngine->HMDDevice.IsValid() && GEngine->HMDDevice->IsHeadTrackingAllowed())
     {
         FQuat HMDOrientation;
@@ -157,10 +271,26 @@ FVector LeapInputReader::LeapPositionToUnrealLocation(Leap::Vector LeapVector, F
         
         GEngine->HMDDevice->GetCurrentOrientationAndPosition(HMDOrientation, HMDPosition);
         
-        FRotator HMDRotator = HMDOrientation.Rotator();
-        LeapVectorCorrected = HMDRotator.UnrotateVector(LeapVectorCorrected);  // TODO: adjust for leap rotation not being the same as HMD rotation
+        Pose.HasHMDOrientation = true;
+        Pose.HMDOrientation[0] = HMDOrientation.X;
+        Pose.HMDOrientation[1] = HMDOrientation.Y;
+        Pose.HMDOrientation[2] = HMDOrientation.Z;
+        Pose.HMDOrientation[3] = HMDOrientation.W;
     }
-    FVector ScaledLeapVector = LeapVectorCorrected * LeapToUnrealScalingFactor;
-    FVector UnrealLocation = Character->GetActorLocation() - (Character->GetActorRightVector() * ScaledLeapVector.Y) + (Character->GetActorForwardVector() * (ScaledLeapVector.X + UnrealOffset.X)) - (Character->GetActorUpVector() * (ScaledLeapVector.Z - UnrealOffset.Z));
-    return UnrealLocation;
-}
\ No newline at end of file
+    // one GetTransform() call so location, basis and scale all come from the same transform
+    FTransform CharacterTransform = Character->GetTransform();
+    Pose.ActorLocation = ToJoystickVector(CharacterTransform.GetLocation());
+    Pose.ActorForward = ToJoystickVector(CharacterTransform.GetUnitAxis(EAxis::X));
+    Pose.ActorRight = ToJoystickVector(CharacterTransform.GetUnitAxis(EAxis::Y));
+    Pose.ActorUp = ToJoystickVector(CharacterTransform.GetUnitAxis(EAxis::Z));
+    Pose.ActorScale = ToJoystickVector(CharacterTransform.GetScale3D());
+    return Pose;
+}
+
+JoystickVector LeapInputReader::ToJoystickVector(const FVector& Vector) {
+    return HandSpacePose::MakeVector(Vector.X, Vector.Y, Vector.Z);
+}
+
+FVector LeapInputReader::ToFVector(const JoystickVector& Vector) {
+    return FVector(Vector.X, Vector.Y, Vector.Z);
+}
@@ -26,6 +26,15 @@ authors and should not be interpreted as representing official policies, either
 or implied, of Leonardo Malave.
 ********************************/
 #include "Leap.h"
+#include "HandTrackingSource.h"
+#include "HandSpaceTransform.h"
+#include "HandJointFilter.h"
+#include "HandLocationTracker.h"
+#include "DebugDrawBuffer.h"
+#include "HandMotionLog.h"
+#include "HandGestures.h"
+#include "JoystickConfig.h"
+#include "InputTrace.h"
 
 #pragma once
 
@@ -41,14 +50,58 @@ public:
      -- the Character parameter is so that the position of the Leap hands/fingers can be returned in the coordinate space of the Character.  This makes it easier to calculate the desired movement based on these character-space coordinates.
      */
     LeapInputReader(Leap::Controller* Controller,  ACharacter* Character);
+    
+    /*
+     Same as above but reads hand frames from any IHandTrackingSource (e.g. ReplayHandTrackingSource or SyntheticHandTrackingSource) instead of the Leap::Controller.
+     The source is not owned by this class.
+     */
+    LeapInputReader(IHandTrackingSource* Source, ACharacter* Character);
 	~LeapInputReader();
     
     /*
      As the method name implies, this method calculates the location coordinates in world space of the Leap hand and finger coordinates.  Note that for now this assumes a scaling factor of 0.1, since Leap coordinates are always in millimeters and the default Unreal world scale is 1 Unreal Unit = 1 centimeter.  
      Note that the intention is that this method should be called first, and then the values retrieved through the available Getter methods. 
+     If the hand tracking source has no frame (e.g. a replay that reached the end) the locations are left unchanged and IsValidInputLastFrame() returns false.
      */
     void UpdateHandLocations();
     
+    /*
+     Same as UpdateHandLocations() but takes the hand data from an already captured frame instead of the hand tracking source, e.g. a frame from a HandFrameReplay.
+     */
+    void UpdateHandLocationsFromFrame(const HandFrameRecord& Frame);
+    
+    /*
+     If a recorder is set, every frame read from the hand tracking source is also appended to it.  Pass nullptr to stop recording.  The recorder is not owned by this class.
+     */
+    void SetRecorder(HandFrameRecorder* Recorder);
+    
+    /*
+     If a motion log is set, every frame read from the hand tracking source is also queued to it for compression on its background thread.
+     Unlike the recorder this never does file I/O on the calling thread.  Pass nullptr to stop logging.  The log is not owned by this class.
+     */
+    void SetMotionLog(HandMotionLogWriter* MotionLog);
+    
+    /*
+     If a gesture engine is set, it is advanced at the end of every UpdateHandLocations() with the Character space palm and finger locations and the
+     grab/pinch strengths of both hands, so its events are ready for the caller right after.  Pass nullptr to stop.  The engine is not owned by this class.
+     With a config store the engine also gets the joystick tuning of every new snapshot, otherwise call HandGestureEngine::SetTuning() yourself.
+     */
+    void SetGestureEngine(HandGestureEngine* GestureEngine);
+    
+    /*
+     Takes LeapToUnrealScalingFactor, the mount and hand offsets, the filter settings and LeapDrawSimpleHands from the store's current snapshot
+     (e.g. kept up to date by a JoystickConfigWatcher).  Every UpdateHandLocations() does one pointer load and copies the snapshot into the public
+     fields only when it changed.  Pass nullptr to stop following the store.  The store is not owned by this class.
+     */
+    void SetConfigStore(const JoystickConfigStore* Store);
+    
+    /*
+     By default the simple hands are recorded into a buffer owned by this class and drawn at the end of every UpdateHandLocations().
+     Pass a shared buffer (e.g. the same one given to VirtualJoystick3D) to only record into it and flush it yourself once per frame, or nullptr to go back to the default.
+     The buffer is not owned by this class.
+     */
+    void SetDebugDrawBuffer(DebugDrawBuffer* Buffer);
+    
     FVector GetLeftPalmLocation_WorldSpace();
     FVector GetLeftFingerLocation_WorldSpace();
     FVector GetRightPalmLocation_WorldSpace();
@@ -59,6 +112,30 @@ public:
     FVector GetRightFingerLocation_CharacterSpace();
     bool IsValidInputLastFrame();
     
+    /*
+     Location of any tracked joint, Hand is a HandSide and Joint a HandJoint / HandJointIndex() (e.g. HandJointIndex(FINGER_INDEX, FINGER_JOINT_TIP)).
+     Joints of a hand that is not tracked keep the Leap position of the last frame it was tracked in.
+     */
+    FVector GetJointLocation_WorldSpace(int Hand, int Joint);
+    FVector GetJointLocation_CharacterSpace(int Hand, int Joint);
+    
+    /*
+     All joints of both hands in Leap, world and Character space, as filled in by the last UpdateHandLocations()
+     */
+    const HandJointBuffer& GetJoints();
+    
+    /*
+     Full pose (joints, bone orientations, palm normal/direction, grab/pinch strength, confidence) of the hand from the last frame it was tracked in, in raw Leap coordinates.
+     Flags has HAND_RECORD_VALID only if the hand was tracked in the last UpdateHandLocations().  Use HandPoseQuantization to get the compact form for recording or replication.
+     */
+    const HandRecord& GetHandPose(int Hand);
+    
+    /*
+     InputTrace::Now() time at which UpdateHandLocations() first saw the current hand frame, 0 if tracing is disabled.
+     After applying the movement, the game can trace the motion-to-control latency with INPUT_TRACE_SINCE(INPUT_TRACE_MOTION_TO_CONTROL, Reader->GetFrameArrivalNanoseconds()).
+     */
+    int64_t GetFrameArrivalNanoseconds();
+    
     
     /*
      If true - draws minimalist hands just connecting the palm location to the fingertips
@@ -82,25 +159,59 @@ public:
      */
     FVector LeapHandOffset;
     
+    /*
+     Optional One Euro filtering and prediction of all joints, to cut tracker jitter before it reaches the joystick.  Disabled by default.
+     */
+    HandFilterSettings LeapFilterSettings;
+    
     
 protected:
 
     /*
      Translates the Leap coordinates to Unreal location coordinates. 
+     NOTE: this queries the HMD and Character pose on every call, UpdateHandLocations() uses a HandSpaceFrameTransform built once per frame instead.
      */
     FVector LeapPositionToUnrealLocation(Leap::Vector LeapVector, FVector UnrealOffset);
     
+    /*
+     Current HMD orientation and Character location/basis, in the engine-independent form used by HandSpaceTransform.
+     UpdateHandLocations() takes this snapshot once per frame.
+     */
+    HandSpacePose GetHandSpacePose();
+    
+    /*
+     LeapToUnrealScalingFactor, LeapMountOffset and LeapHandOffset in the engine-independent form used by HandSpaceTransform
+     */
+    HandSpaceSettings GetHandSpaceSettings();
+    
+    static JoystickVector ToJoystickVector(const FVector& Vector);
+    static FVector ToFVector(const JoystickVector& Vector);
+    
+    /*
+     Copies the reader settings of a config snapshot into the public fields
+     */
+    void ApplyConfig(const JoystickConfig& Config);
+    
+    void Initialize(IHandTrackingSource* Source, ACharacter* Character);
+    
     ACharacter* Character;
-    Leap::Controller* Controller;
+    IHandTrackingSource* Source;
+    IHandTrackingSource* OwnedSource; // only set when this class created the source itself
+    HandFrameRecorder* Recorder;
+    HandMotionLogWriter* MotionLog;
+    HandGestureEngine* GestureEngine;
+    const JoystickConfigStore* ConfigStore;
+    const JoystickConfig* AppliedConfig; // snapshot last copied into the fields
+    HandLocationTracker Locations; // the per-frame transform and hand locations, shared with the headless tools
+    int64_t FrameArrivalNanoseconds;
+    int64_t LastFrameId;
+    DebugDrawBuffer OwnDebugDraw;
+    DebugDrawBuffer* DebugDraw; // either &OwnDebugDraw or a shared buffer flushed by the caller
 
     bool ValidInputLastFrame;
-    FVector LeftPalmLocation_WorldSpace;
-    FVector LeftFingerLocation_WorldSpace;
-    FVector RightPalmLocation_WorldSpace;
-    FVector RightFingerLocation_WorldSpace;
-    FVector LeftPalmLocation_CharacterSpace;
-    FVector LeftFingerLocation_CharacterSpace;
-    FVector RightPalmLocation_CharacterSpace;
-    FVector RightFingerLocation_CharacterSpace;
 
+private:
+    // copying would delete OwnedSource twice
+    LeapInputReader(const LeapInputReader&);
+    LeapInputReader& operator=(const LeapInputReader&);
 };
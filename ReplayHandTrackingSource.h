@@ -0,0 +1,77 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include "HandTrackingSource.h"
+
+#pragma once
+
+/**
+ * Hand tracking source that plays back a memory-mapped capture file.  Frames are returned as pointers into the mapping, so there is no copying.
+ * Playback is frame by frame (one recorded frame per ReadFrame() call) rather than in real time, which is what offline runs want.
+ */
+class ReplayHandTrackingSource : public IHandTrackingSource
+{
+public:
+    /*
+     The replay is not owned by this class and must stay open while the source is used.
+     If Loop is true playback wraps around at the end instead of returning nullptr.
+     */
+    ReplayHandTrackingSource(const HandFrameReplay* Replay, bool Loop = false)
+    {
+        this->Replay = Replay;
+        this->Loop = Loop;
+        NextFrameIndex = 0;
+    }
+
+    virtual const HandFrameRecord* ReadFrame()
+    {
+        uint64_t FrameCount = Replay->GetFrameCount();
+        if (NextFrameIndex >= FrameCount) {
+            if (!Loop || FrameCount == 0) {
+                return nullptr;
+            }
+            NextFrameIndex = 0;
+        }
+        return Replay->GetFrame(NextFrameIndex++);
+    }
+
+    void Seek(uint64_t FrameIndex)
+    {
+        NextFrameIndex = FrameIndex;
+    }
+
+    uint64_t GetNextFrameIndex() const
+    {
+        return NextFrameIndex;
+    }
+
+protected:
+    const HandFrameReplay* Replay;
+    bool Loop;
+    uint64_t NextFrameIndex;
+};
@@ -0,0 +1,268 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cmath>
+
+#pragma once
+
+/**
+ * Response curves for the joystick: map a normalized input (how far past the dead zone the hand is, 0..1) to a normalized output.
+ * The built-in curves are compile-time specializations (PowerCurve), and arbitrary curves defined by data are baked into a fixed-size lookup table
+ * (ResponseCurve), so evaluating any curve costs the same handful of instructions.
+ */
+
+/*
+ x^(Numerator/Denominator) for x >= 0.  The common exponents are specialized to plain multiplies/square roots, anything else falls back to pow().
+ */
+template <int Numerator, int Denominator>
+struct PowerCurve
+{
+    static float Evaluate(float X)
+    {
+        return (float)pow(X, (double)Numerator / Denominator);
+    }
+};
+
+template <>
+struct PowerCurve<1, 1>
+{
+    static float Evaluate(float X)
+    {
+        return X;
+    }
+};
+
+template <>
+struct PowerCurve<2, 1>
+{
+    static float Evaluate(float X)
+    {
+        return X * X;
+    }
+};
+
+template <>
+struct PowerCurve<3, 1>
+{
+    static float Evaluate(float X)
+    {
+        return X * X * X;
+    }
+};
+
+template <>
+struct PowerCurve<1, 2>
+{
+    static float Evaluate(float X)
+    {
+        return sqrtf(X);
+    }
+};
+
+template <>
+struct PowerCurve<3, 2>
+{
+    static float Evaluate(float X)
+    {
+        return X * sqrtf(X);
+    }
+};
+
+struct ResponseCurvePoint
+{
+    float Input;
+    float Output;
+};
+
+static const int RESPONSE_CURVE_TABLE_SIZE = 256; // segments, the table has one more entry than this
+
+/**
+ * Curve baked into a fixed-size lookup table over [0, MaxInput], evaluated with one multiply, one table lookup and a linear interpolation.
+ * Inputs past MaxInput hold the last value.  The table lives inside the object, so re-baking never allocates; to swap curves while the joystick is running,
+ * bake into a second ResponseCurve and point the tuning at it.
+ */
+class ResponseCurve
+{
+public:
+    ResponseCurve()
+    {
+        BakePower(1.f, 1.f);
+    }
+
+    float Evaluate(float X) const
+    {
+        float Position = X * InputToTable;
+        if (!(Position > 0.f)) {
+            return Table[0];
+        }
+        if (Position >= (float)RESPONSE_CURVE_TABLE_SIZE) {
+            return Table[RESPONSE_CURVE_TABLE_SIZE];
+        }
+        int Index = (int)Position;
+        float Fraction = Position - (float)Index;
+        return Table[Index] + (Table[Index + 1] - Table[Index]) * Fraction;
+    }
+
+    /*
+     x^Exponent over [0, MaxInput]
+     */
+    void BakePower(float Exponent, float MaxInput)
+    {
+        SetMaxInput(MaxInput);
+        for (int i = 0; i <= RESPONSE_CURVE_TABLE_SIZE; i++) {
+            Table[i] = (float)pow(TableInput(i), (double)Exponent);
+        }
+    }
+
+    /*
+     Straight lines between the points.  Points must be sorted by Input, MaxInput becomes the Input of the last point.  Returns false (leaving the curve unchanged) if there are fewer than 2 points or they are not sorted.
+     */
+    bool BakeLinear(const ResponseCurvePoint* Points, int Count)
+    {
+        if (!CheckPoints(Points, Count)) {
+            return false;
+        }
+        SetMaxInput(Points[Count - 1].Input);
+        int Segment = 0;
+        for (int i = 0; i <= RESPONSE_CURVE_TABLE_SIZE; i++) {
+            float X = TableInput(i);
+            Segment = FindSegment(Points, Count, X, Segment);
+            const ResponseCurvePoint& Start = Points[Segment];
+            const ResponseCurvePoint& End = Points[Segment + 1];
+            float T = Clamp01((X - Start.Input) / (End.Input - Start.Input));
+            Table[i] = Start.Output + (End.Output - Start.Output) * T;
+        }
+        return true;
+    }
+
+    /*
+     Smooth monotone cubic (Fritsch-Carlson) through the points, so the curve never overshoots between control points, which matters for a speed curve.
+     Same requirements on the points as BakeLinear(), at most MAX_SPLINE_POINTS points.
+     */
+    bool BakeSpline(const ResponseCurvePoint* Points, int Count)
+    {
+        if (!CheckPoints(Points, Count) || Count > MAX_SPLINE_POINTS) {
+            return false;
+        }
+        // secant slopes, then tangents limited so each segment stays monotone
+        float Secants[MAX_SPLINE_POINTS];
+        float Tangents[MAX_SPLINE_POINTS];
+        for (int i = 0; i < Count - 1; i++) {
+            Secants[i] = (Points[i + 1].Output - Points[i].Output) / (Points[i + 1].Input - Points[i].Input);
+        }
+        Tangents[0] = Secants[0];
+        Tangents[Count - 1] = Secants[Count - 2];
+        for (int i = 1; i < Count - 1; i++) {
+            Tangents[i] = (Secants[i - 1] * Secants[i] <= 0.f) ? 0.f : (Secants[i - 1] + Secants[i]) * 0.5f;
+        }
+        for (int i = 0; i < Count - 1; i++) {
+            if (Secants[i] == 0.f) {
+                Tangents[i] = 0.f;
+                Tangents[i + 1] = 0.f;
+                continue;
+            }
+            float A = Tangents[i] / Secants[i];
+            float B = Tangents[i + 1] / Secants[i];
+            float Length = A * A + B * B;
+            if (Length > 9.f) {
+                float Scale = 3.f / sqrtf(Length);
+                Tangents[i] = Scale * A * Secants[i];
+                Tangents[i + 1] = Scale * B * Secants[i];
+            }
+        }
+        SetMaxInput(Points[Count - 1].Input);
+        int Segment = 0;
+        for (int i = 0; i <= RESPONSE_CURVE_TABLE_SIZE; i++) {
+            float X = TableInput(i);
+            Segment = FindSegment(Points, Count, X, Segment);
+            const ResponseCurvePoint& Start = Points[Segment];
+            const ResponseCurvePoint& End = Points[Segment + 1];
+            float Width = End.Input - Start.Input;
+            float T = Clamp01((X - Start.Input) / Width);
+            // cubic Hermite basis
+            float T2 = T * T;
+            float T3 = T2 * T;
+            Table[i] = (2.f * T3 - 3.f * T2 + 1.f) * Start.Output + (T3 - 2.f * T2 + T) * Width * Tangents[Segment]
+                + (-2.f * T3 + 3.f * T2) * End.Output + (T3 - T2) * Width * Tangents[Segment + 1];
+        }
+        return true;
+    }
+
+    float GetMaxInput() const
+    {
+        return MaxInput;
+    }
+
+    static const int MAX_SPLINE_POINTS = 32;
+
+protected:
+
+    void SetMaxInput(float NewMaxInput)
+    {
+        MaxInput = NewMaxInput > 0.f ? NewMaxInput : 1.f;
+        InputToTable = RESPONSE_CURVE_TABLE_SIZE / MaxInput;
+    }
+
+    float TableInput(int Index) const
+    {
+        return MaxInput * Index / RESPONSE_CURVE_TABLE_SIZE;
+    }
+
+    static bool CheckPoints(const ResponseCurvePoint* Points, int Count)
+    {
+        if (Points == nullptr || Count < 2) {
+            return false;
+        }
+        for (int i = 1; i < Count; i++) {
+            if (!(Points[i].Input > Points[i - 1].Input)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     Segment containing X, searching forward from the previous one since the table is filled in increasing order.  Inputs before the first point use the first segment.
+     */
+    static int FindSegment(const ResponseCurvePoint* Points, int Count, float X, int Segment)
+    {
+        while (Segment < Count - 2 && X > Points[Segment + 1].Input) {
+            Segment++;
+        }
+        return Segment;
+    }
+
+    static float Clamp01(float Value)
+    {
+        return Value < 0.f ? 0.f : (Value > 1.f ? 1.f : Value);
+    }
+
+    float Table[RESPONSE_CURVE_TABLE_SIZE + 1];
+    float MaxInput;
+    float InputToTable;
+};
@@ -0,0 +1,205 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <cmath>
+#include <cstring>
+#include "HandTrackingSource.h"
+
+#pragma once
+
+enum SyntheticMotionType
+{
+    SYNTHETIC_STATIC = 0, // hands held still at the center
+    SYNTHETIC_SWEEP = 1,  // palm moves back and forth in a straight line between Center - Amplitude and Center + Amplitude
+    SYNTHETIC_CIRCLE = 2  // palm moves around a circle of radius Amplitude[0] in the horizontal (Leap X/Y) plane
+};
+
+/*
+ Parameters for one synthetic hand.  Positions are in Leap coordinates (millimeters), the defaults put the left hand over the default activation disk of VirtualJoystick3D
+ with the middle finger raised through the disk plane, so the joystick activates.
+ */
+struct SyntheticHandMotion
+{
+    bool Enabled;
+    SyntheticMotionType Motion;
+    float Center[3];
+    float Amplitude[3];
+    float FingertipOffsets[FINGER_COUNT][3]; // relative to the palm
+    uint32_t PeriodFrames; // frames per sweep or per revolution
+    float Jitter; // +/- millimeters of uniform noise added to every coordinate
+
+    SyntheticHandMotion()
+    {
+        Enabled = false;
+        Motion = SYNTHETIC_STATIC;
+        Center[0] = 100.f;
+        Center[1] = 350.f;
+        Center[2] = 70.f;
+        Amplitude[0] = 0.f;
+        Amplitude[1] = 80.f;
+        Amplitude[2] = 0.f;
+        const float DefaultFingertipOffsets[FINGER_COUNT][3] = {
+            { -40.f, 20.f, -50.f },
+            { -20.f, 0.f, -90.f },
+            { 0.f, 0.f, -100.f },
+            { 20.f, 0.f, -90.f },
+            { 40.f, 0.f, -70.f }
+        };
+        memcpy(FingertipOffsets, DefaultFingertipOffsets, sizeof(FingertipOffsets));
+        PeriodFrames = 240;
+        Jitter = 0.f;
+    }
+};
+
+/**
+ * Deterministic generator of hand frames for profiling and load testing without a device.
+ * The same parameters and seed always produce the same sequence of frames, and the timestamp advances by a fixed interval per frame rather than following the wall clock.
+ */
+class SyntheticHandTrackingSource : public IHandTrackingSource
+{
+public:
+    SyntheticHandTrackingSource(uint32_t Seed = 1, int64_t FrameIntervalMicros = 8333)
+    {
+        this->Seed = Seed;
+        this->FrameIntervalMicros = FrameIntervalMicros;
+        Hands[HAND_LEFT].Enabled = true;
+        // mirror the default left hand for the right hand, disabled by default
+        Hands[HAND_RIGHT].Center[0] = -Hands[HAND_LEFT].Center[0];
+        for (int FingerIndex = 0; FingerIndex < FINGER_COUNT; FingerIndex++) {
+            Hands[HAND_RIGHT].FingertipOffsets[FingerIndex][0] = -Hands[HAND_LEFT].FingertipOffsets[FingerIndex][0];
+        }
+        Reset();
+    }
+
+    /*
+     Parameters for each hand, indexed by HandSide.  Can be changed between frames.
+     */
+    SyntheticHandMotion Hands[HAND_COUNT];
+
+    /*
+     Restarts the sequence from the first frame
+     */
+    void Reset()
+    {
+        FrameIndex = 0;
+        RandomState = Seed != 0 ? Seed : 1;
+        memset(&CurrentFrame, 0, sizeof(CurrentFrame));
+    }
+
+    virtual const HandFrameRecord* ReadFrame()
+    {
+        CurrentFrame.Timestamp = FrameIndex * FrameIntervalMicros;
+        CurrentFrame.FrameId = FrameIndex;
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            GenerateHand(Hands[HandIndex], CurrentFrame.Hands[HandIndex]);
+        }
+        FrameIndex++;
+        return &CurrentFrame;
+    }
+
+protected:
+
+    void GenerateHand(const SyntheticHandMotion& Parameters, HandRecord& OutHand)
+    {
+        if (!Parameters.Enabled) {
+            OutHand.Flags = 0;
+            return;
+        }
+        OutHand.Flags = HAND_RECORD_VALID;
+        OutHand.Confidence = 1.f;
+        OutHand.GrabStrength = 0.f;
+        OutHand.PinchStrength = 0.f;
+        float Palm[3] = { Parameters.Center[0], Parameters.Center[1], Parameters.Center[2] };
+        uint32_t Period = Parameters.PeriodFrames > 0 ? Parameters.PeriodFrames : 1;
+        double Phase = (double)(FrameIndex % Period) / Period;
+        if (Parameters.Motion == SYNTHETIC_SWEEP) {
+            // triangle wave from -1 to 1 and back, so the speed along the sweep is constant
+            float Position = (float)(Phase < 0.5 ? (4.0 * Phase - 1.0) : (3.0 - 4.0 * Phase));
+            for (int Axis = 0; Axis < 3; Axis++) {
+                Palm[Axis] += Parameters.Amplitude[Axis] * Position;
+            }
+        }
+        else if (Parameters.Motion == SYNTHETIC_CIRCLE) {
+            double Angle = Phase * 2.0 * 3.14159265358979323846;
+            Palm[0] += (float)(Parameters.Amplitude[0] * cos(Angle));
+            Palm[1] += (float)(Parameters.Amplitude[0] * sin(Angle));
+        }
+        // the other joints are laid out on straight fingers between the palm and the fingertips, the wrist sits behind the palm opposite the middle finger
+        static const float FingerJointFractions[FINGER_JOINT_COUNT] = { -0.4f, 0.25f, 0.55f, 0.8f, 1.f };
+        const float* MiddleOffset = Parameters.FingertipOffsets[FINGER_MIDDLE];
+        for (int Axis = 0; Axis < 3; Axis++) {
+            OutHand.Joints[HAND_JOINT_PALM][Axis] = Palm[Axis] + NextJitter(Parameters.Jitter);
+            OutHand.Joints[HAND_JOINT_WRIST][Axis] = Palm[Axis] - 0.7f * MiddleOffset[Axis] + NextJitter(Parameters.Jitter);
+        }
+        for (int FingerIndex = 0; FingerIndex < FINGER_COUNT; FingerIndex++) {
+            for (int JointIndex = 0; JointIndex < FINGER_JOINT_COUNT; JointIndex++) {
+                float* Joint = OutHand.Joints[HandJointIndex(FingerIndex, JointIndex)];
+                for (int Axis = 0; Axis < 3; Axis++) {
+                    Joint[Axis] = Palm[Axis] + Parameters.FingertipOffsets[FingerIndex][Axis] * FingerJointFractions[JointIndex] + NextJitter(Parameters.Jitter);
+                }
+            }
+        }
+        // flat hand, palm facing down (-Y in Leap), pointing along the middle finger; every bone of a straight finger shares the finger's orientation
+        float MiddleLength = sqrtf(MiddleOffset[0] * MiddleOffset[0] + MiddleOffset[1] * MiddleOffset[1] + MiddleOffset[2] * MiddleOffset[2]);
+        for (int Axis = 0; Axis < 3; Axis++) {
+            OutHand.PalmNormal[Axis] = Axis == 1 ? -1.f : 0.f;
+            OutHand.PalmDirection[Axis] = MiddleLength > 0.f ? MiddleOffset[Axis] / MiddleLength : (Axis == 2 ? -1.f : 0.f);
+        }
+        const float BackOfHand[3] = { 0.f, 1.f, 0.f };
+        for (int FingerIndex = 0; FingerIndex < FINGER_COUNT; FingerIndex++) {
+            const float* Offset = Parameters.FingertipOffsets[FingerIndex];
+            const float AlongFinger[3] = { -Offset[0], -Offset[1], -Offset[2] };
+            float Orientation[4];
+            HandQuaternionFromAxes(BackOfHand, AlongFinger, Orientation);
+            for (int BoneIndex = 0; BoneIndex < FINGER_BONE_COUNT; BoneIndex++) {
+                memcpy(OutHand.BoneOrientations[HandBoneIndex(FingerIndex, BoneIndex)], Orientation, sizeof(Orientation));
+            }
+        }
+    }
+
+    /*
+     Uniform noise in [-Amplitude, Amplitude] from a xorshift32 generator, so the sequence only depends on the seed
+     */
+    float NextJitter(float Amplitude)
+    {
+        if (Amplitude == 0.f) {
+            return 0.f;
+        }
+        RandomState ^= RandomState << 13;
+        RandomState ^= RandomState >> 17;
+        RandomState ^= RandomState << 5;
+        float Unit = (RandomState >> 8) * (1.f / 16777216.f); // [0, 1)
+        return (Unit * 2.f - 1.f) * Amplitude;
+    }
+
+    uint32_t Seed;
+    uint32_t RandomState;
+    int64_t FrameIntervalMicros;
+    int64_t FrameIndex;
+    HandFrameRecord CurrentFrame;
+};
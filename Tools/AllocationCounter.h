@@ -0,0 +1,93 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#pragma once
+
+/**
+ * Counts heap allocations made through the global operator new, so the tools can report allocations per frame.
+ * Exactly one translation unit of a tool must define ALLOCATION_COUNTER_IMPLEMENTATION before including this header, which replaces the global operator new/delete.
+ * Not meant for the game itself, Unreal provides its own allocator.
+ */
+class AllocationCounter
+{
+public:
+    static uint64_t GetCount()
+    {
+        return Counter().load(std::memory_order_relaxed);
+    }
+
+    static std::atomic<uint64_t>& Counter()
+    {
+        static std::atomic<uint64_t> Count(0);
+        return Count;
+    }
+};
+
+#ifdef ALLOCATION_COUNTER_IMPLEMENTATION
+
+void* operator new(size_t Size)
+{
+    AllocationCounter::Counter().fetch_add(1, std::memory_order_relaxed);
+    void* Memory = malloc(Size > 0 ? Size : 1);
+    if (Memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return Memory;
+}
+
+void* operator new[](size_t Size)
+{
+    return operator new(Size);
+}
+
+void operator delete(void* Memory) noexcept
+{
+    free(Memory);
+}
+
+void operator delete[](void* Memory) noexcept
+{
+    free(Memory);
+}
+
+void operator delete(void* Memory, size_t) noexcept
+{
+    free(Memory);
+}
+
+void operator delete[](void* Memory, size_t) noexcept
+{
+    free(Memory);
+}
+
+#endif
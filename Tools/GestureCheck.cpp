@@ -0,0 +1,235 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+/*
+ Replay-driven check of the gesture detectors in HandGestures.h without the engine.  A scripted capture is written with SyntheticHandTrackingSource
+ and replayed through the HandLocationTracker that LeapInputReader runs into a HandGestureEngine with the activation, pinch, fist and snap turn
+ detectors, the way LeapInputReader feeds it.  The script holds the left hand over the activation disk, pinches and releases it, then swipes the
+ right hand sideways.
+ 
+ Build (from the Tools directory):
+     g++ -O2 -std=c++11 -I.. GestureCheck.cpp -o GestureCheck
+ 
+ Usage:
+     GestureCheck [--file PATH]
+ 
+ PATH is the scratch capture (GestureCheck.ljhf in the current directory by default); it is removed at the end.
+ Checks that the left hand activates, that the pinch begins after the detector's MinFrames and ends on release, that the swipe snap turns once per
+ cooldown, and that replaying every frame twice (a game ticking faster than the tracker) gives no events on the repeated frame id and the same
+ events as replaying it once.  Every failed check is printed and the tool exits with status 1.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "HandFrameRecord.h"
+#include "HandGestures.h"
+#include "HeadlessInputPath.h"
+#include "SyntheticHandTrackingSource.h"
+
+static const uint64_t PINCH_BEGIN_FRAME = 30;
+static const uint64_t PINCH_END_FRAME = 60;
+static const uint64_t SWIPE_BEGIN_FRAME = 90;
+static const uint64_t SCRIPT_FRAMES = 210;
+
+static int Failures = 0;
+
+static void Check(bool Condition, const char* What)
+{
+    if (!Condition) {
+        fprintf(stderr, "FAILED: %s\n", What);
+        Failures++;
+    }
+}
+
+static bool WriteScript(const char* Path)
+{
+    HandFrameRecorder Recorder;
+    if (!Recorder.Open(Path)) {
+        return false;
+    }
+    SyntheticHandTrackingSource Source;
+    SyntheticHandMotion& Right = Source.Hands[HAND_RIGHT];
+    // Leap X is Character Y: 10 cm to either side in 12 frames, about 200 cm/s
+    Right.Motion = SYNTHETIC_SWEEP;
+    Right.Amplitude[0] = 100.f;
+    Right.Amplitude[1] = 0.f;
+    Right.PeriodFrames = 24;
+    for (uint64_t FrameIndex = 0; FrameIndex < SCRIPT_FRAMES; FrameIndex++) {
+        Right.Enabled = FrameIndex >= SWIPE_BEGIN_FRAME;
+        HandFrameRecord Frame = *Source.ReadFrame();
+        Frame.Hands[HAND_LEFT].PinchStrength = FrameIndex >= PINCH_BEGIN_FRAME && FrameIndex < PINCH_END_FRAME ? 0.95f : 0.3f;
+        if (!Recorder.Write(Frame)) {
+            return false;
+        }
+    }
+    Recorder.Close();
+    return true;
+}
+
+/*
+ Replays the capture, every frame Visits times in a row, and collects the events of the first visit of each frame.  False if a repeated visit
+ produced an event.
+ */
+static bool Replay(const HandFrameReplay& Capture, int Visits, std::vector<GestureEvent>& OutEvents)
+{
+    HeadlessInputPath Path;
+    HandGestureEngine Engine;
+    ActivationGestureDetector Activation(HAND_LEFT);
+    PinchBrakeGestureDetector PinchBrake(HAND_LEFT);
+    FistStopGestureDetector FistStop(HAND_LEFT);
+    SwipeSnapTurnGestureDetector SnapTurn(HAND_RIGHT);
+    Engine.AddDetector(&Activation);
+    Engine.AddDetector(&PinchBrake);
+    Engine.AddDetector(&FistStop);
+    Engine.AddDetector(&SnapTurn);
+    Engine.SetTuning(Path.Tuning);
+
+    bool RepeatsQuiet = true;
+    OutEvents.clear();
+    for (uint64_t FrameIndex = 0; FrameIndex < Capture.GetFrameCount(); FrameIndex++) {
+        const HandFrameRecord& Frame = *Capture.GetFrame(FrameIndex);
+        for (int Visit = 0; Visit < Visits; Visit++) {
+            Path.UpdateSample(Frame);
+            const HandLocationTracker& Locations = Path.GetLocations();
+            Engine.Update(Frame, Locations.GetPalmLocations_CharacterSpace(), Locations.GetFingerLocations_CharacterSpace());
+            const GestureEventQueue& Events = Engine.GetEvents();
+            if (Visit > 0) {
+                RepeatsQuiet = RepeatsQuiet && Events.GetCount() == 0;
+                continue;
+            }
+            for (int i = 0; i < Events.GetCount(); i++) {
+                OutEvents.push_back(Events.Get(i));
+            }
+        }
+    }
+    return RepeatsQuiet;
+}
+
+static int CountEvents(const std::vector<GestureEvent>& Events, GestureEventType Type, int Hand)
+{
+    int Count = 0;
+    for (size_t i = 0; i < Events.size(); i++) {
+        Count += Events[i].Type == Type && Events[i].Hand == Hand ? 1 : 0;
+    }
+    return Count;
+}
+
+static const GestureEvent* FindEvent(const std::vector<GestureEvent>& Events, GestureEventType Type, int Hand)
+{
+    for (size_t i = 0; i < Events.size(); i++) {
+        if (Events[i].Type == Type && Events[i].Hand == Hand) {
+            return &Events[i];
+        }
+    }
+    return nullptr;
+}
+
+static bool SameEvents(const std::vector<GestureEvent>& A, const std::vector<GestureEvent>& B)
+{
+    if (A.size() != B.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < A.size(); i++) {
+        if (A[i].Type != B[i].Type || A[i].Hand != B[i].Hand || memcmp(&A[i].Value, &B[i].Value, sizeof(float)) != 0 ||
+            A[i].Timestamp != B[i].Timestamp || A[i].FrameId != B[i].FrameId) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* CapturePath = "GestureCheck.ljhf";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+            CapturePath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "usage: %s [--file PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+    HandFrameReplay Capture;
+    if (!WriteScript(CapturePath) || !Capture.Open(CapturePath)) {
+        fprintf(stderr, "could not write and reopen %s\n", CapturePath);
+        return 1;
+    }
+
+    std::vector<GestureEvent> Events;
+    Replay(Capture, 1, Events);
+    for (size_t i = 0; i < Events.size(); i++) {
+        printf("frame %4lld  hand %d  event %d  value %g\n", (long long)Events[i].FrameId, Events[i].Hand, (int)Events[i].Type, Events[i].Value);
+    }
+
+    const GestureEvent* Activate = FindEvent(Events, GESTURE_ACTIVATE, HAND_LEFT);
+    Check(Activate != nullptr && Activate->FrameId < (int64_t)PINCH_BEGIN_FRAME, "the left hand over the disk activates the joystick");
+    Check(CountEvents(Events, GESTURE_DEACTIVATE, HAND_LEFT) == 0, "the held left hand does not deactivate");
+
+    const GestureEvent* PinchBegin = FindEvent(Events, GESTURE_PINCH_BRAKE_BEGIN, HAND_LEFT);
+    const GestureEvent* PinchEnd = FindEvent(Events, GESTURE_PINCH_BRAKE_END, HAND_LEFT);
+    PinchBrakeGestureDetector DefaultPinch;
+    Check(PinchBegin != nullptr && PinchBegin->FrameId == (int64_t)PINCH_BEGIN_FRAME + DefaultPinch.Trigger.MinFrames - 1,
+          "the pinch begins once it was held for MinFrames frames");
+    Check(PinchEnd != nullptr && PinchEnd->FrameId == (int64_t)PINCH_END_FRAME, "the pinch ends on the first released frame");
+    Check(CountEvents(Events, GESTURE_PINCH_BRAKE_BEGIN, HAND_LEFT) == 1 && CountEvents(Events, GESTURE_PINCH_BRAKE_END, HAND_LEFT) == 1,
+          "one pinch gives one BEGIN and one END");
+    Check(CountEvents(Events, GESTURE_FIST_STOP_BEGIN, HAND_LEFT) == 0, "an open hand gives no fist stop");
+
+    // the swipe lasts SCRIPT_FRAMES - SWIPE_BEGIN_FRAME frames of 8333 us, one turn per cooldown at most
+    SwipeSnapTurnGestureDetector DefaultSnapTurn;
+    int SnapTurns = CountEvents(Events, GESTURE_SNAP_TURN, HAND_RIGHT);
+    double SwipeSeconds = (double)(SCRIPT_FRAMES - SWIPE_BEGIN_FRAME) * 8333e-6;
+    Check(SnapTurns >= 1, "the sideways swipe snap turns");
+    Check(SnapTurns <= (int)(SwipeSeconds / DefaultSnapTurn.CooldownSeconds) + 1, "no more than one snap turn per cooldown");
+    int64_t PreviousTurn = -1;
+    for (size_t i = 0; i < Events.size(); i++) {
+        if (Events[i].Type != GESTURE_SNAP_TURN) {
+            continue;
+        }
+        Check(Events[i].FrameId >= (int64_t)SWIPE_BEGIN_FRAME && fabsf(Events[i].Value) == DefaultSnapTurn.SnapAngle, "snap turns only come from the swipe");
+        Check(PreviousTurn < 0 || Events[i].Timestamp - PreviousTurn >= (int64_t)(DefaultSnapTurn.CooldownSeconds * 1e6f), "snap turns respect the cooldown");
+        PreviousTurn = Events[i].Timestamp;
+    }
+
+    std::vector<GestureEvent> TwiceEvents;
+    Check(Replay(Capture, 2, TwiceEvents), "a repeated frame id gives no events");
+    Check(SameEvents(Events, TwiceEvents), "repeated frame ids do not change the events");
+
+    Capture.Close();
+    remove(CapturePath);
+    if (Failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", Failures);
+        return 1;
+    }
+    printf("all gesture checks passed\n");
+    return 0;
+}
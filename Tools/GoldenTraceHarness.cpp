@@ -0,0 +1,389 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+/*
+ Golden-trace regression harness for the joystick outputs.  Replays capture files through the headless input path (HeadlessInputPath.h, which runs the
+ HandLocationTracker owned by LeapInputReader and the VirtualJoystickCore used by VirtualJoystick3D) as fast as possible, one trace per thread, and
+ compares forward/right/turn/activated of every frame with the stored
+ golden results.  Fails if any output differs by more than the tolerance, if an output is NaN or infinite where the golden value is not (or the
+ other way round), if an activation flag differs, or if throughput drops below a quarter of the trace's checked-in baseline, so behavior and
+ performance regressions both fail.
+ 
+ Build (from the Tools directory):
+     g++ -O2 -std=c++11 -pthread -I.. GoldenTraceHarness.cpp -o GoldenTraceHarness
+ 
+ Usage:
+     GoldenTraceHarness [--update] [--tolerance T] [--threads N] [--repeat N] [--min-fps F] trace.ljhf [trace.ljhf ...]
+     GoldenTraceHarness --make-synthetic out.ljhf FRAMES
+ 
+ The golden results of trace.ljhf live next to it in trace.ljhf.golden (text, one line per frame), its throughput baseline in trace.ljhf.throughput
+ (frames/s).  --update (re)writes both instead of comparing, review the diff of the .golden files when a change is meant to alter the feel of the
+ controls.  The baseline assumes the -O2 build above and has a 4x margin for slower machines and noise; --min-fps F replaces it with a fixed floor (0 turns the check off).
+ --repeat replays every trace N times, by default as often as it takes to time at least 100000 frames.  --make-synthetic writes a deterministic
+ capture that activates, moves, deactivates and loses the hand, for use as a trace when no recordings are at hand.
+ 
+ To check the checked-in synthetic trace (Tools/Traces/synthetic.ljhf, written with --make-synthetic ... 1920), run from the repository root:
+     Tools/GoldenTraceHarness Tools/Traces/synthetic.ljhf
+ A non-zero exit status means a behavior or throughput regression.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "HeadlessInputPath.h"
+#include "JobThreadPool.h"
+#include "SyntheticHandTrackingSource.h"
+
+struct GoldenFrame
+{
+    int64_t FrameId;
+    float ForwardMovement;
+    float RightMovement;
+    float TurnRate;
+    int IsActivated;
+};
+
+/*
+ Everything one trace job needs and produces, the jobs share nothing else
+ */
+static const double THROUGHPUT_BASELINE_MARGIN = 4.0; // fail below a quarter of the baseline frames/s
+static const uint64_t MIN_TIMED_FRAMES = 100000;        // the default --repeat times at least this many frames per trace
+
+struct TraceJob
+{
+    std::string Path;
+    bool Update;
+    float Tolerance;
+    int Repeat; // 0 = enough runs for MIN_TIMED_FRAMES
+
+    bool Passed;
+    std::string Message;
+    uint64_t FrameCount;
+    uint64_t ActivatedFrames;
+    uint64_t Mismatches;
+    float MaxDifference;
+    double Seconds;
+    double BaselineFps; // from trace.throughput, 0 if there is none
+};
+
+static bool ReadGolden(const std::string& Path, std::vector<GoldenFrame>& OutFrames)
+{
+    FILE* File = fopen(Path.c_str(), "r");
+    if (File == nullptr) {
+        return false;
+    }
+    char Line[256];
+    while (fgets(Line, sizeof(Line), File) != nullptr) {
+        if (Line[0] == '#') {
+            continue;
+        }
+        GoldenFrame Frame;
+        long long FrameId;
+        if (sscanf(Line, "%lld %f %f %f %d", &FrameId, &Frame.ForwardMovement, &Frame.RightMovement, &Frame.TurnRate, &Frame.IsActivated) == 5) {
+            Frame.FrameId = FrameId;
+            OutFrames.push_back(Frame);
+        }
+    }
+    fclose(File);
+    return true;
+}
+
+static bool WriteGolden(const std::string& Path, const std::vector<GoldenFrame>& Frames)
+{
+    FILE* File = fopen(Path.c_str(), "w");
+    if (File == nullptr) {
+        return false;
+    }
+    fprintf(File, "# frame_id forward right turn activated\n");
+    for (size_t i = 0; i < Frames.size(); i++) {
+        // 9 significant digits round trip a float exactly
+        fprintf(File, "%lld %.9g %.9g %.9g %d\n", (long long)Frames[i].FrameId, Frames[i].ForwardMovement, Frames[i].RightMovement, Frames[i].TurnRate, Frames[i].IsActivated);
+    }
+    return fclose(File) == 0;
+}
+
+static bool ReadThroughput(const std::string& Path, double& OutFramesPerSecond)
+{
+    FILE* File = fopen(Path.c_str(), "r");
+    if (File == nullptr) {
+        return false;
+    }
+    bool Found = false;
+    char Line[256];
+    while (!Found && fgets(Line, sizeof(Line), File) != nullptr) {
+        Found = Line[0] != '#' && sscanf(Line, "%lf", &OutFramesPerSecond) == 1 && OutFramesPerSecond > 0.0;
+    }
+    fclose(File);
+    return Found;
+}
+
+static bool WriteThroughput(const std::string& Path, double FramesPerSecond)
+{
+    FILE* File = fopen(Path.c_str(), "w");
+    if (File == nullptr) {
+        return false;
+    }
+    fprintf(File, "# frames/s of the headless input path on this trace, written by --update; the harness fails below a quarter of it\n");
+    fprintf(File, "%.0f\n", FramesPerSecond);
+    return fclose(File) == 0;
+}
+
+/*
+ True if Actual matches Expected within Tolerance.  A NaN or infinity only matches the same non-finite value, so an output that turns into NaN fails
+ instead of slipping through the tolerance check.  InOutMaxDifference is raised to the difference of finite pairs.
+ */
+static bool CompareOutput(float Actual, float Expected, float Tolerance, float& InOutMaxDifference)
+{
+    if (std::isnan(Actual) || std::isnan(Expected)) {
+        return std::isnan(Actual) && std::isnan(Expected);
+    }
+    if (!std::isfinite(Actual) || !std::isfinite(Expected)) {
+        return Actual == Expected;
+    }
+    float Difference = fabsf(Actual - Expected);
+    InOutMaxDifference = fmaxf(InOutMaxDifference, Difference);
+    return Difference <= Tolerance;
+}
+
+static void RunTrace(TraceJob& Job)
+{
+    Job.Passed = false;
+    Job.FrameCount = 0;
+    Job.ActivatedFrames = 0;
+    Job.Mismatches = 0;
+    Job.MaxDifference = 0.f;
+    Job.Seconds = 0.0;
+    Job.BaselineFps = 0.0;
+    HandFrameReplay Replay;
+    if (!Replay.Open(Job.Path.c_str())) {
+        Job.Message = "could not open capture";
+        return;
+    }
+    Job.FrameCount = Replay.GetFrameCount();
+    if (Job.Repeat <= 0) {
+        Job.Repeat = Job.FrameCount > 0 ? (int)((MIN_TIMED_FRAMES + Job.FrameCount - 1) / Job.FrameCount) : 1;
+    }
+    std::vector<GoldenFrame> Outputs((size_t)Job.FrameCount);
+    HeadlessInputPath Path;
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    for (int Run = 0; Run < Job.Repeat; Run++) {
+        Path.Reset();
+        for (uint64_t FrameIndex = 0; FrameIndex < Job.FrameCount; FrameIndex++) {
+            const HandFrameRecord& Frame = *Replay.GetFrame(FrameIndex);
+            JoystickOutput Output = Path.Update(Frame);
+            GoldenFrame& Result = Outputs[(size_t)FrameIndex];
+            Result.FrameId = Frame.FrameId;
+            Result.ForwardMovement = Output.ForwardMovement;
+            Result.RightMovement = Output.RightMovement;
+            Result.TurnRate = Output.TurnRate;
+            Result.IsActivated = Output.IsActivated ? 1 : 0;
+        }
+    }
+    Job.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    for (size_t i = 0; i < Outputs.size(); i++) {
+        Job.ActivatedFrames += Outputs[i].IsActivated;
+    }
+
+    std::string GoldenPath = Job.Path + ".golden";
+    std::string ThroughputPath = Job.Path + ".throughput";
+    if (Job.Update) {
+        double Fps = Job.Seconds > 0.0 ? Job.FrameCount * Job.Repeat / Job.Seconds : 0.0;
+        Job.Passed = WriteGolden(GoldenPath, Outputs) && WriteThroughput(ThroughputPath, Fps);
+        Job.Message = Job.Passed ? "golden and throughput baseline written" : "could not write " + GoldenPath + " or " + ThroughputPath;
+        return;
+    }
+    ReadThroughput(ThroughputPath, Job.BaselineFps);
+    std::vector<GoldenFrame> Golden;
+    if (!ReadGolden(GoldenPath, Golden)) {
+        Job.Message = "no golden results, run with --update first";
+        return;
+    }
+    if (Golden.size() != Outputs.size()) {
+        Job.Message = "golden results have a different number of frames";
+        return;
+    }
+    char FirstMismatch[160] = "";
+    for (size_t i = 0; i < Outputs.size(); i++) {
+        const GoldenFrame& Expected = Golden[i];
+        const GoldenFrame& Actual = Outputs[i];
+        bool OutputsMatch = true;
+        float Difference = 0.f;
+        OutputsMatch = CompareOutput(Actual.ForwardMovement, Expected.ForwardMovement, Job.Tolerance, Difference) && OutputsMatch;
+        OutputsMatch = CompareOutput(Actual.RightMovement, Expected.RightMovement, Job.Tolerance, Difference) && OutputsMatch;
+        OutputsMatch = CompareOutput(Actual.TurnRate, Expected.TurnRate, Job.Tolerance, Difference) && OutputsMatch;
+        Job.MaxDifference = fmaxf(Job.MaxDifference, Difference);
+        if (!OutputsMatch || Actual.IsActivated != Expected.IsActivated || Actual.FrameId != Expected.FrameId) {
+            if (Job.Mismatches == 0) {
+                snprintf(FirstMismatch, sizeof(FirstMismatch), "first at frame %lld: got %g %g %g %d, golden %g %g %g %d", (long long)Actual.FrameId,
+                         Actual.ForwardMovement, Actual.RightMovement, Actual.TurnRate, Actual.IsActivated,
+                         Expected.ForwardMovement, Expected.RightMovement, Expected.TurnRate, Expected.IsActivated);
+            }
+            Job.Mismatches++;
+        }
+    }
+    Job.Passed = Job.Mismatches == 0;
+    Job.Message = Job.Passed ? "matches golden" : std::to_string(Job.Mismatches) + " frames differ, " + FirstMismatch;
+}
+
+static void RunTraceRange(void* Context, size_t Begin, size_t End)
+{
+    TraceJob* Jobs = (TraceJob*)Context;
+    for (size_t i = Begin; i < End; i++) {
+        RunTrace(Jobs[i]);
+    }
+}
+
+/*
+ Left hand over the activation disk going through phases of circling, sweeping up and down through the disk plane (activation and deactivation),
+ holding still and leaving the tracking area
+ */
+static int MakeSyntheticTrace(const char* Path, uint64_t FrameCount)
+{
+    HandFrameRecorder Recorder;
+    if (!Recorder.Open(Path)) {
+        fprintf(stderr, "could not create %s\n", Path);
+        return 1;
+    }
+    SyntheticHandTrackingSource Source;
+    SyntheticHandMotion& Hand = Source.Hands[HAND_LEFT];
+    Hand.Jitter = 1.f;
+    for (uint64_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++) {
+        switch ((FrameIndex / 480) % 4) {
+            case 0:
+                Hand.Enabled = true;
+                Hand.Motion = SYNTHETIC_CIRCLE;
+                Hand.Amplitude[0] = 60.f;
+                Hand.Amplitude[2] = 0.f;
+                break;
+            case 1:
+                Hand.Motion = SYNTHETIC_SWEEP;
+                Hand.Amplitude[0] = 30.f;
+                Hand.Amplitude[1] = 200.f;
+                // Leap +Z is character -Z, so this drops the finger below the disk and exercises deactivation
+                Hand.Amplitude[2] = 200.f;
+                break;
+            case 2:
+                Hand.Motion = SYNTHETIC_STATIC;
+                break;
+            default:
+                Hand.Enabled = (FrameIndex / 60) % 2 == 0;
+                Hand.Motion = SYNTHETIC_CIRCLE;
+                Hand.Amplitude[0] = 40.f;
+                Hand.Amplitude[1] = 80.f;
+                Hand.Amplitude[2] = 0.f;
+                break;
+        }
+        Recorder.Write(*Source.ReadFrame());
+    }
+    Recorder.Close();
+    printf("%llu frames written to %s\n", (unsigned long long)Recorder.GetFrameCount(), Path);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    bool Update = false;
+    float Tolerance = 1e-5f;
+    int ThreadCount = 0;
+    int Repeat = 0;
+    double MinFps = -1.0; // below 0: a quarter of each trace's baseline
+    std::vector<TraceJob> Jobs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--make-synthetic") == 0 && i + 2 < argc) {
+            return MakeSyntheticTrace(argv[i + 1], strtoull(argv[i + 2], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--update") == 0) {
+            Update = true;
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            Tolerance = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            ThreadCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            Repeat = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--min-fps") == 0 && i + 1 < argc) {
+            MinFps = atof(argv[++i]);
+        }
+        else if (argv[i][0] == '-') {
+            Jobs.clear();
+            break;
+        }
+        else {
+            TraceJob Job;
+            Job.Path = argv[i];
+            Jobs.push_back(Job);
+        }
+    }
+    if (Jobs.empty()) {
+        fprintf(stderr, "usage: %s [--update] [--tolerance T] [--threads N] [--repeat N] [--min-fps F] trace.ljhf [trace.ljhf ...]\n"
+                        "       %s --make-synthetic out.ljhf FRAMES\n", argv[0], argv[0]);
+        return 2;
+    }
+    for (size_t i = 0; i < Jobs.size(); i++) {
+        Jobs[i].Update = Update;
+        Jobs[i].Tolerance = Tolerance;
+        Jobs[i].Repeat = Repeat > 0 ? Repeat : 0;
+    }
+
+    JobThreadPool Pool(ThreadCount);
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    Pool.ParallelFor(Jobs.size(), 1, &RunTraceRange, &Jobs[0]);
+    double WallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+    bool AllPassed = true;
+    uint64_t TotalFrames = 0;
+    for (size_t i = 0; i < Jobs.size(); i++) {
+        const TraceJob& Job = Jobs[i];
+        double Fps = Job.Seconds > 0.0 ? Job.FrameCount * Job.Repeat / Job.Seconds : 0.0;
+        double FloorFps = MinFps >= 0.0 ? MinFps : Job.BaselineFps / THROUGHPUT_BASELINE_MARGIN;
+        bool NoBaseline = !Update && MinFps < 0.0 && Job.Passed && Job.BaselineFps <= 0.0;
+        bool TooSlow = !Update && FloorFps > 0.0 && Job.FrameCount > 0 && Fps < FloorFps;
+        char Throughput[96] = "";
+        if (NoBaseline) {
+            snprintf(Throughput, sizeof(Throughput), ", no throughput baseline, run with --update first");
+        }
+        else if (TooSlow) {
+            snprintf(Throughput, sizeof(Throughput), ", below the throughput floor of %.0f frames/s", FloorFps);
+        }
+        printf("%s %s: %llu frames, %.1f%% activated, max diff %g, %.0f frames/s - %s%s\n", Job.Passed && !TooSlow && !NoBaseline ? "PASS" : "FAIL",
+               Job.Path.c_str(), (unsigned long long)Job.FrameCount, Job.FrameCount > 0 ? 100.0 * Job.ActivatedFrames / Job.FrameCount : 0.0,
+               Job.MaxDifference, Fps, Job.Message.c_str(), Throughput);
+        AllPassed = AllPassed && Job.Passed && !TooSlow && !NoBaseline;
+        TotalFrames += Job.FrameCount * Job.Repeat;
+    }
+    printf("%zu traces on %d threads, %llu frames in %.3f s, %.0f frames/s overall\n", Jobs.size(), Pool.GetThreadCount(), (unsigned long long)TotalFrames,
+           WallSeconds, WallSeconds > 0.0 ? TotalFrames / WallSeconds : 0.0);
+    return AllPassed ? 0 : 1;
+}
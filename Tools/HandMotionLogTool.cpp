@@ -0,0 +1,203 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+/*
+ Converts between capture files (HandFrameRecorder, .ljhf) and compressed hand motion logs (HandMotionLogWriter, .ljhl), and reports the compression.
+ 
+ Build (from the Tools directory):
+     g++ -O2 -std=c++11 -pthread -I.. HandMotionLogTool.cpp -o HandMotionLogTool
+ 
+ Usage:
+     HandMotionLogTool encode capture.ljhf out.ljhl     compress a capture, then read it back and report size, ratio and max error
+     HandMotionLogTool encode --synthetic=N out.ljhl    same with N frames of synthetic hands (both hands circling, with jitter)
+     HandMotionLogTool decode in.ljhl out.ljhf          expand a log back into a capture that HandFrameReplay can open
+     HandMotionLogTool seek in.ljhl TIMESTAMP           print the first frame at or after TIMESTAMP (microseconds)
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "HandMotionLog.h"
+#include "ReplayHandTrackingSource.h"
+#include "SyntheticHandTrackingSource.h"
+
+static int Usage(const char* Program)
+{
+    fprintf(stderr, "usage: %s encode (capture.ljhf | --synthetic=N) out.ljhl\n"
+                    "       %s decode in.ljhl out.ljhf\n"
+                    "       %s seek in.ljhl TIMESTAMP\n", Program, Program, Program);
+    return 2;
+}
+
+static int Encode(IHandTrackingSource* Source, uint64_t FrameCount, const char* OutPath)
+{
+    HandMotionLogWriter Writer;
+    if (!Writer.Open(OutPath)) {
+        fprintf(stderr, "could not create %s\n", OutPath);
+        return 1;
+    }
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    for (uint64_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++) {
+        const HandFrameRecord* Frame = Source->ReadFrame();
+        // offline there is no frame budget, so wait for the writer instead of dropping like the game thread would
+        while (!Writer.Log(*Frame)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    Writer.Close();
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    HandMotionLogStats Stats = Writer.GetStats();
+    uint64_t RawBytes = FrameCount * sizeof(HandFrameRecord);
+    printf("%llu frames in %llu chunks, %.1f s\n", (unsigned long long)Stats.FramesWritten, (unsigned long long)Stats.ChunksWritten, Seconds);
+    printf("raw %llu bytes (%u per frame), quantized %llu bytes (%u per frame), log %llu bytes (%.1f per frame)\n",
+           (unsigned long long)RawBytes, (unsigned)sizeof(HandFrameRecord), (unsigned long long)(FrameCount * sizeof(QuantizedHandFrameRecord)),
+           (unsigned)sizeof(QuantizedHandFrameRecord), (unsigned long long)Stats.BytesWritten, (double)Stats.BytesWritten / FrameCount);
+    printf("compression %.1fx vs raw, %.1fx vs quantized\n", (double)RawBytes / Stats.BytesWritten,
+           (double)FrameCount * sizeof(QuantizedHandFrameRecord) / Stats.BytesWritten);
+    return 0;
+}
+
+/*
+ Reads the log back and compares it against the source, joints only
+ */
+static int Verify(IHandTrackingSource* Source, uint64_t FrameCount, const char* LogPath)
+{
+    HandMotionLogReader Reader;
+    if (!Reader.Open(LogPath) || Reader.GetFrameCount() != FrameCount) {
+        fprintf(stderr, "FAILED: could not read back %s\n", LogPath);
+        return 1;
+    }
+    float MaxError = 0.f;
+    HandFrameRecord Decoded;
+    for (uint64_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++) {
+        const HandFrameRecord* Frame = Source->ReadFrame();
+        if (!Reader.ReadFrame(Decoded) || Decoded.Timestamp != Frame->Timestamp) {
+            fprintf(stderr, "FAILED: frame %llu does not match\n", (unsigned long long)FrameIndex);
+            return 1;
+        }
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            for (int Joint = 0; Joint < HAND_JOINT_COUNT; Joint++) {
+                for (int Axis = 0; Axis < 3; Axis++) {
+                    MaxError = fmaxf(MaxError, fabsf(Decoded.Hands[HandIndex].Joints[Joint][Axis] - Frame->Hands[HandIndex].Joints[Joint][Axis]));
+                }
+            }
+        }
+    }
+    printf("verified, max joint error %.4f mm\n", MaxError);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 4) {
+        return Usage(argv[0]);
+    }
+    if (strcmp(argv[1], "encode") == 0) {
+        HandFrameReplay Replay;
+        SyntheticHandTrackingSource Synthetic;
+        uint64_t FrameCount = 0;
+        const char* OutPath = argv[3];
+        bool UseSynthetic = strncmp(argv[2], "--synthetic=", 12) == 0;
+        if (UseSynthetic) {
+            FrameCount = strtoull(argv[2] + 12, nullptr, 10);
+            for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+                Synthetic.Hands[HandIndex].Enabled = true;
+                Synthetic.Hands[HandIndex].Motion = SYNTHETIC_CIRCLE;
+                Synthetic.Hands[HandIndex].Amplitude[0] = 60.f;
+                Synthetic.Hands[HandIndex].Jitter = 0.5f;
+            }
+        }
+        else if (Replay.Open(argv[2])) {
+            FrameCount = Replay.GetFrameCount();
+        }
+        else {
+            fprintf(stderr, "could not open capture %s\n", argv[2]);
+            return 1;
+        }
+        if (FrameCount == 0) {
+            fprintf(stderr, "nothing to encode\n");
+            return 1;
+        }
+        ReplayHandTrackingSource ReplaySource(&Replay, false);
+        IHandTrackingSource* Source = UseSynthetic ? (IHandTrackingSource*)&Synthetic : &ReplaySource;
+        int Result = Encode(Source, FrameCount, OutPath);
+        if (Result != 0) {
+            return Result;
+        }
+        if (UseSynthetic) {
+            Synthetic.Reset();
+        }
+        else {
+            ReplaySource.Seek(0);
+        }
+        return Verify(Source, FrameCount, OutPath);
+    }
+    if (strcmp(argv[1], "decode") == 0) {
+        HandMotionLogReader Reader;
+        HandFrameRecorder Recorder;
+        if (!Reader.Open(argv[2])) {
+            fprintf(stderr, "could not open log %s\n", argv[2]);
+            return 1;
+        }
+        if (!Recorder.Open(argv[3])) {
+            fprintf(stderr, "could not create %s\n", argv[3]);
+            return 1;
+        }
+        HandFrameRecord Frame;
+        while (Reader.ReadFrame(Frame)) {
+            Recorder.Write(Frame);
+        }
+        Recorder.Close();
+        printf("%llu frames written\n", (unsigned long long)Recorder.GetFrameCount());
+        return Recorder.GetFrameCount() == Reader.GetFrameCount() ? 0 : 1;
+    }
+    if (strcmp(argv[1], "seek") == 0) {
+        HandMotionLogReader Reader;
+        if (!Reader.Open(argv[2])) {
+            fprintf(stderr, "could not open log %s\n", argv[2]);
+            return 1;
+        }
+        HandFrameRecord Frame;
+        if (!Reader.Seek(strtoll(argv[3], nullptr, 10)) || !Reader.ReadFrame(Frame)) {
+            fprintf(stderr, "no frame at or after %s (log covers %lld to %lld)\n", argv[3], (long long)Reader.GetFirstTimestamp(), (long long)Reader.GetLastTimestamp());
+            return 1;
+        }
+        printf("frame %lld at %lld\n", (long long)Frame.FrameId, (long long)Frame.Timestamp);
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            const HandRecord& Hand = Frame.Hands[HandIndex];
+            printf("%s hand %s palm %.2f %.2f %.2f grab %.2f pinch %.2f confidence %.2f\n", HandIndex == HAND_LEFT ? "left" : "right",
+                   (Hand.Flags & HAND_RECORD_VALID) ? "tracked" : "not tracked", Hand.Joints[HAND_JOINT_PALM][0], Hand.Joints[HAND_JOINT_PALM][1],
+                   Hand.Joints[HAND_JOINT_PALM][2], Hand.GrabStrength, Hand.PinchStrength, Hand.Confidence);
+        }
+        return 0;
+    }
+    return Usage(argv[0]);
+}
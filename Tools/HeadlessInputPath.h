@@ -0,0 +1,93 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include "HandJointFilter.h"
+#include "HandLocationTracker.h"
+#include "JoystickCore.h"
+
+#pragma once
+
+/**
+ * The whole per-tick input path of the README example without Unreal: the HandLocationTracker that LeapInputReader::UpdateHandLocationsFromFrame() runs
+ * (optional filter, untracked hands keep their last world location) followed by the VirtualJoystickCore::Evaluate() that
+ * VirtualJoystick3D::CalculateMovementFromHandLocation() runs on the movement hand.  Only the wiring lives here, the per-frame code is the game's.
+ * The Character and HMD pose stay fixed at Pose, the movement does not feed back into it.
+ */
+class HeadlessInputPath
+{
+public:
+    HandSpaceSettings Settings;
+    HandSpacePose Pose;
+    HandFilterSettings FilterSettings;
+    JoystickTuning Tuning;
+    int MovementHand; // HAND_LEFT as in the README example
+
+    HeadlessInputPath()
+    {
+        MovementHand = HAND_LEFT;
+        Reset();
+    }
+
+    /*
+     Back to the state of a freshly constructed LeapInputReader and VirtualJoystick3D, keeping the settings
+     */
+    void Reset()
+    {
+        State = JoystickState();
+        Locations.Reset();
+    }
+
+    JoystickOutput Update(const HandFrameRecord& Frame)
+    {
+        return VirtualJoystickCore::Evaluate(Tuning, State, UpdateSample(Frame));
+    }
+
+    /*
+     Only the LeapInputReader half of Update(): the movement hand sample in Character space.  It does not depend on Tuning, so a tuner can compute the
+     samples of a trace once and evaluate any number of tunings on them.
+     */
+    JoystickSample UpdateSample(const HandFrameRecord& Frame)
+    {
+        Locations.Update(Settings, Pose, FilterSettings, Frame);
+        return Locations.GetSample(MovementHand);
+    }
+
+    const JoystickState& GetState() const
+    {
+        return State;
+    }
+
+    const HandLocationTracker& GetLocations() const
+    {
+        return Locations;
+    }
+
+protected:
+    HandLocationTracker Locations;
+    JoystickState State;
+};
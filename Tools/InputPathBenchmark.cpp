@@ -0,0 +1,458 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+/*
+ Micro-benchmark for the per-tick input path: LeapInputReader::UpdateHandLocations(), LeapPositionToUnrealLocation(), VirtualJoystick3D::CalculateMovementFromHandLocation() and CalculateSpeed().
+ Runs the engine-independent code those methods are built on (HandLocationTracker, HandSpaceTransform and VirtualJoystickCore), so it needs neither Unreal
+ nor a Leap device.  LeapInputReader::UpdateHandLocations() is timed as its two parts, the source's ReadFrame() and the HandLocationTracker::Update()
+ the reader calls with its default (disabled) filter.  The "Input tick" row is one game tick of the real path, ReadFrame, the tracker update and
+ CalculateMovementFromHandLocation; the stages listed below it are timed for diagnosis only and are not part of that number.  With the synthetic
+ source ReadFrame includes generating the frame, with --replay it returns a pointer into the mapped capture and with --async the game thread's mailbox read.
+ 
+ Build (from the Tools directory):
+     g++ -O2 -std=c++11 -pthread -I.. InputPathBenchmark.cpp -o InputPathBenchmark
+ 
+ Usage:
+     InputPathBenchmark [--frames N] [--warmup N] [--replay capture.ljhf] [--async [--poll-us N]] [--assert-zero-allocations] [--trace trace.json]
+ 
+ --frames must be greater than --warmup.  Without --replay the frames come from SyntheticHandTrackingSource (both hands moving in circles with jitter).
+ For each stage it reports mean ns/frame, p50/p99/p99.9 latency and heap allocations per frame.
+ With --assert-zero-allocations the exit code is 1 if anything allocated after the warmup frames, so the steady state can be checked in CI.
+ The check only covers the sources built here, LeapHandTrackingSource::ReadFrame() needs the Leap SDK and is not measured.
+ With --async the source is wrapped in an AsyncHandTrackingSource polling every --poll-us microseconds (default
+ AsyncHandTrackingSource::DEFAULT_POLL_INTERVAL_MICROS), so ReadFrame is the game thread's mailbox read; the mailbox stats (frames dropped and
+ reused, publish to consume latency) and the poll interval, which a new frame can wait on top of that latency, are printed at the end.
+ With --trace the stages also run with InputTrace enabled (the stage timings then include the trace points), the per-stage trace histograms are printed
+ and the events are written as Chrome trace JSON.  The "Trace point" stage is the cost of one empty INPUT_TRACE_SCOPE, enabled or not.
+ Every frame the world and Character space joints of the SIMD transform are compared byte for byte with HandJointTransform::TransformScalar() on the
+ same joints; any difference fails the run with exit code 1.
+ */
+
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "AsyncHandTrackingSource.h"
+#include "DebugDrawBuffer.h"
+#include "HandJointFilter.h"
+#include "HandLocationTracker.h"
+#include "InputTrace.h"
+#include "JoystickCore.h"
+#include "ReplayHandTrackingSource.h"
+#include "SyntheticHandTrackingSource.h"
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+/*
+ Latency samples for one stage, preallocated so recording a sample never allocates
+ */
+struct StageStats
+{
+    const char* Name;
+    std::vector<int64_t> Samples;
+    uint64_t Allocations;
+    size_t SampleCount;
+
+    StageStats(const char* Name, size_t Capacity) : Name(Name), Samples(Capacity), Allocations(0), SampleCount(0) {}
+
+    void Add(int64_t Nanoseconds)
+    {
+        Samples[SampleCount++] = Nanoseconds;
+    }
+};
+
+/*
+ Records the same primitives as LeapInputReader (simple hands) and VirtualJoystick3D (disk, cross lines, cursor) for one frame.
+ The joystick is drawn in Character space, which only changes the coordinates, not the cost.
+ */
+static void RecordDebugDraw(DebugDrawBuffer& Buffer, const HandJointBuffer& Joints, const HandFrameRecord& Frame, const JoystickTuning& Tuning, const JoystickState& State)
+{
+    DebugDrawColor HandColor = DebugDrawColor::Make(255, 0, 255);
+    for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+        if (!(Frame.Hands[HandIndex].Flags & HAND_RECORD_VALID)) {
+            continue;
+        }
+        JoystickVector Palm = Joints.GetWorldLocation(HandIndex, HAND_JOINT_PALM);
+        Buffer.AddSphere(Palm, 1.f, 12, HandColor);
+        for (int FingerIndex = 0; FingerIndex < FINGER_COUNT; FingerIndex++) {
+            JoystickVector Tip = Joints.GetWorldLocation(HandIndex, HandJointIndex(FingerIndex, FINGER_JOINT_TIP));
+            Buffer.AddSphere(Tip, 0.5f, 12, FingerIndex == FINGER_MIDDLE ? DebugDrawColor::Make(255, 0, 0) : HandColor);
+            Buffer.AddLine(Palm, Tip, HandColor);
+        }
+    }
+    DebugDrawColor DiskColor = DebugDrawColor::Make(0, 255, 255);
+    JoystickVector Top = State.IsActivated ? State.DiskLocation : Tuning.ActivationDiskLocation;
+    JoystickVector Bottom = Top;
+    Bottom.Z -= Tuning.MovementDiskHeight;
+    float Radius = State.IsActivated ? Tuning.MovementDiskRadius : Tuning.ActivationDiskRadius;
+    if (State.IsActivated) {
+        Buffer.AddCylinder(Top, Bottom, Tuning.MovementDiskDonutHoleRadius, 12, DiskColor);
+    }
+    Buffer.AddCylinder(Top, Bottom, Radius, 12, DiskColor);
+    JoystickVector LineStart = Bottom;
+    JoystickVector LineEnd = Bottom;
+    LineStart.Y -= Radius;
+    LineEnd.Y += Radius;
+    Buffer.AddLine(LineStart, LineEnd, DiskColor);
+    LineStart = Bottom;
+    LineEnd = Bottom;
+    LineStart.X -= Radius;
+    LineEnd.X += Radius;
+    Buffer.AddLine(LineStart, LineEnd, DiskColor);
+    if (State.IsActivated) {
+        Buffer.AddSphere(Top, 0.4f, 12, DebugDrawColor::Make(0, 0, 255));
+    }
+}
+
+static int64_t Percentile(const std::vector<int64_t>& Sorted, double Fraction)
+{
+    size_t Index = (size_t)(Fraction * (Sorted.size() - 1) + 0.5);
+    return Sorted[Index];
+}
+
+static void PrintStage(StageStats& Stage, int64_t TimerOverhead)
+{
+    std::vector<int64_t> Sorted(Stage.Samples.begin(), Stage.Samples.begin() + Stage.SampleCount);
+    for (size_t i = 0; i < Sorted.size(); i++) {
+        Sorted[i] = std::max<int64_t>(0, Sorted[i] - TimerOverhead);
+    }
+    std::sort(Sorted.begin(), Sorted.end());
+    double Total = 0.0;
+    for (size_t i = 0; i < Sorted.size(); i++) {
+        Total += Sorted[i];
+    }
+    printf("%-36s %10.1f %8lld %8lld %8lld %8lld %10.3f\n", Stage.Name, Total / Sorted.size(),
+           (long long)Percentile(Sorted, 0.5), (long long)Percentile(Sorted, 0.99), (long long)Percentile(Sorted, 0.999), (long long)Sorted.back(),
+           (double)Stage.Allocations / Sorted.size());
+}
+
+/*
+ Median cost of two back to back clock reads, subtracted from every sample
+ */
+static int64_t MeasureTimerOverhead()
+{
+    std::vector<int64_t> Samples(10000);
+    for (size_t i = 0; i < Samples.size(); i++) {
+        BenchmarkClock::time_point Start = BenchmarkClock::now();
+        BenchmarkClock::time_point End = BenchmarkClock::now();
+        Samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(End - Start).count();
+    }
+    std::sort(Samples.begin(), Samples.end());
+    return Samples[Samples.size() / 2];
+}
+
+/*
+ True if the world and Character space output of two joint buffers is bit identical
+ */
+static bool SameTransformedJoints(const HandJointBuffer& A, const HandJointBuffer& B)
+{
+    return memcmp(A.WorldX, B.WorldX, sizeof(A.WorldX)) == 0 && memcmp(A.WorldY, B.WorldY, sizeof(A.WorldY)) == 0 && memcmp(A.WorldZ, B.WorldZ, sizeof(A.WorldZ)) == 0
+        && memcmp(A.CharacterX, B.CharacterX, sizeof(A.CharacterX)) == 0 && memcmp(A.CharacterY, B.CharacterY, sizeof(A.CharacterY)) == 0
+        && memcmp(A.CharacterZ, B.CharacterZ, sizeof(A.CharacterZ)) == 0;
+}
+
+static inline int64_t ElapsedNanoseconds(BenchmarkClock::time_point Start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now() - Start).count();
+}
+
+int main(int argc, char** argv)
+{
+    size_t FrameCount = 1000000;
+    size_t WarmupFrames = 1000;
+    bool AssertZeroAllocations = false;
+    const char* ReplayPath = nullptr;
+    const char* TracePath = nullptr;
+    bool Async = false;
+    int PollIntervalMicros = AsyncHandTrackingSource::DEFAULT_POLL_INTERVAL_MICROS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            FrameCount = (size_t)strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            WarmupFrames = (size_t)strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            ReplayPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--assert-zero-allocations") == 0) {
+            AssertZeroAllocations = true;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            TracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--async") == 0) {
+            Async = true;
+        }
+        else if (strcmp(argv[i], "--poll-us") == 0 && i + 1 < argc) {
+            PollIntervalMicros = atoi(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "usage: %s [--frames N] [--warmup N] [--replay capture.ljhf] [--async [--poll-us N]] [--assert-zero-allocations] [--trace trace.json]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // an empty run has no percentiles or max, and a run no longer than its warmup would not say much about the steady state
+    if (FrameCount == 0 || FrameCount <= WarmupFrames) {
+        fprintf(stderr, "%s: --frames (%zu) must be greater than --warmup (%zu)\n", argv[0], FrameCount, WarmupFrames);
+        return 2;
+    }
+
+    // The frames go through the same IHandTrackingSource interface LeapInputReader reads from
+    HandFrameReplay Replay;
+    ReplayHandTrackingSource* ReplaySource = nullptr;
+    SyntheticHandTrackingSource Synthetic;
+    IHandTrackingSource* Source = &Synthetic;
+    if (ReplayPath != nullptr) {
+        if (!Replay.Open(ReplayPath) || Replay.GetFrameCount() == 0) {
+            fprintf(stderr, "could not open capture %s\n", ReplayPath);
+            return 1;
+        }
+        ReplaySource = new ReplayHandTrackingSource(&Replay, true);
+        Source = ReplaySource;
+    }
+    else {
+        for (int HandIndex = 0; HandIndex < HAND_COUNT; HandIndex++) {
+            Synthetic.Hands[HandIndex].Enabled = true;
+            Synthetic.Hands[HandIndex].Motion = SYNTHETIC_CIRCLE;
+            Synthetic.Hands[HandIndex].Amplitude[0] = 60.f;
+            Synthetic.Hands[HandIndex].Jitter = 2.f;
+        }
+    }
+    // from here on the wrapped source is only read by the acquisition thread, wait for its first frame so ReadFrame never returns nullptr
+    AsyncHandTrackingSource AsyncSource(Source, PollIntervalMicros);
+    if (Async) {
+        AsyncSource.Start();
+        while (AsyncSource.ReadFrame() == nullptr) {
+            std::this_thread::yield();
+        }
+        Source = &AsyncSource;
+    }
+
+    HandSpaceSettings Settings;
+    HandSpacePose Pose;
+    Pose.HasHMDOrientation = true;
+    Pose.HMDOrientation[0] = 0.0436f; // a slightly tilted head
+    Pose.HMDOrientation[1] = 0.0872f;
+    Pose.HMDOrientation[2] = 0.f;
+    Pose.HMDOrientation[3] = 0.9952f;
+    JoystickTuning Tuning;
+    JoystickState State;
+    HandLocationTracker Locations; // what LeapInputReader::UpdateHandLocationsFromFrame() runs
+    HandFilterSettings ReaderFilterSettings; // LeapInputReader's default, the filter is timed on its own below
+    HandJointBuffer ScalarJoints;
+    HandJointBuffer FilteredJoints;
+    HandJointFilter Filter;
+    HandFilterSettings FilterSettings;
+    FilterSettings.Enabled = true;
+    FilterSettings.PredictionSeconds = 0.011f;
+    HandSpaceFrameTransform FrameTransform = HandSpaceFrameTransform::Build(Settings, Pose);
+    DebugDrawBuffer DebugDraw;
+    CountingDebugDrawBackend DebugDrawCounter;
+
+    StageStats ReadFrame("IHandTrackingSource::ReadFrame", FrameCount);
+    StageStats TrackerUpdate("HandLocationTracker::Update", FrameCount);
+    StageStats CalculateMovement("CalculateMovementFromHandLocation", FrameCount);
+    StageStats InputTick("Input tick (Read + Update + Evaluate)", FrameCount);
+    StageStats FilterJoints("HandJointFilter::Apply", FrameCount);
+    StageStats ScalarJointTransform("HandJointTransform::TransformScalar", FrameCount);
+    StageStats LeapPositionToUnrealLocation("LeapPositionToUnrealLocation", FrameCount);
+    StageStats CalculateSpeed("CalculateSpeed (x2)", FrameCount);
+    StageStats DebugDrawStage("Debug draw (record + flush)", FrameCount);
+    StageStats TracePoint("Trace point (INPUT_TRACE_SCOPE)", FrameCount);
+    int64_t TimerOverhead = MeasureTimerOverhead();
+    size_t TransformMismatches = 0;
+
+    volatile float Sink = 0.f; // keeps the compiler from dropping the work
+    if (TracePath != nullptr) {
+        InputTrace::Reset();
+        InputTrace::SetEnabled(true);
+    }
+    // Warm up first (page in the capture, settle caches), steady state is what gets measured
+    for (size_t FrameIndex = 0; FrameIndex < WarmupFrames; FrameIndex++) {
+        const HandFrameRecord* Frame = Source->ReadFrame();
+        Locations.Update(Settings, Pose, ReaderFilterSettings, *Frame);
+        JoystickSample Sample = Locations.GetSample(HAND_LEFT);
+        Sink = Sink + VirtualJoystickCore::Evaluate(Tuning, State, Sample).ForwardMovement;
+        INPUT_TRACE_SCOPE(INPUT_TRACE_APPLY_MOVEMENT); // registers this thread's trace ring before the measured frames
+    }
+    InputTrace::Collect();
+    InputTrace::Reset();
+    for (size_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++) {
+        int64_t FrameArrival = InputTrace::IsEnabled() ? InputTrace::Now() : 0;
+
+        // the input tick as LeapInputReader::UpdateHandLocations() and VirtualJoystick3D run it, timed back to back so the tick is the sum of its stages
+        uint64_t AllocationsBefore = AllocationCounter::GetCount();
+        BenchmarkClock::time_point Start = BenchmarkClock::now();
+        const HandFrameRecord* FramePointer;
+        {
+            INPUT_TRACE_SCOPE(INPUT_TRACE_READ_FRAME);
+            FramePointer = Source->ReadFrame();
+        }
+        const HandFrameRecord& Frame = *FramePointer;
+        BenchmarkClock::time_point Read = BenchmarkClock::now();
+        uint64_t AllocationsRead = AllocationCounter::GetCount();
+        {
+            INPUT_TRACE_SCOPE(INPUT_TRACE_UPDATE_HAND_LOCATIONS);
+            Locations.Update(Settings, Pose, ReaderFilterSettings, Frame);
+        }
+        BenchmarkClock::time_point Middle = BenchmarkClock::now();
+        uint64_t AllocationsMiddle = AllocationCounter::GetCount();
+        JoystickSample Sample = Locations.GetSample(HAND_LEFT);
+        JoystickOutput Output;
+        {
+            INPUT_TRACE_SCOPE(INPUT_TRACE_CALCULATE_MOVEMENT);
+            Output = VirtualJoystickCore::Evaluate(Tuning, State, Sample);
+        }
+        BenchmarkClock::time_point End = BenchmarkClock::now();
+        int64_t ReadNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Read - Start).count();
+        int64_t UpdateNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Middle - Read).count();
+        int64_t EvaluateNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(End - Middle).count();
+        ReadFrame.Add(ReadNanoseconds);
+        ReadFrame.Allocations += AllocationsRead - AllocationsBefore;
+        TrackerUpdate.Add(UpdateNanoseconds);
+        TrackerUpdate.Allocations += AllocationsMiddle - AllocationsRead;
+        CalculateMovement.Add(EvaluateNanoseconds);
+        CalculateMovement.Allocations += AllocationCounter::GetCount() - AllocationsMiddle;
+        // the two clock reads in between are not part of the tick, PrintStage() takes off the remaining one
+        InputTick.Add(ReadNanoseconds + UpdateNanoseconds + EvaluateNanoseconds - 2 * TimerOverhead);
+        InputTick.Allocations += AllocationCounter::GetCount() - AllocationsBefore;
+        Sink = Sink + Output.ForwardMovement + Output.TurnRate;
+
+        FilteredJoints.Load(Frame);
+        AllocationsBefore = AllocationCounter::GetCount();
+        Start = BenchmarkClock::now();
+        Filter.Apply(FilteredJoints, Frame.Timestamp, FilterSettings);
+        FilterJoints.Add(ElapsedNanoseconds(Start));
+        FilterJoints.Allocations += AllocationCounter::GetCount() - AllocationsBefore;
+        Sink = Sink + FilteredJoints.LeapX[0];
+
+        // scalar fallback on the same joints, to compare against the SIMD kernel used above
+        ScalarJoints.Load(Frame);
+        AllocationsBefore = AllocationCounter::GetCount();
+        Start = BenchmarkClock::now();
+        HandJointTransform::TransformScalar(FrameTransform, ScalarJoints);
+        ScalarJointTransform.Add(ElapsedNanoseconds(Start));
+        ScalarJointTransform.Allocations += AllocationCounter::GetCount() - AllocationsBefore;
+        Sink = Sink + ScalarJoints.CharacterX[0];
+        if (!SameTransformedJoints(Locations.GetJoints(), ScalarJoints)) {
+            TransformMismatches++;
+        }
+
+        AllocationsBefore = AllocationCounter::GetCount();
+        Start = BenchmarkClock::now();
+        JoystickVector Point = HandSpaceTransform::LeapToWorld(Settings, Pose, Frame.Hands[HAND_LEFT].GetPalmPosition());
+        LeapPositionToUnrealLocation.Add(ElapsedNanoseconds(Start));
+        LeapPositionToUnrealLocation.Allocations += AllocationCounter::GetCount() - AllocationsBefore;
+        Sink = Sink + Point.X;
+
+        AllocationsBefore = AllocationCounter::GetCount();
+        Start = BenchmarkClock::now();
+        float Speed = VirtualJoystickCore::CalculateSpeed(Tuning, Sample.PalmLocation.X - Tuning.ActivationDiskLocation.X)
+            + VirtualJoystickCore::CalculateSpeed(Tuning, Sample.PalmLocation.Y - Tuning.ActivationDiskLocation.Y);
+        CalculateSpeed.Add(ElapsedNanoseconds(Start));
+        CalculateSpeed.Allocations += AllocationCounter::GetCount() - AllocationsBefore;
+        Sink = Sink + Speed;
+
+        AllocationsBefore = AllocationCounter::GetCount();
+        Start = BenchmarkClock::now();
+        RecordDebugDraw(DebugDraw, Locations.GetJoints(), Frame, Tuning, State);
+        DebugDraw.Flush(DebugDrawCounter);
+        DebugDrawStage.Add(ElapsedNanoseconds(Start));
+        DebugDrawStage.Allocations += AllocationCounter::GetCount() - AllocationsBefore;
+
+        // stands in for the game's movement calls, so it also shows the bare cost of a trace point
+        AllocationsBefore = AllocationCounter::GetCount();
+        Start = BenchmarkClock::now();
+        {
+            INPUT_TRACE_SCOPE(INPUT_TRACE_APPLY_MOVEMENT);
+        }
+        TracePoint.Add(ElapsedNanoseconds(Start));
+        TracePoint.Allocations += AllocationCounter::GetCount() - AllocationsBefore;
+        INPUT_TRACE_SINCE(INPUT_TRACE_MOTION_TO_CONTROL, FrameArrival);
+
+        // drain the trace rings outside the measured stages, well before they fill up
+        if ((FrameIndex & 255) == 255) {
+            InputTrace::Collect();
+        }
+    }
+    uint64_t TotalAllocations = InputTick.Allocations + FilterJoints.Allocations + ScalarJointTransform.Allocations + LeapPositionToUnrealLocation.Allocations
+        + CalculateSpeed.Allocations + DebugDrawStage.Allocations + TracePoint.Allocations;
+
+    printf("%zu frames (%s%s), timer overhead %lld ns subtracted\n", FrameCount, ReplayPath != nullptr ? ReplayPath : "synthetic", Async ? ", async" : "", (long long)TimerOverhead);
+    printf("%-36s %10s %8s %8s %8s %8s %10s\n", "stage", "ns/frame", "p50", "p99", "p99.9", "max", "allocs/fr");
+    PrintStage(ReadFrame, TimerOverhead);
+    PrintStage(TrackerUpdate, TimerOverhead);
+    PrintStage(CalculateMovement, TimerOverhead);
+    PrintStage(InputTick, TimerOverhead);
+    printf("diagnostic stages, not part of the input tick:\n");
+    PrintStage(FilterJoints, TimerOverhead);
+    PrintStage(ScalarJointTransform, TimerOverhead);
+    PrintStage(LeapPositionToUnrealLocation, TimerOverhead);
+    PrintStage(CalculateSpeed, TimerOverhead);
+    PrintStage(DebugDrawStage, TimerOverhead);
+    PrintStage(TracePoint, TimerOverhead);
+    printf("debug draw: %.2f spheres, %.2f lines, %.2f cylinders per frame, %llu dropped\n",
+           (double)DebugDrawCounter.GetCount(DEBUG_DRAW_SPHERE) / FrameCount, (double)DebugDrawCounter.GetCount(DEBUG_DRAW_LINE) / FrameCount,
+           (double)DebugDrawCounter.GetCount(DEBUG_DRAW_CYLINDER) / FrameCount, (unsigned long long)DebugDraw.GetDroppedCount());
+    if (TracePath != nullptr) {
+        InputTrace::Collect();
+        printf("\ntrace (%llu events dropped):\n", (unsigned long long)InputTrace::GetDroppedCount());
+        InputTrace::PrintSummary(stdout);
+        if (!InputTrace::WriteChromeTrace(TracePath)) {
+            fprintf(stderr, "could not write %s\n", TracePath);
+        }
+    }
+    if (Async) {
+        AsyncSource.Stop();
+        HandFrameMailboxStats Stats = AsyncSource.GetStats();
+        printf("async source (warmup included): %llu published, %llu consumed, %llu dropped, %llu reused, latency mean %.0f ns, max %lld ns\n",
+               (unsigned long long)Stats.FramesPublished, (unsigned long long)Stats.FramesConsumed, (unsigned long long)Stats.FramesDropped,
+               (unsigned long long)Stats.FramesReused, Stats.FramesConsumed > 0 ? (double)Stats.TotalLatencyNanoseconds / Stats.FramesConsumed : 0.0,
+               (long long)Stats.MaxLatencyNanoseconds);
+        printf("async poll interval %d us: a new tracker frame waits up to that long (plus sleep overshoot) before it is published, on top of the latency above\n",
+               AsyncSource.GetPollIntervalMicros());
+    }
+    delete ReplaySource;
+    if (TransformMismatches != 0) {
+        fprintf(stderr, "FAILED: SIMD joint transform differs from TransformScalar() in %zu frames\n", TransformMismatches);
+        return 1;
+    }
+    if (AssertZeroAllocations && TotalAllocations != 0) {
+        fprintf(stderr, "FAILED: %llu heap allocations in steady state, expected none\n", (unsigned long long)TotalAllocations);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,507 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+/*
+ Offline auto-tuner for the joystick tuning constants.  Loads the capture files once, turns every frame into the movement hand sample once
+ (HeadlessInputPath.h, through the HandLocationTracker that LeapInputReader runs), then evaluates thousands of candidate JoystickTunings on those shared samples on all cores
+ and writes the best one as an ini file.
+ 
+ Build (from the Tools directory):
+     g++ -O2 -std=c++11 -pthread -I.. JoystickAutoTuner.cpp -o JoystickAutoTuner
+ 
+ Usage:
+     JoystickAutoTuner [--candidates N] [--rounds N] [--seed N] [--threads N] [--filter] [--out tuned.ini] trace.ljhf [trace.ljhf ...]
+ 
+ Every candidate gets a score, lower is better, summed over these terms (weights with --jitter-weight etc.):
+     jitter     - roughness of the outputs while activated: sum of |second difference| over sum of |first difference|.  It does not
+                  depend on the output scale, so shrinking the outputs does not make a candidate look smoother.
+     stability  - activation changes per 1000 frames that undo the previous change within --min-hold frames (activation chatter).
+     dead zone  - share of activated frames where the palm is within --rest-radius cm of the disk center (or the hand angle within --rest-angle
+                  degrees) but the joystick moves, or the palm is beyond --move-radius cm (angle beyond --move-angle) but it does not,
+                  or the joystick is still activated with the finger more than --drop-height cm below the disk.  Four checks per
+                  activated frame (two axes, the drop and the turn angle), the term is the share of checks that fail.
+     range      - distance of the share of frames at full speed / full turn rate from --saturation-target: full speed should be reachable, but rare.
+     coverage   - frames the default tuning is activated on that the candidate is not, as a share of the default's activated frames, so never
+                  activating is not a way to win.
+     false activation - frames the candidate is activated on that the default tuning is not, as a share of the same count, so always
+                  activating is not a way to win either.
+ Round 1 samples the candidates uniformly from the ranges in TunedParameters, every further round samples again around the best candidate so far
+ in ranges half as wide.  Candidate 0 of round 1 is the default tuning, so the result is never worse than the defaults on these traces.
+ A warning is printed for every parameter of the best candidate that sits on a bound of its range, the scoring then probably wants it further out.
+ --filter builds the samples with the One Euro filter enabled, as LeapInputReader does with its filter on.
+ The ini is written by JoystickConfigFile::Write(): the other tuning fields keep their defaults, and the [LeapInputReader] and [HandFilter] sections
+ hold the settings the samples were made with, so the file is a complete JoystickConfig that reproduces what was tuned.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "HeadlessInputPath.h"
+#include "JobThreadPool.h"
+#include "JoystickConfig.h"
+
+struct TunedParameter
+{
+    const char* Name;
+    float JoystickTuning::* Field;
+    float Min;
+    float Max;
+};
+
+// Character space units (cm) and degrees, wide enough to contain the hand tweaked defaults
+static const TunedParameter TunedParameters[] = {
+    { "ActivationDiskRadius", &JoystickTuning::ActivationDiskRadius, 8.f, 35.f },
+    { "MovementDiskRadius", &JoystickTuning::MovementDiskRadius, 5.f, 20.f },
+    { "MovementDiskDonutHoleRadius", &JoystickTuning::MovementDiskDonutHoleRadius, 0.f, 5.f },
+    { "TurnAngleThreshold", &JoystickTuning::TurnAngleThreshold, 2.f, 25.f },
+    { "TurnAngleToRateScale", &JoystickTuning::TurnAngleToRateScale, 1.f, 12.f },
+    { "DeactivationBufferHeight", &JoystickTuning::DeactivationBufferHeight, 2.f, 20.f },
+};
+static const int TunedParameterCount = sizeof(TunedParameters) / sizeof(TunedParameters[0]);
+
+struct ScoringSettings
+{
+    float RestRadius;
+    float MoveRadius;
+    float RestAngle;
+    float MoveAngle;
+    float DropHeight;
+    int MinHoldFrames;
+    float SaturationTarget;
+    float JitterWeight;
+    float StabilityWeight;
+    float DeadZoneWeight;
+    float RangeWeight;
+    float CoverageWeight;
+    float FalseActivationWeight;
+
+    ScoringSettings()
+    {
+        RestRadius = 1.5f;
+        MoveRadius = 4.f;
+        RestAngle = 5.f;
+        MoveAngle = 20.f;
+        DropHeight = 15.f;
+        MinHoldFrames = 30;
+        SaturationTarget = 0.05f;
+        JitterWeight = 1.f;
+        StabilityWeight = 0.5f;
+        DeadZoneWeight = 2.f;
+        RangeWeight = 1.f;
+        CoverageWeight = 2.f;
+        FalseActivationWeight = 2.f;
+    }
+};
+
+/*
+ One capture turned into what the candidates are evaluated on, read only once built so all workers share it
+ */
+struct TraceData
+{
+    std::string Path;
+    std::vector<JoystickSample> Samples;
+    std::vector<float> HandAngles; // degrees, the angle CalculateTurnRate() uses
+    std::vector<uint8_t> BaselineActivated;
+    uint64_t BaselineActivatedCount;
+    bool Loaded;
+};
+
+struct CandidateScore
+{
+    float Total;
+    float Jitter;
+    float Stability;
+    float DeadZone;
+    float Range;
+    float Coverage;
+    float FalseActivation;
+    float ActivatedShare;
+};
+
+struct Candidate
+{
+    JoystickTuning Tuning;
+    CandidateScore Score;
+};
+
+struct EvaluationContext
+{
+    const std::vector<TraceData>* Traces;
+    const ScoringSettings* Settings;
+    Candidate* Candidates;
+};
+
+static bool LoadTrace(TraceData& Trace, bool Filter)
+{
+    Trace.Loaded = false;
+    HandFrameReplay Replay;
+    if (!Replay.Open(Trace.Path.c_str())) {
+        return false;
+    }
+    uint64_t FrameCount = Replay.GetFrameCount();
+    Trace.Samples.resize((size_t)FrameCount);
+    Trace.HandAngles.resize((size_t)FrameCount);
+    Trace.BaselineActivated.resize((size_t)FrameCount);
+    Trace.BaselineActivatedCount = 0;
+    HeadlessInputPath Path;
+    Path.FilterSettings.Enabled = Filter;
+    JoystickTuning Defaults;
+    JoystickState BaselineState;
+    for (uint64_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++) {
+        const JoystickSample Sample = Path.UpdateSample(*Replay.GetFrame(FrameIndex));
+        Trace.Samples[(size_t)FrameIndex] = Sample;
+        Trace.HandAngles[(size_t)FrameIndex] = atan2f(Sample.FingerLocation.Y - Sample.PalmLocation.Y, Sample.FingerLocation.Z - Sample.PalmLocation.Z) * (180 / VirtualJoystickCore::JoystickPi);
+        bool Activated = VirtualJoystickCore::Evaluate(Defaults, BaselineState, Sample).IsActivated;
+        Trace.BaselineActivated[(size_t)FrameIndex] = Activated ? 1 : 0;
+        Trace.BaselineActivatedCount += Activated ? 1 : 0;
+    }
+    Trace.Loaded = true;
+    return true;
+}
+
+static void LoadTraceRange(void* Context, size_t Begin, size_t End)
+{
+    std::pair<std::vector<TraceData>*, bool>* Load = (std::pair<std::vector<TraceData>*, bool>*)Context;
+    for (size_t i = Begin; i < End; i++) {
+        LoadTrace((*Load->first)[i], Load->second);
+    }
+}
+
+/*
+ Replays every trace through one candidate and scores it, see the top of the file for the terms
+ */
+static CandidateScore EvaluateCandidate(const JoystickTuning& Tuning, const std::vector<TraceData>& Traces, const ScoringSettings& Settings)
+{
+    uint64_t Frames = 0, Activated = 0, ChatterChanges = 0, DeadZoneChecks = 0, DeadZoneErrors = 0, SpeedSaturated = 0, TurnSaturated = 0;
+    uint64_t BaselineActivated = 0, CoverageLost = 0, FalseActivations = 0;
+    double FirstDifference[3] = { 0.0, 0.0, 0.0 };
+    double SecondDifference[3] = { 0.0, 0.0, 0.0 };
+    for (size_t TraceIndex = 0; TraceIndex < Traces.size(); TraceIndex++) {
+        const TraceData& Trace = Traces[TraceIndex];
+        JoystickState State;
+        bool WasActivated = false;
+        int64_t LastChange = -(int64_t)Settings.MinHoldFrames;
+        float Previous[2][3];
+        int History = 0;
+        for (size_t i = 0; i < Trace.Samples.size(); i++) {
+            const JoystickSample& Sample = Trace.Samples[i];
+            JoystickOutput Output = VirtualJoystickCore::Evaluate(Tuning, State, Sample);
+            if (Output.IsActivated != WasActivated) {
+                if ((int64_t)i - LastChange < Settings.MinHoldFrames) {
+                    ChatterChanges++;
+                }
+                LastChange = (int64_t)i;
+                WasActivated = Output.IsActivated;
+                History = 0;
+            }
+            if (!Output.IsActivated) {
+                CoverageLost += Trace.BaselineActivated[i];
+                continue;
+            }
+            Activated++;
+            FalseActivations += 1 - Trace.BaselineActivated[i];
+
+            float Values[3] = { Output.ForwardMovement, Output.RightMovement, Output.TurnRate };
+            for (int Channel = 0; Channel < 3; Channel++) {
+                if (History >= 1) {
+                    FirstDifference[Channel] += fabsf(Values[Channel] - Previous[0][Channel]);
+                }
+                if (History >= 2) {
+                    SecondDifference[Channel] += fabsf(Values[Channel] - 2.f * Previous[0][Channel] + Previous[1][Channel]);
+                }
+                Previous[1][Channel] = Previous[0][Channel];
+                Previous[0][Channel] = Values[Channel];
+            }
+            History++;
+
+            float Offsets[2] = { Sample.PalmLocation.X - State.DiskLocation.X, Sample.PalmLocation.Y - State.DiskLocation.Y };
+            for (int Axis = 0; Axis < 2; Axis++) {
+                float Distance = fabsf(Offsets[Axis]);
+                if ((Distance < Settings.RestRadius && Values[Axis] != 0.f) || (Distance > Settings.MoveRadius && Values[Axis] == 0.f)) {
+                    DeadZoneErrors++;
+                }
+            }
+            DeadZoneChecks += 4;
+            if (Sample.FingerLocation.Z < Tuning.ActivationDiskLocation.Z - Settings.DropHeight) {
+                DeadZoneErrors++;
+            }
+            float Angle = fabsf(Trace.HandAngles[i]);
+            if ((Angle < Settings.RestAngle && Values[2] != 0.f) || (Angle > Settings.MoveAngle && Values[2] == 0.f)) {
+                DeadZoneErrors++;
+            }
+
+            if (fabsf(Values[0]) >= Tuning.SpeedScalingFactor || fabsf(Values[1]) >= Tuning.SpeedScalingFactor) {
+                SpeedSaturated++;
+            }
+            if (fabsf(Values[2]) >= Tuning.MaxTurnRate) {
+                TurnSaturated++;
+            }
+        }
+        Frames += Trace.Samples.size();
+        BaselineActivated += Trace.BaselineActivatedCount;
+    }
+
+    CandidateScore Score;
+    Score.Jitter = 0.f;
+    for (int Channel = 0; Channel < 3; Channel++) {
+        if (FirstDifference[Channel] > 0.0) {
+            Score.Jitter += (float)(SecondDifference[Channel] / FirstDifference[Channel]) / 3.f;
+        }
+    }
+    Score.Stability = Frames > 0 ? (float)ChatterChanges * 1000.f / (float)Frames : 0.f;
+    Score.DeadZone = DeadZoneChecks > 0 ? (float)DeadZoneErrors / (float)DeadZoneChecks : 0.f;
+    Score.Range = Activated > 0 ? fabsf((float)SpeedSaturated / (float)Activated - Settings.SaturationTarget) + fabsf((float)TurnSaturated / (float)Activated - Settings.SaturationTarget) : 0.f;
+    Score.Coverage = BaselineActivated > 0 ? (float)CoverageLost / (float)BaselineActivated : 0.f;
+    // normalized like coverage so that gaining and losing a frame of activation weigh the same
+    Score.FalseActivation = BaselineActivated > 0 ? (float)FalseActivations / (float)BaselineActivated : (float)Activated / (float)std::max<uint64_t>(Frames, 1);
+    Score.ActivatedShare = Frames > 0 ? (float)Activated / (float)Frames : 0.f;
+    Score.Total = Settings.JitterWeight * Score.Jitter + Settings.StabilityWeight * Score.Stability + Settings.DeadZoneWeight * Score.DeadZone
+                + Settings.RangeWeight * Score.Range + Settings.CoverageWeight * Score.Coverage + Settings.FalseActivationWeight * Score.FalseActivation;
+    return Score;
+}
+
+static void EvaluateRange(void* Context, size_t Begin, size_t End)
+{
+    EvaluationContext* Evaluation = (EvaluationContext*)Context;
+    for (size_t i = Begin; i < End; i++) {
+        Evaluation->Candidates[i].Score = EvaluateCandidate(Evaluation->Candidates[i].Tuning, *Evaluation->Traces, *Evaluation->Settings);
+    }
+}
+
+/*
+ xorshift32 in [0, 1), candidates only depend on the seed and not on the thread count
+ */
+static float NextUniform(uint32_t& RandomState)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 17;
+    RandomState ^= RandomState << 5;
+    return (float)(RandomState >> 8) / 16777216.f;
+}
+
+/*
+ Candidate uniformly sampled from Center +- Scale times each parameter's range, clipped to the range.  The donut hole has to stay inside the movement disk.
+ */
+static JoystickTuning MakeCandidate(const JoystickTuning& Center, float Scale, uint32_t& RandomState)
+{
+    JoystickTuning Tuning = Center;
+    for (int i = 0; i < TunedParameterCount; i++) {
+        const TunedParameter& Parameter = TunedParameters[i];
+        float HalfWidth = (Parameter.Max - Parameter.Min) * 0.5f * Scale;
+        float Middle = Scale >= 1.f ? (Parameter.Min + Parameter.Max) * 0.5f : Center.*Parameter.Field;
+        float Value = Middle + (NextUniform(RandomState) * 2.f - 1.f) * HalfWidth;
+        Tuning.*Parameter.Field = std::min(Parameter.Max, std::max(Parameter.Min, Value));
+    }
+    Tuning.MovementDiskDonutHoleRadius = std::min(Tuning.MovementDiskDonutHoleRadius, Tuning.MovementDiskRadius * 0.5f);
+    return Tuning;
+}
+
+static bool CandidateLess(const Candidate& A, const Candidate& B)
+{
+    return A.Score.Total < B.Score.Total;
+}
+
+static void PrintScore(const char* Label, const CandidateScore& Score)
+{
+    printf("%-10s score %8.4f  jitter %.4f  stability %.3f  dead zone %.4f  range %.4f  coverage %.4f  false activation %.4f  activated %.1f%%\n",
+           Label, Score.Total, Score.Jitter, Score.Stability, Score.DeadZone, Score.Range, Score.Coverage, Score.FalseActivation, Score.ActivatedShare * 100.f);
+}
+
+/*
+ Writes the best tuning with the hand space and filter settings the samples were made with, through JoystickConfigFile::Write() so the
+ keys are the ones JoystickConfigWatcher reads
+ */
+static bool WriteIni(const char* Path, const Candidate& Best, const Candidate& Defaults, bool Filter, size_t TraceCount, size_t CandidateCount)
+{
+    JoystickConfig Config;
+    Config.Tuning = Best.Tuning;
+    Config.HandSpace = HeadlessInputPath().Settings;
+    Config.Filter.Enabled = Filter;
+    char Comment[256];
+    snprintf(Comment, sizeof(Comment), "written by JoystickAutoTuner from %zu traces and %zu candidates\nscore %.4f, default tuning %.4f (lower is better)",
+             TraceCount, CandidateCount, Best.Score.Total, Defaults.Score.Total);
+    return JoystickConfigFile::Write(Path, Config, Comment);
+}
+
+int main(int argc, char** argv)
+{
+    size_t CandidateCount = 4096;
+    int Rounds = 3;
+    uint32_t Seed = 1;
+    int ThreadCount = 0;
+    bool Filter = false;
+    const char* OutPath = "tuned_joystick.ini";
+    ScoringSettings Settings;
+    std::vector<TraceData> Traces;
+    bool BadArguments = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--candidates") == 0 && i + 1 < argc) {
+            CandidateCount = (size_t)atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            Rounds = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            Seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            ThreadCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--filter") == 0) {
+            Filter = true;
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            OutPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--rest-radius") == 0 && i + 1 < argc) {
+            Settings.RestRadius = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--move-radius") == 0 && i + 1 < argc) {
+            Settings.MoveRadius = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--rest-angle") == 0 && i + 1 < argc) {
+            Settings.RestAngle = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--move-angle") == 0 && i + 1 < argc) {
+            Settings.MoveAngle = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--drop-height") == 0 && i + 1 < argc) {
+            Settings.DropHeight = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--min-hold") == 0 && i + 1 < argc) {
+            Settings.MinHoldFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--saturation-target") == 0 && i + 1 < argc) {
+            Settings.SaturationTarget = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--jitter-weight") == 0 && i + 1 < argc) {
+            Settings.JitterWeight = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--stability-weight") == 0 && i + 1 < argc) {
+            Settings.StabilityWeight = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dead-zone-weight") == 0 && i + 1 < argc) {
+            Settings.DeadZoneWeight = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--range-weight") == 0 && i + 1 < argc) {
+            Settings.RangeWeight = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--coverage-weight") == 0 && i + 1 < argc) {
+            Settings.CoverageWeight = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--false-activation-weight") == 0 && i + 1 < argc) {
+            Settings.FalseActivationWeight = (float)atof(argv[++i]);
+        }
+        else if (argv[i][0] == '-') {
+            BadArguments = true;
+            break;
+        }
+        else {
+            TraceData Trace;
+            Trace.Path = argv[i];
+            Traces.push_back(Trace);
+        }
+    }
+    if (BadArguments || Traces.empty() || CandidateCount == 0 || Rounds < 1) {
+        fprintf(stderr, "usage: %s [--candidates N] [--rounds N] [--seed N] [--threads N] [--filter] [--out tuned.ini]\n"
+                        "          [--rest-radius CM] [--move-radius CM] [--rest-angle DEG] [--move-angle DEG] [--drop-height CM] [--min-hold FRAMES] [--saturation-target F]\n"
+                        "          [--jitter-weight W] [--stability-weight W] [--dead-zone-weight W] [--range-weight W] [--coverage-weight W] [--false-activation-weight W]\n"
+                        "          trace.ljhf [trace.ljhf ...]\n", argv[0]);
+        return 2;
+    }
+
+    JobThreadPool Pool(ThreadCount);
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    std::pair<std::vector<TraceData>*, bool> Load(&Traces, Filter);
+    Pool.ParallelFor(Traces.size(), 1, &LoadTraceRange, &Load);
+    uint64_t FrameCount = 0;
+    for (size_t i = 0; i < Traces.size(); i++) {
+        if (!Traces[i].Loaded) {
+            fprintf(stderr, "could not open %s\n", Traces[i].Path.c_str());
+            return 1;
+        }
+        FrameCount += Traces[i].Samples.size();
+    }
+    double LoadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    printf("%zu traces, %llu frames loaded in %.2f s, %d threads\n", Traces.size(), (unsigned long long)FrameCount, LoadSeconds, Pool.GetThreadCount());
+
+    std::vector<Candidate> Candidates(CandidateCount);
+    EvaluationContext Evaluation;
+    Evaluation.Traces = &Traces;
+    Evaluation.Settings = &Settings;
+    Evaluation.Candidates = &Candidates[0];
+    Candidate Defaults;
+    Candidate Best;
+    uint32_t RandomState = Seed != 0 ? Seed : 1;
+    float Scale = 1.f;
+    Start = std::chrono::steady_clock::now();
+    for (int Round = 0; Round < Rounds; Round++) {
+        for (size_t i = 0; i < CandidateCount; i++) {
+            Candidates[i].Tuning = MakeCandidate(Best.Tuning, Scale, RandomState);
+        }
+        // the defaults in round 1, the best so far in the others, so the best never gets worse
+        Candidates[0].Tuning = Best.Tuning;
+        Pool.ParallelFor(CandidateCount, 4, &EvaluateRange, &Evaluation);
+        if (Round == 0) {
+            Defaults = Candidates[0];
+        }
+        Best = *std::min_element(Candidates.begin(), Candidates.end(), &CandidateLess);
+        printf("round %d: best score %.4f\n", Round + 1, Best.Score.Total);
+        Scale *= 0.5f;
+    }
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    size_t Evaluated = CandidateCount * (size_t)Rounds;
+    printf("%zu candidates in %.2f s, %.0f candidates/s, %.0f candidate frames/s\n", Evaluated, Seconds, (double)Evaluated / Seconds,
+           (double)Evaluated * (double)FrameCount / Seconds);
+
+    PrintScore("defaults", Defaults.Score);
+    PrintScore("best", Best.Score);
+    for (int i = 0; i < TunedParameterCount; i++) {
+        printf("    %-28s %8.3f -> %8.3f\n", TunedParameters[i].Name, Defaults.Tuning.*TunedParameters[i].Field, Best.Tuning.*TunedParameters[i].Field);
+    }
+    for (int i = 0; i < TunedParameterCount; i++) {
+        const TunedParameter& Parameter = TunedParameters[i];
+        float Value = Best.Tuning.*Parameter.Field;
+        float Margin = (Parameter.Max - Parameter.Min) * 1e-3f;
+        if (Value <= Parameter.Min + Margin || Value >= Parameter.Max - Margin) {
+            printf("warning: %s is at the %s of its range [%g, %g], the search could not go further\n", Parameter.Name,
+                   Value <= Parameter.Min + Margin ? "minimum" : "maximum", Parameter.Min, Parameter.Max);
+        }
+    }
+    if (!WriteIni(OutPath, Best, Defaults, Filter, Traces.size(), Evaluated)) {
+        fprintf(stderr, "could not write %s\n", OutPath);
+        return 1;
+    }
+    printf("written to %s\n", OutPath);
+    return 0;
+}
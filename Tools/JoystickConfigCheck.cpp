@@ -0,0 +1,274 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+/*
+ Checks JoystickConfig.h without the engine: a config written by JoystickConfigFile::Write() loads back bit for bit, partial files keep the base
+ values, malformed or invalid files are rejected with a reason (and a later success clears it), and a JoystickConfigWatcher publishes a changed
+ file, keeps the last good snapshot when the file breaks and reports why.
+ 
+ Build (from the Tools directory):
+     g++ -O2 -std=c++11 -pthread -I.. JoystickConfigCheck.cpp -o JoystickConfigCheck
+ 
+ Usage:
+     JoystickConfigCheck [--file PATH]
+ 
+ PATH is the scratch ini file the checks write and watch (JoystickConfigCheck.ini in the current directory by default); it is removed at the end.
+ Every failed check is printed and the tool exits with status 1.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include "JoystickConfig.h"
+
+static int Failures = 0;
+
+static void Check(bool Condition, const char* What)
+{
+    if (!Condition) {
+        fprintf(stderr, "FAILED: %s\n", What);
+        Failures++;
+    }
+}
+
+static bool SameFloat(float A, float B)
+{
+    return memcmp(&A, &B, sizeof(float)) == 0;
+}
+
+static bool SameVector(const JoystickVector& A, const JoystickVector& B)
+{
+    return SameFloat(A.X, B.X) && SameFloat(A.Y, B.Y) && SameFloat(A.Z, B.Z);
+}
+
+/*
+ Bitwise comparison of every field the ini file holds
+ */
+static bool SameConfig(const JoystickConfig& A, const JoystickConfig& B)
+{
+    const JoystickTuning& TA = A.Tuning;
+    const JoystickTuning& TB = B.Tuning;
+    return SameFloat(TA.ActivationDiskRadius, TB.ActivationDiskRadius) && SameFloat(TA.MovementDiskHeight, TB.MovementDiskHeight) &&
+           SameFloat(TA.MovementDiskRadius, TB.MovementDiskRadius) && SameFloat(TA.MovementDiskDonutHoleRadius, TB.MovementDiskDonutHoleRadius) &&
+           SameFloat(TA.TurnAngleThreshold, TB.TurnAngleThreshold) && SameFloat(TA.TurnRateOffset, TB.TurnRateOffset) &&
+           SameFloat(TA.MaxTurnRate, TB.MaxTurnRate) && SameFloat(TA.TurnAngleToRateScale, TB.TurnAngleToRateScale) &&
+           SameFloat(TA.DeactivationBufferHeight, TB.DeactivationBufferHeight) && SameFloat(TA.SpeedScalingFactor, TB.SpeedScalingFactor) &&
+           SameVector(TA.ActivationDiskLocation, TB.ActivationDiskLocation) &&
+           SameFloat(A.HandSpace.LeapToUnrealScalingFactor, B.HandSpace.LeapToUnrealScalingFactor) &&
+           SameVector(A.HandSpace.LeapMountOffset, B.HandSpace.LeapMountOffset) && SameVector(A.HandSpace.LeapHandOffset, B.HandSpace.LeapHandOffset) &&
+           A.Filter.Enabled == B.Filter.Enabled && SameFloat(A.Filter.MinCutoff, B.Filter.MinCutoff) && SameFloat(A.Filter.Beta, B.Filter.Beta) &&
+           SameFloat(A.Filter.DerivativeCutoff, B.Filter.DerivativeCutoff) && SameFloat(A.Filter.PredictionSeconds, B.Filter.PredictionSeconds) &&
+           A.DrawSimpleHands == B.DrawSimpleHands;
+}
+
+/*
+ A valid config where every key differs from the default, with values that have no short decimal form so the written precision is tested too
+ */
+static JoystickConfig MakeChangedConfig()
+{
+    JoystickConfig Config;
+    JoystickTuning& Tuning = Config.Tuning;
+    Tuning.ActivationDiskRadius = 21.3f / 3.f;
+    Tuning.MovementDiskHeight = 0.1f;
+    Tuning.MovementDiskRadius = 11.f / 7.f + 10.f;
+    Tuning.MovementDiskDonutHoleRadius = 2.f / 3.f;
+    Tuning.TurnAngleThreshold = 12.345678f;
+    Tuning.TurnRateOffset = -0.3f;
+    Tuning.MaxTurnRate = 1.f / 3.f;
+    Tuning.TurnAngleToRateScale = 5.5e-3f;
+    Tuning.DeactivationBufferHeight = 9.87654f;
+    Tuning.SpeedScalingFactor = 1.7f;
+    Tuning.ActivationDiskLocation.X = 61.1f;
+    Tuning.ActivationDiskLocation.Y = -1e-7f;
+    Tuning.ActivationDiskLocation.Z = 44.4f;
+    Config.HandSpace.LeapToUnrealScalingFactor = 0.11f;
+    Config.HandSpace.LeapMountOffset.X = 149.9f;
+    Config.HandSpace.LeapMountOffset.Y = 0.7f;
+    Config.HandSpace.LeapMountOffset.Z = -20.2f;
+    Config.HandSpace.LeapHandOffset.X = 10.1f;
+    Config.HandSpace.LeapHandOffset.Y = -0.2f;
+    Config.HandSpace.LeapHandOffset.Z = 45.3f;
+    Config.Filter.Enabled = true;
+    Config.Filter.MinCutoff = 1.3f;
+    Config.Filter.Beta = 0.07f;
+    Config.Filter.DerivativeCutoff = 1.1f;
+    Config.Filter.PredictionSeconds = 0.015f;
+    Config.DrawSimpleHands = false;
+    return Config;
+}
+
+static bool WriteText(const char* Path, const char* Text)
+{
+    FILE* File = fopen(Path, "w");
+    if (File == nullptr) {
+        return false;
+    }
+    fputs(Text, File);
+    return fclose(File) == 0;
+}
+
+/*
+ Polls Condition every few milliseconds for up to two seconds
+ */
+template <typename TCondition>
+static bool WaitFor(TCondition Condition)
+{
+    for (int i = 0; i < 400; i++) {
+        if (Condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return Condition();
+}
+
+static void CheckRoundTrip(const char* Path)
+{
+    JoystickConfig Written = MakeChangedConfig();
+    std::string Error;
+    Check(JoystickConfigFile::Validate(Written, Error), "the changed test config is valid");
+    Check(JoystickConfigFile::Write(Path, Written), "Write() creates the file");
+    JoystickConfig Loaded;
+    Error = "stale";
+    Check(JoystickConfigFile::Load(Path, JoystickConfig(), Loaded, Error), "a written config loads");
+    Check(Error.empty(), "Load() clears OutError on success");
+    Check(SameConfig(Loaded, Written), "a written config loads back bit for bit");
+
+    // the defaults as well, they are what a fresh file from Write() holds
+    Check(JoystickConfigFile::Write(Path, JoystickConfig()), "Write() of the defaults");
+    Check(JoystickConfigFile::Load(Path, Written, Loaded, Error) && SameConfig(Loaded, JoystickConfig()), "the defaults load back bit for bit");
+}
+
+static void CheckPartial()
+{
+    JoystickConfig Base = MakeChangedConfig();
+    JoystickConfig Parsed;
+    std::string Error;
+    const char* Text = "; only the radius\n  [VirtualJoystick3D]  \r\nActivationDiskRadius = 25\n\n# and the filter\n[HandFilter]\nEnabled=0\n";
+    Check(JoystickConfigFile::Parse(Text, Base, Parsed, Error), "a partial file with comments and whitespace parses");
+    JoystickConfig Expected = Base;
+    Expected.Tuning.ActivationDiskRadius = 25.f;
+    Expected.Filter.Enabled = false;
+    Check(SameConfig(Parsed, Expected), "keys left out of a file keep the base values");
+}
+
+static void CheckRejects()
+{
+    struct RejectCase
+    {
+        const char* Text;
+        const char* Error; // expected to be part of OutError
+    };
+    static const RejectCase Cases[] = {
+        { "[VirtualJoystick3D\nActivationDiskRadius=20\n", "line 1: unterminated section name" },
+        { "[VirtualJoystick3D]\nActivationDiskRadius\n", "line 2: expected Key=Value" },
+        { "[VirtualJoystick3D]\nActivationDiskRadiuss=20\n", "unknown key ActivationDiskRadiuss" },
+        { "[LeapInputReader]\nActivationDiskRadius=20\n", "unknown key ActivationDiskRadius in section [LeapInputReader]" },
+        { "ActivationDiskRadius=20\n", "unknown key ActivationDiskRadius in section []" },
+        { "[VirtualJoystick3D]\nActivationDiskRadius=20cm\n", "bad value for ActivationDiskRadius" },
+        { "[VirtualJoystick3D]\nActivationDiskRadius=\n", "bad value for ActivationDiskRadius" },
+        { "[VirtualJoystick3D]\nActivationDiskRadius=nan\n", "bad value for ActivationDiskRadius" },
+        { "[HandFilter]\nEnabled=yes\n", "bad value for Enabled" },
+        { "[VirtualJoystick3D]\nMaxTurnRate=inf\n", "MaxTurnRate must be a finite number" },
+        { "[VirtualJoystick3D]\nActivationDiskRadius=0\n", "ActivationDiskRadius must be greater than 0" },
+        { "[VirtualJoystick3D]\nMovementDiskDonutHoleRadius=10\n", "MovementDiskDonutHoleRadius must be at least 0" },
+        { "[VirtualJoystick3D]\nTurnAngleThreshold=180\n", "TurnAngleThreshold must be between 0 and 180" },
+        { "[LeapInputReader]\nLeapToUnrealScalingFactor=-0.1\n", "LeapToUnrealScalingFactor must be greater than 0" },
+        { "[HandFilter]\nMinCutoff=0\n", "MinCutoff and DerivativeCutoff must be greater than 0" },
+        { "[HandFilter]\nPredictionSeconds=-0.01\n", "Beta and PredictionSeconds must not be negative" },
+    };
+    for (size_t i = 0; i < sizeof(Cases) / sizeof(Cases[0]); i++) {
+        JoystickConfig Parsed;
+        std::string Error;
+        bool Accepted = JoystickConfigFile::Parse(Cases[i].Text, JoystickConfig(), Parsed, Error);
+        if (Accepted || Error.find(Cases[i].Error) == std::string::npos) {
+            fprintf(stderr, "FAILED: expected \"%s\", got %s \"%s\" for:\n%s", Cases[i].Error, Accepted ? "success" : "error", Error.c_str(), Cases[i].Text);
+            Failures++;
+        }
+    }
+
+    JoystickConfig Loaded;
+    std::string Error;
+    Check(!JoystickConfigFile::Load("JoystickConfigCheck-missing.ini", JoystickConfig(), Loaded, Error) && Error.find("could not open") == 0,
+          "Load() of a missing file fails with a reason");
+    Check(JoystickConfigFile::Parse("[HandFilter]\nEnabled=true\n", JoystickConfig(), Loaded, Error) && Error.empty(), "Parse() clears OutError on success");
+}
+
+static void CheckWatcher(const char* Path)
+{
+    Check(WriteText(Path, "[VirtualJoystick3D]\nActivationDiskRadius=21\n"), "writing the watched file");
+    JoystickConfigStore Store;
+    JoystickConfigWatcher Watcher(&Store, Path, 10);
+    // the first load happens in the constructor
+    Check(Watcher.GetLoadCount() == 1 && Store.Get()->Generation == 1 && Store.Get()->Tuning.ActivationDiskRadius == 21.f,
+          "the watcher publishes the file before its constructor returns");
+
+    Check(WriteText(Path, "[VirtualJoystick3D]\nActivationDiskRadius=22\n"), "rewriting the watched file");
+    Check(WaitFor([&]() { return Watcher.GetLoadCount() == 2; }), "the watcher reloads a changed file");
+    Check(Store.Get()->Generation == 2 && Store.Get()->Tuning.ActivationDiskRadius == 22.f, "the reloaded file is the current snapshot");
+    Check(Watcher.GetLastError().empty(), "no error after a good reload");
+
+    Check(WriteText(Path, "[VirtualJoystick3D]\nActivationDiskRadius=-1\n"), "breaking the watched file");
+    Check(WaitFor([&]() { return !Watcher.GetLastError().empty(); }), "the watcher reports a file that fails to validate");
+    Check(Watcher.GetLoadCount() == 2 && Store.Get()->Generation == 2 && Store.Get()->Tuning.ActivationDiskRadius == 22.f,
+          "a broken file keeps the last good snapshot");
+
+    Check(WriteText(Path, "[VirtualJoystick3D]\nActivationDiskRadius=23\n"), "fixing the watched file");
+    Check(WaitFor([&]() { return Watcher.GetLoadCount() == 3; }), "the watcher reloads a fixed file");
+    Check(Store.Get()->Tuning.ActivationDiskRadius == 23.f && Watcher.GetLastError().empty(), "a fixed file is applied and clears the error");
+}
+
+int main(int argc, char** argv)
+{
+    const char* Path = "JoystickConfigCheck.ini";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+            Path = argv[++i];
+        }
+        else {
+            fprintf(stderr, "usage: %s [--file PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    CheckRoundTrip(Path);
+    CheckPartial();
+    CheckRejects();
+    CheckWatcher(Path);
+    remove(Path);
+
+    if (Failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", Failures);
+        return 1;
+    }
+    printf("all config checks passed\n");
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+/*
+ Throughput benchmark for VirtualJoystickManager: how many joysticks per second one Update() pass evaluates with 1, 2, 4, ... threads.
+ Every joystick gets its own synthetic hand path (some inside the activation disk, some outside), so activation, speed and turn math all run.
+ 
+ Build (from the Tools directory):
+     g++ -O2 -std=c++11 -pthread -I.. JoystickManagerBenchmark.cpp -o JoystickManagerBenchmark
+ 
+ Usage:
+     JoystickManagerBenchmark [--joysticks N] [--frames N] [--max-threads N] [--chunk N]
+ 
+ For each thread count it prints ns per Update(), joysticks per second and the speed-up over one thread.
+ After every timed Update() the outputs are compared bit for bit with VirtualJoystickCore::Evaluate() run on each joystick alone;
+ any difference is reported and the benchmark exits with status 1.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "JoystickManager.h"
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+/*
+ Hand sample of joystick Index at Frame: the palm circles around a point near the activation disk and the middle finger tilts left and right
+ */
+static JoystickSample MakeSample(const JoystickTuning& Tuning, size_t Index, int Frame)
+{
+    float Phase = (float)(Index % 97) * 0.37f + (float)Frame * 0.05f;
+    float Radius = 4.f + (float)(Index % 7) * 2.f;
+    JoystickSample Sample;
+    Sample.PalmLocation.X = Tuning.ActivationDiskLocation.X + Radius * cosf(Phase);
+    Sample.PalmLocation.Y = Tuning.ActivationDiskLocation.Y + Radius * sinf(Phase);
+    Sample.PalmLocation.Z = Tuning.ActivationDiskLocation.Z - 3.f;
+    Sample.FingerLocation.X = Sample.PalmLocation.X + 9.f;
+    Sample.FingerLocation.Y = Sample.PalmLocation.Y + 4.f * sinf(Phase * 0.5f);
+    Sample.FingerLocation.Z = Tuning.ActivationDiskLocation.Z + 2.f * cosf(Phase * 0.3f);
+    return Sample;
+}
+
+static bool SameFloat(float A, float B)
+{
+    return memcmp(&A, &B, sizeof(float)) == 0;
+}
+
+/*
+ Bitwise comparison, so a batched result that differs only in the last bit or in NaN payload still counts as a mismatch
+ */
+static bool SameOutput(const JoystickOutput& A, const JoystickOutput& B)
+{
+    return A.IsActivated == B.IsActivated && SameFloat(A.ForwardMovement, B.ForwardMovement) && SameFloat(A.RightMovement, B.RightMovement) && SameFloat(A.TurnRate, B.TurnRate);
+}
+
+int main(int argc, char** argv)
+{
+    size_t JoystickCount = 100000;
+    int FrameCount = 200;
+    int MaxThreads = (int)std::thread::hardware_concurrency();
+    size_t ChunkSize = 1024;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--joysticks") == 0 && i + 1 < argc) {
+            JoystickCount = (size_t)atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            FrameCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+            MaxThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            ChunkSize = (size_t)atol(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "usage: %s [--joysticks N] [--frames N] [--max-threads N] [--chunk N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (MaxThreads < 1) {
+        MaxThreads = 1;
+    }
+
+    JoystickTuning Tuning;
+    VirtualJoystickManager Manager;
+    Manager.Reserve(JoystickCount);
+    for (size_t i = 0; i < JoystickCount; i++) {
+        Manager.AddJoystick(Tuning);
+    }
+
+    // samples for every frame are generated up front so only Update() is timed
+    const int SampleFrames = 16;
+    std::vector<JoystickSample> Samples(JoystickCount * SampleFrames);
+    for (int Frame = 0; Frame < SampleFrames; Frame++) {
+        for (size_t i = 0; i < JoystickCount; i++) {
+            Samples[Frame * JoystickCount + i] = MakeSample(Tuning, i, Frame);
+        }
+    }
+
+    // reference states advanced by the single-joystick path, untimed
+    std::vector<JoystickState> ReferenceStates(JoystickCount);
+    size_t Mismatches = 0;
+
+    printf("%zu joysticks, %d frames, chunk %zu\n", JoystickCount, FrameCount, ChunkSize);
+    printf("%-8s %14s %16s %9s\n", "threads", "ns/update", "joysticks/s", "speed-up");
+    double SingleThreadNs = 0.0;
+    for (int ThreadCount = 1;; ThreadCount = ThreadCount * 2 < MaxThreads ? ThreadCount * 2 : MaxThreads) {
+        JobThreadPool Pool(ThreadCount);
+        int64_t TotalNs = 0;
+        for (int Frame = 0; Frame < FrameCount; Frame++) {
+            const JoystickSample* FrameSamples = &Samples[(Frame % SampleFrames) * JoystickCount];
+            for (size_t i = 0; i < JoystickCount; i++) {
+                Manager.SetSample(i, FrameSamples[i]);
+            }
+            BenchmarkClock::time_point Start = BenchmarkClock::now();
+            Manager.Update(&Pool, ChunkSize);
+            TotalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock::now() - Start).count();
+            for (size_t i = 0; i < JoystickCount; i++) {
+                JoystickOutput Expected = VirtualJoystickCore::Evaluate(Tuning, ReferenceStates[i], FrameSamples[i]);
+                if (!SameOutput(Manager.GetOutput(i), Expected)) {
+                    if (Mismatches < 10) {
+                        fprintf(stderr, "mismatch: %d threads, frame %d, joystick %zu\n", ThreadCount, Frame, i);
+                    }
+                    Mismatches++;
+                }
+            }
+        }
+        double NsPerUpdate = (double)TotalNs / FrameCount;
+        if (ThreadCount == 1) {
+            SingleThreadNs = NsPerUpdate;
+        }
+        printf("%-8d %14.0f %16.3e %8.2fx\n", ThreadCount, NsPerUpdate, JoystickCount * 1e9 / NsPerUpdate, SingleThreadNs / NsPerUpdate);
+        if (ThreadCount == MaxThreads) {
+            break;
+        }
+    }
+
+    // quick check that the hand paths really exercise the activated branch
+    int Activated = 0;
+    for (size_t i = 0; i < JoystickCount; i++) {
+        Activated += Manager.GetOutput(i).IsActivated ? 1 : 0;
+    }
+    printf("%d of %zu joysticks activated after the last frame\n", Activated, JoystickCount);
+    if (Mismatches > 0) {
+        fprintf(stderr, "FAILED: %zu batched outputs differ from single-joystick Evaluate()\n", Mismatches);
+        return 1;
+    }
+    printf("batched outputs match single-joystick Evaluate()\n");
+    return 0;
+}
@@ -0,0 +1,426 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+/*
+ Loopback benchmark of the joystick replication (JoystickReplication.h) over real UDP sockets.  A sender thread runs the headless input path on
+ synthetic hands at the input rate, pushes every output (and optionally the quantized hand pose) into a JoystickReplicationSender and sends its
+ packets to 127.0.0.1; a receiver thread decodes them into a JoystickReplicationReceiver and samples it at the input rate, like a server tick.
+ 
+ Build (from the Tools directory, Linux / macOS):
+     g++ -O2 -std=c++11 -pthread -I.. ReplicationBenchmark.cpp -o ReplicationBenchmark
+ 
+ Usage:
+     ReplicationBenchmark [--seconds S] [--input-hz HZ] [--send-hz HZ] [--redundancy N] [--budget BYTES_PER_S] [--pose] [--loss PERCENT] [--delay-ms MS]
+ 
+ Reports bytes per second for one player (payload and with UDP/IPv4 headers), frames per packet, the push to decode age of every frame on its
+ first arrival and of the oldest new frame in each packet (coalescing plus transport), the latency from push to playout (the later of the
+ arrival and the playout delay behind the sender clock), how often playout had to extrapolate, and the largest difference between the played
+ out and the sent outputs at the same sender time.
+ --loss drops that share of packets before sending to show what the redundancy recovers.
+ Exits with 1 if, with --pose, a decoded pose differs from the one sent for that frame (or none arrives), if the payload used more than the
+ byte budget over the run plus one full bucket, or if a NaN or infinite output is not replicated as 0.
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "HandPoseQuantization.h"
+#include "HeadlessInputPath.h"
+#include "JoystickReplication.h"
+#include "SyntheticHandTrackingSource.h"
+
+static int64_t NowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void SleepUntil(int64_t Micros)
+{
+    int64_t Remaining = Micros - NowMicros();
+    if (Remaining > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(Remaining));
+    }
+}
+
+struct BenchmarkOptions
+{
+    double Seconds;
+    double InputHz;
+    double SendHz;
+    int Redundancy;
+    float Budget;
+    bool Pose;
+    double LossPercent;
+    int DelayMs;
+};
+
+/*
+ What the sender produced, so the receiver side can compare its playout with the truth.  Written by the sender before the frame's packet
+ goes out and only read for sequences the receiver has seen, so there is no race on an entry.
+ */
+struct SentFrame
+{
+    int64_t Timestamp;
+    JoystickOutput Output;
+};
+
+struct SharedState
+{
+    BenchmarkOptions Options;
+    int SenderSocket;
+    int ReceiverSocket;
+    sockaddr_in ReceiverAddress;
+    std::vector<SentFrame> Sent;
+    std::vector<QuantizedHandFrameRecord> SentPoses; // with --pose, the quantized pose of every frame
+    std::atomic<uint32_t> SentCount;
+    std::atomic<bool> SenderDone;
+    JoystickReplicationSenderStats SenderStats;
+    double SenderSeconds; // from the first to the last Poll(), what the budget accrued over
+    float SenderBurstBytes;
+    uint64_t PacketsDropped;
+};
+
+/*
+ True if the received pose has the same quantized hand fields as the one the sender set for that frame (timestamp and frame id are not sent)
+ */
+static bool SamePose(const QuantizedHandFrameRecord& Received, const QuantizedHandFrameRecord& Sent)
+{
+    int64_t ReceivedFields[HAND_MOTION_LOG_FIELD_COUNT];
+    int64_t SentFields[HAND_MOTION_LOG_FIELD_COUNT];
+    HandMotionLogCodec::ToFields(Received, ReceivedFields);
+    HandMotionLogCodec::ToFields(Sent, SentFields);
+    return memcmp(ReceivedFields + 2, SentFields + 2, JOYSTICK_REPLICATION_POSE_FIELD_COUNT * sizeof(int64_t)) == 0;
+}
+
+static void RunSender(SharedState& Shared)
+{
+    const BenchmarkOptions& Options = Shared.Options;
+    JoystickReplicationSender Sender;
+    Sender.SendIntervalMicros = (int64_t)(1e6 / Options.SendHz);
+    Sender.Redundancy = (uint32_t)Options.Redundancy;
+    Sender.MaxBytesPerSecond = Options.Budget;
+    SyntheticHandTrackingSource Source;
+    Source.Hands[HAND_LEFT].Motion = SYNTHETIC_CIRCLE;
+    Source.Hands[HAND_LEFT].Amplitude[0] = 60.f;
+    Source.Hands[HAND_LEFT].Jitter = 1.f;
+    HeadlessInputPath Path;
+    QuantizedHandFrameRecord Pose;
+    uint8_t Packet[JOYSTICK_REPLICATION_MAX_PACKET_BYTES];
+    uint32_t RandomState = 12345;
+    Shared.PacketsDropped = 0;
+    int64_t FirstTimestamp = 0, LastTimestamp = 0;
+
+    int64_t Interval = (int64_t)(1e6 / Options.InputHz);
+    int64_t Start = NowMicros();
+    size_t FrameCount = Shared.Sent.size();
+    for (size_t FrameIndex = 0; FrameIndex < FrameCount; FrameIndex++) {
+        SleepUntil(Start + (int64_t)FrameIndex * Interval);
+        const HandFrameRecord& Frame = *Source.ReadFrame();
+        JoystickOutput Output = Path.Update(Frame);
+        int64_t Timestamp = NowMicros();
+        Shared.Sent[FrameIndex].Timestamp = Timestamp;
+        Shared.Sent[FrameIndex].Output = Output;
+        if (Options.Pose) {
+            HandPoseQuantization::QuantizeFrame(Frame, Pose);
+            Shared.SentPoses[FrameIndex] = Pose;
+        }
+        Shared.SentCount.store((uint32_t)FrameIndex + 1, std::memory_order_release);
+        Sender.PushFrame(Timestamp, Output);
+        if (Options.Pose) {
+            Sender.SetPose(Pose);
+        }
+        if (FrameIndex == 0) {
+            FirstTimestamp = Timestamp;
+        }
+        LastTimestamp = Timestamp;
+        // more than one packet is due when a packet's worth of frames piled up
+        size_t Size;
+        while ((Size = Sender.Poll(Timestamp, Packet)) != 0) {
+            RandomState ^= RandomState << 13;
+            RandomState ^= RandomState >> 17;
+            RandomState ^= RandomState << 5;
+            if ((double)(RandomState % 10000) < Options.LossPercent * 100.0) {
+                Shared.PacketsDropped++;
+                continue;
+            }
+            sendto(Shared.SenderSocket, Packet, Size, 0, (const sockaddr*)&Shared.ReceiverAddress, sizeof(Shared.ReceiverAddress));
+        }
+    }
+    Shared.SenderStats = Sender.GetStats();
+    Shared.SenderSeconds = (double)(LastTimestamp - FirstTimestamp) * 1e-6;
+    Shared.SenderBurstBytes = Sender.GetBurstBytes();
+    Shared.SenderDone.store(true);
+}
+
+/*
+ Sent forward movement at sender time Timestamp, interpolated like the receiver does.  Only reads entries the sender already published.
+ */
+static float SentForwardAt(const SharedState& Shared, int64_t Timestamp)
+{
+    uint32_t Count = Shared.SentCount.load(std::memory_order_acquire);
+    if (Count == 0) {
+        return 0.f;
+    }
+    size_t After = 0;
+    while (After < Count && Shared.Sent[After].Timestamp <= Timestamp) {
+        After++;
+    }
+    if (After == 0) {
+        return Shared.Sent[0].Output.ForwardMovement;
+    }
+    const SentFrame& Before = Shared.Sent[After - 1];
+    if (After == Count || Before.Output.IsActivated != Shared.Sent[After].Output.IsActivated) {
+        return Before.Output.ForwardMovement;
+    }
+    const SentFrame& Next = Shared.Sent[After];
+    float Blend = (float)(Timestamp - Before.Timestamp) / (float)(Next.Timestamp - Before.Timestamp);
+    return Before.Output.ForwardMovement + (Next.Output.ForwardMovement - Before.Output.ForwardMovement) * Blend;
+}
+
+static double Percentile(std::vector<int64_t>& Values, double Fraction)
+{
+    if (Values.empty()) {
+        return 0.0;
+    }
+    size_t Index = (size_t)(Fraction * (double)(Values.size() - 1));
+    std::nth_element(Values.begin(), Values.begin() + Index, Values.end());
+    return (double)Values[Index];
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions Options;
+    Options.Seconds = 5.0;
+    Options.InputHz = 90.0;
+    Options.SendHz = 30.0;
+    Options.Redundancy = 3;
+    Options.Budget = 8000.f;
+    Options.Pose = false;
+    Options.LossPercent = 0.0;
+    Options.DelayMs = 50;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            Options.Seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--input-hz") == 0 && i + 1 < argc) {
+            Options.InputHz = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--send-hz") == 0 && i + 1 < argc) {
+            Options.SendHz = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--redundancy") == 0 && i + 1 < argc) {
+            Options.Redundancy = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            Options.Budget = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--pose") == 0) {
+            Options.Pose = true;
+        }
+        else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            Options.LossPercent = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--delay-ms") == 0 && i + 1 < argc) {
+            Options.DelayMs = atoi(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "usage: %s [--seconds S] [--input-hz HZ] [--send-hz HZ] [--redundancy N] [--budget BYTES_PER_S] [--pose] [--loss PERCENT] [--delay-ms MS]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (Options.InputHz <= 0.0 || Options.SendHz <= 0.0 || Options.Seconds <= 0.0 || Options.Redundancy < 0) {
+        fprintf(stderr, "rates, duration and redundancy must be positive\n");
+        return 2;
+    }
+
+    SharedState Shared;
+    Shared.Options = Options;
+    Shared.Sent.resize((size_t)(Options.Seconds * Options.InputHz));
+    Shared.SentPoses.resize(Options.Pose ? Shared.Sent.size() : 0);
+    Shared.SentCount.store(0);
+    Shared.SenderDone.store(false);
+    Shared.SenderSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    Shared.ReceiverSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&Shared.ReceiverAddress, 0, sizeof(Shared.ReceiverAddress));
+    Shared.ReceiverAddress.sin_family = AF_INET;
+    Shared.ReceiverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Shared.ReceiverAddress.sin_port = 0;
+    socklen_t AddressSize = sizeof(Shared.ReceiverAddress);
+    if (Shared.SenderSocket < 0 || Shared.ReceiverSocket < 0
+        || bind(Shared.ReceiverSocket, (const sockaddr*)&Shared.ReceiverAddress, sizeof(Shared.ReceiverAddress)) != 0
+        || getsockname(Shared.ReceiverSocket, (sockaddr*)&Shared.ReceiverAddress, &AddressSize) != 0) {
+        perror("could not set up the loopback sockets");
+        return 1;
+    }
+
+    JoystickReplicationReceiver Receiver;
+    Receiver.PlayoutDelayMicros = (int64_t)Options.DelayMs * 1000;
+    std::vector<int64_t> FrameAges;        // push to decode, every frame on its first arrival
+    std::vector<int64_t> OldestFrameAges;  // push to decode of the oldest new frame, per packet
+    std::vector<int64_t> PlayoutLatencies; // push to the earliest local time playout reaches the frame, every received frame
+    std::vector<uint8_t> Arrived(Shared.Sent.size(), 0);
+    uint32_t FirstMissing = 0; // frames before this one arrived or fell out of the receiver's buffer
+    uint64_t LateFrames = 0;
+    uint64_t Ticks = 0, Extrapolated = 0;
+    float MaxPlayoutError = 0.f;
+    double PlayoutErrorSum = 0.0;
+    uint64_t PosesMatched = 0, PoseMismatches = 0;
+    bool HasCheckedPose = false;
+    uint32_t CheckedPoseSequence = 0;
+    QuantizedHandFrameRecord ReceivedPose;
+    uint8_t Packet[2048];
+    int64_t TickInterval = (int64_t)(1e6 / Options.InputHz);
+
+    std::thread SenderThread(&RunSender, std::ref(Shared));
+    int64_t NextTick = NowMicros() + TickInterval;
+    while (!Shared.SenderDone.load()) {
+        pollfd Descriptor;
+        Descriptor.fd = Shared.ReceiverSocket;
+        Descriptor.events = POLLIN;
+        int64_t Wait = (NextTick - NowMicros()) / 1000;
+        if (poll(&Descriptor, 1, Wait > 0 ? (int)Wait : 0) > 0) {
+            ssize_t Size = recv(Shared.ReceiverSocket, Packet, sizeof(Packet), 0);
+            int64_t Now = NowMicros();
+            if (Size > 0 && Receiver.Receive(Packet, (size_t)Size, Now)) {
+                // on one machine both clocks are the same, so the ages are exact.  Only frames the sender published can have arrived.
+                uint32_t Published = Shared.SentCount.load(std::memory_order_acquire);
+                int64_t OldestAge = -1;
+                for (uint32_t Sequence = FirstMissing; Sequence < Published; Sequence++) {
+                    if (Arrived[Sequence] || !Receiver.HasFrame(Sequence)) {
+                        continue;
+                    }
+                    Arrived[Sequence] = 1;
+                    int64_t Age = Now - Shared.Sent[Sequence].Timestamp;
+                    FrameAges.push_back(Age);
+                    OldestAge = std::max(OldestAge, Age);
+                    // Sample() reaches this frame ClockOffset + PlayoutDelay after it was pushed, or now if it came too late for that
+                    int64_t PlayoutAt = Receiver.GetClockOffset() + Receiver.PlayoutDelayMicros;
+                    LateFrames += Age > PlayoutAt ? 1 : 0;
+                    PlayoutLatencies.push_back(std::max(Age, PlayoutAt));
+                }
+                if (OldestAge >= 0) {
+                    OldestFrameAges.push_back(OldestAge);
+                }
+                // stop rescanning frames that arrived, or were lost and are older than the receiver keeps
+                while (FirstMissing < Published && (Arrived[FirstMissing] || Published - FirstMissing > 256)) {
+                    FirstMissing++;
+                }
+                // every newly decoded pose must match the sender's exactly, keyframe or delta
+                uint32_t PoseSequence;
+                if (Receiver.GetPose(ReceivedPose, &PoseSequence) && (!HasCheckedPose || PoseSequence != CheckedPoseSequence)) {
+                    HasCheckedPose = true;
+                    CheckedPoseSequence = PoseSequence;
+                    bool Known = PoseSequence < Shared.SentCount.load(std::memory_order_acquire);
+                    if (Known && SamePose(ReceivedPose, Shared.SentPoses[PoseSequence])) {
+                        PosesMatched++;
+                    }
+                    else {
+                        PoseMismatches++;
+                    }
+                }
+            }
+        }
+        int64_t Now = NowMicros();
+        if (Now < NextTick) {
+            continue;
+        }
+        NextTick += TickInterval;
+        JoystickReplicationSample Sample = Receiver.Sample(Now);
+        if (!Sample.Valid) {
+            continue;
+        }
+        Ticks++;
+        Extrapolated += Sample.Extrapolated ? 1 : 0;
+        float Error = fabsf(Sample.ForwardMovement - SentForwardAt(Shared, Now - Receiver.GetClockOffset() - Receiver.PlayoutDelayMicros));
+        MaxPlayoutError = fmaxf(MaxPlayoutError, Error);
+        PlayoutErrorSum += Error;
+    }
+    SenderThread.join();
+    close(Shared.SenderSocket);
+    close(Shared.ReceiverSocket);
+
+    const JoystickReplicationSenderStats& SenderStats = Shared.SenderStats;
+    const JoystickReplicationReceiverStats& ReceiverStats = Receiver.GetStats();
+    double Seconds = (double)Shared.Sent.size() / Options.InputHz;
+    double Packets = SenderStats.PacketsSent > 0 ? (double)SenderStats.PacketsSent : 1.0;
+    printf("%.0f Hz input, %.0f Hz packets, redundancy %d, budget %.0f B/s, pose %s, loss %.1f%%, playout delay %d ms\n", Options.InputHz, Options.SendHz,
+           Options.Redundancy, Options.Budget, Options.Pose ? "on" : "off", Options.LossPercent, Options.DelayMs);
+    printf("bytes per second per player: %.0f payload, %.0f with UDP/IPv4 headers\n",
+           (double)SenderStats.BytesSent / Seconds, (double)(SenderStats.BytesSent + SenderStats.PacketsSent * 28) / Seconds);
+    printf("packets: %llu sent, %llu dropped, %llu received, %.1f bytes and %.1f frames per packet, %llu deferred by the budget, %llu poses sent, %llu deferred\n",
+           (unsigned long long)SenderStats.PacketsSent, (unsigned long long)Shared.PacketsDropped, (unsigned long long)ReceiverStats.PacketsReceived,
+           (double)SenderStats.BytesSent / Packets, (double)SenderStats.FramesSent / Packets, (unsigned long long)SenderStats.PacketsDeferred,
+           (unsigned long long)SenderStats.PosesSent, (unsigned long long)SenderStats.PosesDeferred);
+    printf("frames: %zu sent, %llu skipped, %llu received, %llu lost, %llu repeats, poses received %llu (%llu without keyframe)\n", Shared.Sent.size(),
+           (unsigned long long)SenderStats.FramesSkipped, (unsigned long long)ReceiverStats.FramesReceived, (unsigned long long)ReceiverStats.FramesLost, (unsigned long long)ReceiverStats.FramesRepeated,
+           (unsigned long long)ReceiverStats.PosesReceived, (unsigned long long)ReceiverStats.PosesMissingKeyframe);
+    printf("frame age at arrival (push to decode, coalescing and transport): p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", Percentile(FrameAges, 0.5) / 1000.0,
+           Percentile(FrameAges, 0.99) / 1000.0, Percentile(FrameAges, 1.0) / 1000.0);
+    printf("oldest new frame per packet: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", Percentile(OldestFrameAges, 0.5) / 1000.0,
+           Percentile(OldestFrameAges, 0.99) / 1000.0, Percentile(OldestFrameAges, 1.0) / 1000.0);
+    printf("push to playout: p50 %.2f ms, p99 %.2f ms, max %.2f ms, %llu frames arrived after their playout time\n", Percentile(PlayoutLatencies, 0.5) / 1000.0,
+           Percentile(PlayoutLatencies, 0.99) / 1000.0, Percentile(PlayoutLatencies, 1.0) / 1000.0, (unsigned long long)LateFrames);
+    printf("playout: %llu ticks, %.2f%% extrapolated, forward error mean %.5f max %.5f\n", (unsigned long long)Ticks,
+           Ticks > 0 ? (double)Extrapolated * 100.0 / (double)Ticks : 0.0, Ticks > 0 ? PlayoutErrorSum / (double)Ticks : 0.0, MaxPlayoutError);
+
+    bool Passed = true;
+    if (Options.Pose) {
+        printf("poses: %llu decoded exactly, %llu differ from what was sent\n", (unsigned long long)PosesMatched, (unsigned long long)PoseMismatches);
+        if (PoseMismatches > 0 || PosesMatched == 0) {
+            fprintf(stderr, "FAILED: %s\n", PoseMismatches > 0 ? "received poses differ from the sent ones" : "no pose was received");
+            Passed = false;
+        }
+    }
+    // a non-finite output must replicate as no movement rather than a clamped extreme
+    const float NonFinite[] = { NAN, INFINITY, -INFINITY };
+    for (float Value : NonFinite) {
+        if (JoystickReplicationDequantize(JoystickReplicationQuantize(Value)) != 0.f) {
+            fprintf(stderr, "FAILED: a non-finite output (%f) is not replicated as 0\n", Value);
+            Passed = false;
+        }
+    }
+    // every byte is charged, the payload may use the budget over the run plus one full bucket
+    double BudgetLimit = (double)Options.Budget * Shared.SenderSeconds + Shared.SenderBurstBytes;
+    printf("budget: %llu bytes sent, limit %.0f\n", (unsigned long long)SenderStats.BytesSent, BudgetLimit);
+    if ((double)SenderStats.BytesSent > BudgetLimit) {
+        fprintf(stderr, "FAILED: the payload exceeded the byte budget\n");
+        Passed = false;
+    }
+    return Passed ? 0 : 1;
+}
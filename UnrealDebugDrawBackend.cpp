@@ -0,0 +1,62 @@
+/*****************************
+ Copyright 2015 (c) Leonardo Malave. All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are
+ permitted provided that the following conditions are met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice, this list of
+ conditions and the following disclaimer.
+ 
+ 2. Redistributions in binary form must reproduce the above copyright notice, this list
+ of conditions and the following disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY Leonardo Malave ''AS IS'' AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL Rafael Muñoz Salinas OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ The views and conclusions contained in the software and documentation are those of the
+ authors and should not be interpreted as representing official policies, either expressed
+ or implied, of Leonardo Malave.
+ ********************************/
+
+#include "OculusARPOC.h"
+#include "Engine.h"
+#include "UnrealDebugDrawBackend.h"
+
+UnrealDebugDrawBackend::UnrealDebugDrawBackend(UWorld* World)
+{
+    this->World = World;
+}
+
+void UnrealDebugDrawBackend::DrawPrimitives(const DebugDrawPrimitive* Primitives, size_t Count)
+{
+    if (World == nullptr) {
+        return;
+    }
+    for (size_t i = 0; i < Count; i++) {
+        const DebugDrawPrimitive& Primitive = Primitives[i];
+        FVector Start(Primitive.Start.X, Primitive.Start.Y, Primitive.Start.Z);
+        FVector End(Primitive.End.X, Primitive.End.Y, Primitive.End.Z);
+        FColor Color(Primitive.Color.R, Primitive.Color.G, Primitive.Color.B, Primitive.Color.A);
+        switch (Primitive.Type) {
+            case DEBUG_DRAW_SPHERE:
+                DrawDebugSphere(World, Start, Primitive.Radius, Primitive.Segments, Color);
+                break;
+            case DEBUG_DRAW_LINE:
+                DrawDebugLine(World, Start, End, Color);
+                break;
+            case DEBUG_DRAW_CYLINDER:
+                DrawDebugCylinder(World, Start, End, Primitive.Radius, Primitive.Segments, Color);
+                break;
+            default:
+                break;
+        }
+    }
+}
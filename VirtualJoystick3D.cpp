@@ -29,6 +29,7 @@
 #include "OculusUIPOC.h"
 #include "Engine.h"
 #include "VirtualJoystick3D.h"
+#include "UnrealDebugDrawBackend.h"
 
 VirtualJoystick3D::VirtualJoystick3D(ACharacter* Character)
 {
@@ -45,12 +46,12 @@ VirtualJoystick3D::VirtualJoystick3D(ACharacter* Character)
     DeactivationBufferHeight = 10.0;
     SpeedScalingFactor = 1.0;
     
-    ForwardMovement = 0.f;
-    RightMovement = 0.f;
-    TurnRate = 0.f;
-    IsActivated = false;
-    
     ActivationDiskLocation = FVector(60.0, -10.0, 45.0);
+    SpeedCurve = nullptr;
+    TurnCurve = nullptr;
+    DebugDraw = &OwnDebugDraw;
+    ConfigStore = nullptr;
+    AppliedConfig = nullptr;
 }
 
 VirtualJoystick3D::~VirtualJoystick3D()
@@ -58,109 +59,148 @@ VirtualJoystick3D::~VirtualJoystick3D()
 }
 
 float VirtualJoystick3D::GetForwardMovement() {
-    return ForwardMovement;
+    return State.ForwardMovement;
 }
 
 float VirtualJoystick3D::GetRightMovement() {
-    return RightMovement;
+    return State.RightMovement;
 }
 
 float VirtualJoystick3D::GetTurnRate() {
-    return TurnRate;
+    return State.TurnRate;
+}
+
+void VirtualJoystick3D::SetDebugDrawBuffer(DebugDrawBuffer* Buffer) {
+    DebugDraw = Buffer != nullptr ? Buffer : &OwnDebugDraw;
+}
+
+void VirtualJoystick3D::SetConfigStore(const JoystickConfigStore* Store) {
+    ConfigStore = Store;
+    AppliedConfig = nullptr;
+}
+
+void VirtualJoystick3D::ApplyConfig(const JoystickConfig& Config) {
+    const JoystickTuning& Tuning = Config.Tuning;
+    ActivationDiskRadius = Tuning.ActivationDiskRadius;
+    MovementDiskHeight = Tuning.MovementDiskHeight;
+    MovementDiskRadius = Tuning.MovementDiskRadius;
+    MovementDiskDonutHoleRadius = Tuning.MovementDiskDonutHoleRadius;
+    TurnAngleThreshold = Tuning.TurnAngleThreshold;
+    TurnRateOffset = Tuning.TurnRateOffset;
+    MaxTurnRate = Tuning.MaxTurnRate;
+    TurnAngleToRateScale = Tuning.TurnAngleToRateScale;
+    DeactivationBufferHeight = Tuning.DeactivationBufferHeight;
+    SpeedScalingFactor = Tuning.SpeedScalingFactor;
+    ActivationDiskLocation = FVector(Tuning.ActivationDiskLocation.X, Tuning.ActivationDiskLocation.Y, Tuning.ActivationDiskLocation.Z);
+    AppliedConfig = &Config;
+}
+
+JoystickTuning VirtualJoystick3D::GetTuning() {
+    JoystickTuning Tuning;
+    Tuning.ActivationDiskRadius = ActivationDiskRadius;
+    Tuning.MovementDiskHeight = MovementDiskHeight;
+    Tuning.MovementDiskRadius = MovementDiskRadius;
+    Tuning.MovementDiskDonutHoleRadius = MovementDiskDonutHoleRadius;
+    Tuning.TurnAngleThreshold = TurnAngleThreshold;
+    Tuning.TurnRateOffset = TurnRateOffset;
+    Tuning.MaxTurnRate = MaxTurnRate;
+    Tuning.TurnAngleToRateScale = TurnAngleToRateScale;
+    Tuning.DeactivationBufferHeight = DeactivationBufferHeight;
+    Tuning.SpeedScalingFactor = SpeedScalingFactor;
+    Tuning.ActivationDiskLocation.X = ActivationDiskLocation.X;
+    Tuning.ActivationDiskLocation.Y = ActivationDiskLocation.Y;
+    Tuning.ActivationDiskLocation.Z = ActivationDiskLocation.Z;
+    Tuning.SpeedCurve = SpeedCurve;
+    Tuning.TurnCurve = TurnCurve;
+    return Tuning;
 }
 
 void VirtualJoystick3D::CalculateMovementFromHandLocation(FVector PalmLocation, FVector FingerLocation) {
     
-    // Next figure out if movement disk is activated
-    if (FingerLocation.Z > ActivationDiskLocation.Z) {
-        if (!IsActivated) {
-            // for unactivating crossing the Z plane is fine, but for activating want to make sure we are within the disk.
-            FVector MovementFingerCharacterLocationOnDisk = FingerLocation;
-            MovementFingerCharacterLocationOnDisk.Z = ActivationDiskLocation.Z;
-            if (FVector::Dist(MovementFingerCharacterLocationOnDisk, ActivationDiskLocation) < ActivationDiskRadius) {
-                IsActivated = true;
-                DiskLocation = FVector(PalmLocation.X, PalmLocation.Y, ActivationDiskLocation.Z);
-            }
-        }
-    }
-    else {
-        if (IsActivated && FingerLocation.Z < (ActivationDiskLocation.Z - DeactivationBufferHeight)) { // have some small buffer for finger going below disk if it's already activated, to make it more robust
-            IsActivated = false;
-            TurnRate = 0.0;
-            ForwardMovement = 0.0;
-            RightMovement = 0.0;
+    INPUT_TRACE_SCOPE(INPUT_TRACE_CALCULATE_MOVEMENT);
+    
+    // live config: one pointer load per call, the fields are only rewritten when a new snapshot was published
+    if (ConfigStore != nullptr) {
+        const JoystickConfig* Config = ConfigStore->Get();
+        if (Config != AppliedConfig) {
+            ApplyConfig(*Config);
         }
     }
     
+    // First run the activation state machine and movement math, which lives in the engine-independent core
+    JoystickSample Sample;
+    Sample.PalmLocation.X = PalmLocation.X;
+    Sample.PalmLocation.Y = PalmLocation.Y;
+    Sample.PalmLocation.Z = PalmLocation.Z;
+    Sample.FingerLocation.X = FingerLocation.X;
+    Sample.FingerLocation.Y = FingerLocation.Y;
+    Sample.FingerLocation.Z = FingerLocation.Z;
+    VirtualJoystickCore::Evaluate(GetTuning(), State, Sample);
+    FVector DiskLocation(State.DiskLocation.X, State.DiskLocation.Y, State.DiskLocation.Z);
+    
+#if VIRTUAL_JOYSTICK_DEBUG_DRAW
     // Next draw Leap Motion Donut
+    // one GetTransform() call for the disk, the cross lines and the cursor
+    const FTransform CharacterTransform = Character->GetTransform();
+    const FVector CharacterUp = CharacterTransform.GetUnitAxis(EAxis::Z);
+    const FVector CharacterRight = CharacterTransform.GetUnitAxis(EAxis::Y);
+    const FVector CharacterForward = CharacterTransform.GetUnitAxis(EAxis::X);
     FVector CylinderStart;
     FVector CylinderEnd;
-    FColor CylinderColor = FColor::Cyan;
+    DebugDrawColor CylinderColor = DebugDrawColor::Make(0, 255, 255); // cyan
     float CylinderRadius;
-    if (IsActivated) {
+    if (State.IsActivated) {
         // transform back to world space so can draw
-        CylinderStart = Character->GetTransform().TransformPosition(DiskLocation); // this is top of cylinder
-        CylinderEnd = CylinderStart - (Character->GetActorUpVector() * MovementDiskHeight); // this is bottom of cylinder
+        CylinderStart = CharacterTransform.TransformPosition(DiskLocation); // this is top of cylinder
+        CylinderEnd = CylinderStart - (CharacterUp * MovementDiskHeight); // this is bottom of cylinder
         CylinderRadius = MovementDiskRadius;
         // draw inner "donut hole" cylinder only in activated case
-        DrawDebugCylinder(Character->GetWorld(), CylinderStart, CylinderEnd, MovementDiskDonutHoleRadius, 12, CylinderColor);
+        DebugDraw->AddCylinder(ToJoystickVector(CylinderStart), ToJoystickVector(CylinderEnd), MovementDiskDonutHoleRadius, 12, CylinderColor);
     }
     else {
         // transform back to world space so can draw
-        CylinderStart = Character->GetTransform().TransformPosition(ActivationDiskLocation); // this is top of cylinder
-        CylinderEnd = CylinderStart - (Character->GetActorUpVector() * MovementDiskHeight); // this is bottom of cylinder
+        CylinderStart = CharacterTransform.TransformPosition(ActivationDiskLocation); // this is top of cylinder
+        CylinderEnd = CylinderStart - (CharacterUp * MovementDiskHeight); // this is bottom of cylinder
         CylinderRadius = ActivationDiskRadius;
     }
-    DrawDebugCylinder(Character->GetWorld(), CylinderStart, CylinderEnd, CylinderRadius, 12, CylinderColor);
-    DrawDebugLine(Character->GetWorld(),
-                  CylinderEnd - (Character->GetActorRightVector() * CylinderRadius),
-                  CylinderEnd + (Character->GetActorRightVector() * CylinderRadius),
-                  CylinderColor);
-    DrawDebugLine(Character->GetWorld(),
-                  CylinderEnd - (Character->GetActorForwardVector() * CylinderRadius),
-                  CylinderEnd + (Character->GetActorForwardVector() * CylinderRadius),
-                  CylinderColor);
+    DebugDraw->AddCylinder(ToJoystickVector(CylinderStart), ToJoystickVector(CylinderEnd), CylinderRadius, 12, CylinderColor);
+    DebugDraw->AddLine(ToJoystickVector(CylinderEnd - (CharacterRight * CylinderRadius)),
+                       ToJoystickVector(CylinderEnd + (CharacterRight * CylinderRadius)),
+                       CylinderColor);
+    DebugDraw->AddLine(ToJoystickVector(CylinderEnd - (CharacterForward * CylinderRadius)),
+                       ToJoystickVector(CylinderEnd + (CharacterForward * CylinderRadius)),
+                       CylinderColor);
     
     // TODO: add proper input mapping so that it can be configured in DefaultInput.ini as a gamepad input would
-    // Finally check if we need to add character movement based on movement hand/finger position
-    if (IsActivated) {
+    // Finally draw the movement "cursor" if activated
+    if (State.IsActivated) {
         // project the movement hand palm location onto the plane of the top of the donut
         FVector MovementHandCharacterLocationOnCylinderTop = PalmLocation;
         MovementHandCharacterLocationOnCylinderTop.Z = DiskLocation.Z;
         FVector CursorVectorFromCylinderOrigin = MovementHandCharacterLocationOnCylinderTop - DiskLocation;
         FVector MovementCursorPositionCharacter = DiskLocation + CursorVectorFromCylinderOrigin.ClampMaxSize(CylinderRadius);
         // transform "cursor" position back to world space so can draw
-        FVector MovementCursorPositionWorld = Character->GetTransform().TransformPosition(MovementCursorPositionCharacter);
-        DrawDebugSphere(Character->GetWorld(), MovementCursorPositionWorld, 0.4, 12, FColor::Blue);
-        // now calculate forward and right movement
-        float ForwardPosition = MovementHandCharacterLocationOnCylinderTop.X - DiskLocation.X;
-        float RightPosition = MovementHandCharacterLocationOnCylinderTop.Y - DiskLocation.Y;
-        ForwardMovement = CalculateSpeed(ForwardPosition);
-        RightMovement = CalculateSpeed(RightPosition);
-        // now calculate angle from palm to middle finger and use that to set turn rate
-        float MovementHandAngleZ = (FingerLocation.Z - PalmLocation.Z);
-        float MovementHandAngleY = (FingerLocation.Y - PalmLocation.Y);
-        float MovementHandAngle = (atan2(MovementHandAngleY, MovementHandAngleZ) * (180 / PI));
-        TurnRate = 0.0;
-        if (abs(MovementHandAngle) >= TurnAngleThreshold) { // only turn if angle is greater than some threshold
-            float PercentageRotation =  (abs(MovementHandAngle) - TurnAngleThreshold) / 90.0;
-            TurnRate = pow(PercentageRotation, 1.5) * TurnAngleToRateScale * copysign(1.0, MovementHandAngle);
-            if (TurnRate > MaxTurnRate) {
-                TurnRate = MaxTurnRate;
-            }
-        }
+        FVector MovementCursorPositionWorld = CharacterTransform.TransformPosition(MovementCursorPositionCharacter);
+        DebugDraw->AddSphere(ToJoystickVector(MovementCursorPositionWorld), 0.4, 12, DebugDrawColor::Make(0, 0, 255)); // blue
     }
     
+    // a shared buffer is flushed by its owner once per frame
+    if (DebugDraw == &OwnDebugDraw) {
+        UnrealDebugDrawBackend Backend(Character->GetWorld());
+        OwnDebugDraw.Flush(Backend);
+    }
+#endif
 }
 
 // TODO: tweak non-linear speed function to make it easier to control movement, especially at slower speeds
 float VirtualJoystick3D::CalculateSpeed(float PositionOnMotionDonutAxis) {
-    float Speed = 0.0;
-    if ((abs(PositionOnMotionDonutAxis) > MovementDiskDonutHoleRadius)) {  // only add forward movement if we are outside of the donut hole
-        float PercentagePosition = (abs(PositionOnMotionDonutAxis) - MovementDiskDonutHoleRadius) / (MovementDiskRadius - MovementDiskDonutHoleRadius);
-        float SpeedFunctionValue = pow(PercentagePosition, 2.0); // for now just square it to make it non-linear.  TODO: need to tweak
-        Speed = SpeedFunctionValue * copysign(SpeedScalingFactor, PositionOnMotionDonutAxis); // apply scaling factor and restore the positive/negative direction sign
-    }
-    return Speed;
+    return VirtualJoystickCore::CalculateSpeed(GetTuning(), PositionOnMotionDonutAxis);
 }
 
+JoystickVector VirtualJoystick3D::ToJoystickVector(const FVector& Vector) {
+    JoystickVector Result;
+    Result.X = Vector.X;
+    Result.Y = Vector.Y;
+    Result.Z = Vector.Z;
+    return Result;
+}
@@ -26,6 +26,11 @@
  or implied, of Leonardo Malave.
  ********************************/
 
+#include "JoystickCore.h"
+#include "DebugDrawBuffer.h"
+#include "InputTrace.h"
+#include "JoystickConfig.h"
+
 #pragma once
 
 /**
@@ -67,18 +72,50 @@ public:
      */
     FVector ActivationDiskLocation;
     
+    /*
+     Optional response curves (see ResponseCurve.h) replacing the default x^2 speed and x^1.5 turn rate curves.  Not owned, nullptr means default.
+     Point these at a different, already baked ResponseCurve to swap curves at runtime.
+     */
+    const ResponseCurve* SpeedCurve;
+    const ResponseCurve* TurnCurve;
+    
+    /*
+     Snapshot of the public tuning fields in the engine-independent form used by VirtualJoystickCore
+     */
+    JoystickTuning GetTuning();
+    
+    /*
+     By default the disk and cursor are recorded into a buffer owned by this class and drawn at the end of every CalculateMovementFromHandLocation().
+     Pass a shared buffer to only record into it and flush it yourself once per frame, or nullptr to go back to the default.  The buffer is not owned by this class.
+     */
+    void SetDebugDrawBuffer(DebugDrawBuffer* Buffer);
+    
+    /*
+     Takes the tuning fields from the store's current snapshot (e.g. kept up to date by a JoystickConfigWatcher) instead of the constructor values.
+     Every CalculateMovementFromHandLocation() does one pointer load and copies the snapshot into the public fields only when it changed, so the
+     fields can still be read, but anything written to them is overwritten by the next new snapshot.  The response curves are left alone.
+     Pass nullptr to stop following the store.  The store is not owned by this class.
+     */
+    void SetConfigStore(const JoystickConfigStore* Store);
+    
 protected:
     
+    /*
+     Copies the tuning of a config snapshot into the public fields
+     */
+    void ApplyConfig(const JoystickConfig& Config);
+    
     /*
      The speed function is nonlinear so that the character can move fluidly either fast or slow.
      */
     float CalculateSpeed(float PositionOnMotionDonutAxis);
     
-    float ForwardMovement;
-    float RightMovement;
-    float TurnRate;
+    static JoystickVector ToJoystickVector(const FVector& Vector);
     
     ACharacter* Character;
-    bool IsActivated;
-    FVector DiskLocation; // in Character space
+    JoystickState State; // activation flag, disk location (in Character space) and last movement values
+    DebugDrawBuffer OwnDebugDraw;
+    DebugDrawBuffer* DebugDraw; // either &OwnDebugDraw or a shared buffer flushed by the caller
+    const JoystickConfigStore* ConfigStore;
+    const JoystickConfig* AppliedConfig; // snapshot last copied into the fields
 };